@@ -0,0 +1,60 @@
+#ifndef EMUGB_INCLUDE_AOT_HPP
+#define EMUGB_INCLUDE_AOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "cpu.hpp"
+#include "machine_state.hpp"
+
+// Interface between GameBoy and the C++ that emugb-aot generates from a ROM.
+//
+// Each basic block of the ROM's control-flow graph becomes one function that
+// executes the block's instructions with their immediates, cycle counts and
+// successor addresses folded in. It can be entered at any of its
+// instructions, so a block that stopped for an event resumes where it left
+// off. A block runs as long as the interpreter
+// would do nothing but execute the next instruction: it returns once an
+// event is due, the run ends, an interrupt is pending, or HALT or EI needs
+// the interpreter's attention. Instructions it has no translation for are
+// handed to CPU::execute() and end the block.
+
+struct AotNext;
+using AotBlockFunction = AotNext (*)(CPU &cpu, MachineState &state,
+                                     uint64_t end);
+
+// The block to run next, if known when the generator ran and execution may
+// go on; otherwise empty and GameBoy looks the block up from PC.
+struct AotNext {
+  AotBlockFunction block = nullptr;
+};
+
+// An address `run` can be entered at: the start of its block or any later
+// instruction in it.
+struct AotBlock {
+  uint16_t bank;
+  uint16_t addr;
+  AotBlockFunction run;
+};
+
+// The entry points of all compiled blocks of a ROM.
+struct AotProgram {
+  // hash64() of the ROM it was generated from.
+  uint64_t rom_hash;
+  const AotBlock *blocks;
+  size_t block_count;
+};
+
+// Defined by the file emugb-aot generates; only exists in runners built
+// with it.
+extern const AotProgram aot_program;
+
+// Whether a block may go on with its next instruction (see above). `end` is
+// the end of the current run.
+inline bool aot_can_continue(const MachineState &state, uint64_t end) {
+  return state.cycles < end && state.cycles < state.scheduler.next &&
+         (state.ie & state.io[0x0F] & 0x1F) == 0 && !state.halted &&
+         !state.ime_pending;
+}
+
+#endif // EMUGB_INCLUDE_AOT_HPP
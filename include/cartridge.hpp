@@ -2,35 +2,79 @@
 #define EMUGB_INCLUDE_CARTRIDGE_HPP
 
 #include <cstdint>
+#include <expected>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "memory.hpp"
 
+// An immutable ROM image, shared by every cartridge loaded with the same
+// contents (see intern_rom()).
+using RomImage = std::shared_ptr<const std::vector<uint8_t>>;
+
+// Returns the image with the same contents as `rom` if one is still in use,
+// and otherwise registers `rom` and returns it. Images are looked up by
+// hash64() of their contents and only stay registered while referenced, so
+// hundreds of instances of one ROM hold a single copy of it. Thread-safe.
+RomImage intern_rom(RomImage rom);
+RomImage intern_rom(std::vector<uint8_t> &&rom);
+
 class Cartridge : public Memory {
 public:
   virtual ~Cartridge() = default;
   virtual uint8_t get_byte(uint16_t addr) const = 0;
   virtual void set_byte(uint16_t addr, uint8_t value) = 0;
 
+  // Host pointer to the ROM page starting at `addr` (0x0000-0x7FFF, aligned
+  // to MachineState::page_size) if reads from it can bypass get_byte(), or
+  // nullptr otherwise.
+  virtual const uint8_t *get_rom_page(uint16_t) const { return nullptr; }
+
+  // The ROM bank mapped at 0x4000-0x7FFF.
+  virtual uint16_t get_rom_bank() const { return 1; }
+
+  // The complete ROM image as loaded.
+  virtual const std::vector<uint8_t> &get_rom() const = 0;
+
   std::string get_title() const;
 };
 
 class RomOnly : public Cartridge {
 public:
-  RomOnly(std::vector<uint8_t> &&rom) : rom(std::move(rom)) {}
+  RomOnly(RomImage rom) : rom(std::move(rom)) {}
   ~RomOnly() = default;
 
   uint8_t get_byte(uint16_t addr) const override;
   void set_byte(uint16_t addr, uint8_t value) override;
+  const uint8_t *get_rom_page(uint16_t addr) const override;
 
-  const std::vector<uint8_t> &get_rom() const { return rom; }
+  const std::vector<uint8_t> &get_rom() const override { return *rom; }
 
 private:
-  std::vector<uint8_t> rom;
+  RomImage rom;
 };
 
-std::unique_ptr<Cartridge> load_from_path(const std::string &path);
+enum class LoadError {
+  OpenFailed,
+  ReadFailed,
+  // Too small to hold a cartridge header.
+  InvalidRom,
+  // A gzip or zip file that is corrupt, unsupported or holds no file.
+  InvalidArchive,
+};
+
+std::string_view to_string(LoadError error);
+
+using LoadResult = std::expected<std::unique_ptr<Cartridge>, LoadError>;
+
+class RomCache;
+
+// Accepts raw, gzip and zip files (see read_rom_file()). With a cache, the
+// (decompressed) image is taken from or added to it.
+LoadResult load_from_path(const std::string &path, RomCache *cache = nullptr);
+LoadResult load_from_memory(std::vector<uint8_t> &&rom);
+LoadResult load_from_image(RomImage rom);
 
 #endif // EMUGB_INCLUDE_CARTRIDGE_HPP
@@ -0,0 +1,37 @@
+#ifndef EMUGB_INCLUDE_CHEATS_HPP
+#define EMUGB_INCLUDE_CHEATS_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Reads of ROM address `addr` return `value` instead of the ROM byte, but
+// only if the ROM holds `compare` there (when given).
+struct RomPatch {
+  uint16_t addr;
+  uint8_t value;
+  std::optional<uint8_t> compare;
+};
+
+// `value` is written to `addr` at the start of every VBlank.
+struct RamCheat {
+  uint16_t addr;
+  uint8_t value;
+};
+
+// Cheat codes for GameBoy::set_cheats().
+struct Cheats {
+  std::vector<RomPatch> rom_patches;
+  std::vector<RamCheat> ram_cheats;
+
+  // Adds a Game Genie code ("ABC-DEF" or "ABC-DEF-GHI", dashes optional) as
+  // a ROM patch, or a GameShark code ("01VVLLHH": value VV at 0xHHLL) as a
+  // RAM cheat. The GameShark type byte is ignored, since a DMG has no WRAM
+  // banks to select. Returns false, adding nothing, if `code` is neither.
+  bool add(std::string_view code);
+
+  bool empty() const { return rom_patches.empty() && ram_cheats.empty(); }
+};
+
+#endif // EMUGB_INCLUDE_CHEATS_HPP
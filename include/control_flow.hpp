@@ -0,0 +1,103 @@
+#ifndef EMUGB_INCLUDE_CONTROL_FLOW_HPP
+#define EMUGB_INCLUDE_CONTROL_FLOW_HPP
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+// A location in ROM. 0x0000-0x3FFF is always bank 0; 0x4000-0x7FFF shows
+// `bank` (1 or more).
+struct CodeAddress {
+  uint16_t bank;
+  uint16_t addr;
+
+  auto operator<=>(const CodeAddress &) const = default;
+
+  // Offset of the byte in the ROM image.
+  size_t get_rom_offset() const {
+    return static_cast<size_t>(bank) * 0x4000 + (addr & 0x3FFF);
+  }
+};
+
+// How control leaves a basic block through its last instruction.
+enum class BlockExit : uint8_t {
+  // Runs into the next block, which starts at a branch target.
+  Fallthrough,
+  // JP or JR; conditional ones also fall through.
+  Jump,
+  // CALL or RST; the callee returns to `end`.
+  Call,
+  // RET or RETI; conditional RETs also fall through.
+  Return,
+  // JP HL, whose target is unknown.
+  Indirect,
+  // An opcode that does not exist, or the end of the bank.
+  Stop,
+};
+
+struct BasicBlock {
+  CodeAddress start;
+  // One past the last byte, in the same bank.
+  uint16_t end;
+  uint16_t instruction_count;
+  BlockExit exit;
+  // Successors in ROM, in no particular order. Jumps into RAM (e.g. an OAM
+  // DMA routine in HRAM) and into a switchable bank from bank 0 code whose
+  // bank could not be worked out are not listed.
+  std::vector<CodeAddress> successors;
+};
+
+// The basic blocks of the code reachable in a ROM, found by disassembling
+// recursively from the entry point (0x0100), the RST vectors and the
+// interrupt vectors.
+//
+// Each bank is traced on its own thread. Jumps into another bank are queued
+// for that bank's next round, so the analysis runs in rounds until no new
+// code turns up. From bank 0 the target bank of a jump into 0x4000-0x7FFF is
+// taken from the last "LD A, n" / "LD (0x2000-0x3FFF), A" bank switch on the
+// path there, which is how nearly all games call into switchable banks.
+//
+// On disk: the magic "EMUGBCFG", a little-endian u16 version, u64 ROM hash
+// and u32 block count, then per block: u16 bank, u16 start, u16 end, u16
+// instruction count, u8 exit, u8 successor count and per successor u16 bank
+// and u16 address.
+class ControlFlowGraph {
+public:
+  static constexpr uint16_t version = 3;
+
+  static ControlFlowGraph analyze(const std::vector<uint8_t> &rom,
+                                  ThreadPool &pool);
+
+  // Reads a graph saved for the ROM with hash64() `rom_hash`. Returns
+  // nullopt if the file is missing, corrupt or for another ROM.
+  static std::optional<ControlFlowGraph> load(const std::string &path,
+                                              uint64_t rom_hash);
+  bool save(const std::string &path) const;
+
+  // Takes the graph from `cache_path` if it matches `rom`, and otherwise
+  // analyses `rom` and saves the result there. Sets `cache_hit` if given.
+  static ControlFlowGraph load_or_analyze(const std::vector<uint8_t> &rom,
+                                          const std::string &cache_path,
+                                          ThreadPool &pool,
+                                          bool *cache_hit = nullptr);
+
+  uint64_t get_rom_hash() const { return rom_hash; }
+  // Sorted by start address.
+  const std::vector<BasicBlock> &get_blocks() const { return blocks; }
+  const BasicBlock *find_block(CodeAddress start) const;
+  size_t get_instruction_count() const;
+
+private:
+  uint64_t rom_hash = 0;
+  std::vector<BasicBlock> blocks;
+};
+
+// Where the graph of the ROM at `rom_path` is cached: "<rom_path>.cfg".
+std::string get_cfg_cache_path(const std::string &rom_path);
+
+#endif // EMUGB_INCLUDE_CONTROL_FLOW_HPP
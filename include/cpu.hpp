@@ -1,15 +1,33 @@
 #ifndef EMUGB_INCLUDE_CPU_HPP
 #define EMUGB_INCLUDE_CPU_HPP
 
-#include "memory.hpp"
+#include "mmu.hpp"
 #include "register.hpp"
+#include <cstdint>
+
+class InstructionTrace;
 
 class CPU {
 public:
-  RegFile regFile;
-  Memory &memory;
+  // Both live in the MMU's state block; MMU is final, so memory accesses
+  // are direct calls into its page table instead of virtual dispatch.
+  RegFile &regFile;
+  MMU &memory;
+
+  // Print the disassembly of every executed instruction to stdout.
+  bool log_instructions = true;
+  // Print an error for every opcode that is not implemented.
+  bool report_unknown_opcodes = true;
+  // Records every executed instruction if set (not owned).
+  InstructionTrace *trace = nullptr;
 
-  CPU(Memory &memory) : regFile(), memory(memory) {}
+  // Host-side counters for metrics; not part of the machine state, so
+  // loading a snapshot leaves them alone. Compiled blocks count their
+  // instructions too.
+  uint64_t instruction_count = 0;
+  uint64_t halted_cycles = 0;
+
+  CPU(MMU &memory) : regFile(memory.get_state().regs), memory(memory) {}
 
   uint8_t imm_byte();
   uint16_t imm_word();
@@ -28,8 +46,16 @@ public:
   void alu_cp(uint8_t imm8);
   void alu_ret();
   void alu_jp(uint16_t addr);
+  void alu_push(uint16_t value);
+  uint16_t alu_pop();
+  void alu_call(uint16_t addr);
 
   void execute();
+
+private:
+  void tick(uint8_t cycles) { memory.get_state().cycles += cycles; }
+  bool service_interrupt();
+  void record_instruction(uint16_t pc);
 };
 
 #endif // EMUGB_INCLUDE_CPU_HPP
@@ -0,0 +1,29 @@
+#ifndef EMUGB_INCLUDE_DISASSEMBLER_HPP
+#define EMUGB_INCLUDE_DISASSEMBLER_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "opcodes.hpp"
+
+class MMU;
+
+// The longest instruction is 3 bytes; unused trailing bytes are ignored.
+using InstructionBytes = std::array<uint8_t, 3>;
+
+// The table entry of the instruction in `bytes`, following a 0xCB prefix.
+constexpr const OpcodeInfo &decode(const InstructionBytes &bytes) {
+  return bytes[0] == 0xCB ? get_cb_opcode_info(bytes[1])
+                          : get_opcode_info(bytes[0]);
+}
+
+// Formats the instruction in `bytes` located at `addr`, e.g.
+// "LD A, (0xFF44)" or "JR NZ, 0x0150". Opcodes that do not exist come out
+// as "DB 0xD3".
+std::string disassemble(uint16_t addr, const InstructionBytes &bytes);
+
+// Reads the instruction at `addr` without side effects (see MMU::peek()).
+InstructionBytes read_instruction(const MMU &mmu, uint16_t addr);
+
+#endif // EMUGB_INCLUDE_DISASSEMBLER_HPP
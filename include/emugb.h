@@ -0,0 +1,204 @@
+#ifndef EMUGB_INCLUDE_EMUGB_H
+#define EMUGB_INCLUDE_EMUGB_H
+
+/*
+ * C interface of libemugb.
+ *
+ * Every function that can fail returns an emugb_status; nothing in the
+ * library exits the process. An instance is not thread-safe, but separate
+ * instances can run on separate threads.
+ *
+ * Pointers returned by the accessors point straight into the instance and
+ * stay valid until it is destroyed; reading them copies nothing. Their
+ * contents change as the instance runs.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct emugb emugb;
+
+typedef enum emugb_status {
+  EMUGB_OK = 0,
+  EMUGB_ERROR_INVALID_ARGUMENT,
+  EMUGB_ERROR_OPEN_FAILED,
+  EMUGB_ERROR_READ_FAILED,
+  EMUGB_ERROR_INVALID_ROM,
+  EMUGB_ERROR_INVALID_SNAPSHOT,
+  EMUGB_ERROR_OUT_OF_MEMORY,
+  /* Not an error: a run stopped early at a breakpoint. */
+  EMUGB_BREAKPOINT,
+  EMUGB_ERROR_INVALID_ARCHIVE,
+  /* The operating system refused to start a worker thread. */
+  EMUGB_ERROR_THREAD_FAILED,
+} emugb_status;
+
+/* Buttons for emugb_set_input(), combined with bitwise OR. */
+#define EMUGB_BUTTON_RIGHT 0x01
+#define EMUGB_BUTTON_LEFT 0x02
+#define EMUGB_BUTTON_UP 0x04
+#define EMUGB_BUTTON_DOWN 0x08
+#define EMUGB_BUTTON_A 0x10
+#define EMUGB_BUTTON_B 0x20
+#define EMUGB_BUTTON_SELECT 0x40
+#define EMUGB_BUTTON_START 0x80
+
+#define EMUGB_SCREEN_WIDTH 160
+#define EMUGB_SCREEN_HEIGHT 144
+#define EMUGB_CYCLES_PER_FRAME 70224
+
+typedef enum emugb_memory_region {
+  EMUGB_MEMORY_WRAM, /* 0xC000-0xDFFF */
+  EMUGB_MEMORY_VRAM, /* 0x8000-0x9FFF */
+  EMUGB_MEMORY_OAM,  /* 0xFE00-0xFE9F */
+  EMUGB_MEMORY_IO,   /* 0xFF00-0xFF7F */
+  EMUGB_MEMORY_HRAM, /* 0xFF80-0xFFFE */
+} emugb_memory_region;
+
+const char *emugb_status_string(emugb_status status);
+
+/*
+ * The instance starts in the state the boot ROM leaves behind. `path` may
+ * be a raw ROM, a gzip file or a zip archive.
+ */
+emugb_status emugb_create_from_path(const char *path, emugb **out);
+/* The ROM is copied; `rom` may be freed afterwards. */
+emugb_status emugb_create_from_memory(const uint8_t *rom, size_t size,
+                                      emugb **out);
+void emugb_destroy(emugb *gb);
+
+/*
+ * Keeps up to `bytes` of (decompressed) ROM images read by
+ * emugb_create_from_path(), so that creating many instances from one
+ * archive reads and inflates it once. 0 (the default) disables and empties the
+ * cache. Process-wide and thread-safe.
+ */
+void emugb_set_rom_cache_capacity(size_t bytes);
+
+/* Runs to the end of the current frame, `frames` times. */
+emugb_status emugb_run_frames(emugb *gb, uint32_t frames);
+/* Runs for at least `cycles` T-cycles; the last instruction may overshoot. */
+emugb_status emugb_run_cycles(emugb *gb, uint64_t cycles);
+
+/* Sets the held buttons (EMUGB_BUTTON_* flags). */
+emugb_status emugb_set_input(emugb *gb, uint8_t buttons);
+/* While enabled, draws every `display_interval`th frame (0: none). */
+emugb_status emugb_set_fast_forward(emugb *gb, int enabled,
+                                    uint32_t display_interval);
+/*
+ * Runs `frames` frames ahead of the real state after every frame and shows
+ * the last of them, hiding that many frames of the game's input latency
+ * (0 disables). Each emulated frame then costs `frames` + 1 frames of host
+ * time plus a snapshot save and restore.
+ */
+emugb_status emugb_set_run_ahead(emugb *gb, uint32_t frames);
+
+uint64_t emugb_cycles(const emugb *gb);
+uint64_t emugb_state_hash(const emugb *gb);
+
+/*
+ * Snapshots are opaque byte buffers of emugb_snapshot_size() bytes. They can
+ * be restored into any instance running the same ROM, but only by the same
+ * build of the library.
+ */
+size_t emugb_snapshot_size(void);
+emugb_status emugb_snapshot_save(const emugb *gb, void *buffer, size_t size);
+emugb_status emugb_snapshot_restore(emugb *gb, const void *buffer,
+                                    size_t size);
+
+/* EMUGB_SCREEN_WIDTH * EMUGB_SCREEN_HEIGHT shades, 0 (white) to 3 (black). */
+const uint8_t *emugb_framebuffer(const emugb *gb);
+/*
+ * Hash of the framebuffer, combined from hashes of its lines that are kept
+ * up to date as they are drawn. Equal screens have equal hashes.
+ */
+uint64_t emugb_frame_hash(const emugb *gb);
+/*
+ * Returns how many lines the last frame run drew differently from the frame
+ * before it; 0 means the screen is unchanged. Unless `lines` is NULL, sets
+ * lines[y] to 1 for each changed line and to 0 otherwise
+ * (EMUGB_SCREEN_HEIGHT bytes).
+ */
+uint32_t emugb_changed_lines(const emugb *gb, uint8_t *lines);
+/* Interleaved stereo samples. There is no APU yet: always NULL and 0. */
+const int16_t *emugb_audio_samples(const emugb *gb, size_t *count);
+/* Writable view of one memory region; `size` receives its length. */
+uint8_t *emugb_memory(emugb *gb, emugb_memory_region region, size_t *size);
+const uint8_t *emugb_rom(const emugb *gb, size_t *size);
+
+/*
+ * Breakpoints. Execute breakpoints stop before the instruction runs; read
+ * and write breakpoints stop after the instruction that made the access.
+ * Either way the run returns EMUGB_BREAKPOINT and running again continues
+ * from there. They cost nothing on pages of the memory map without one.
+ */
+typedef enum emugb_access {
+  EMUGB_ACCESS_READ = 1,
+  EMUGB_ACCESS_WRITE = 2,
+  EMUGB_ACCESS_EXECUTE = 4,
+} emugb_access;
+
+typedef struct emugb_breakpoint_hit {
+  emugb_access access;
+  uint16_t addr;
+  /* The byte read or written, or the opcode about to be executed. */
+  uint8_t value;
+} emugb_breakpoint_hit;
+
+/* `access` is a bitwise OR of emugb_access values. */
+emugb_status emugb_add_breakpoint(emugb *gb, int access, uint16_t addr);
+emugb_status emugb_remove_breakpoint(emugb *gb, int access, uint16_t addr);
+emugb_status emugb_clear_breakpoints(emugb *gb);
+/* Returns 1 and fills `hit` with the first hit since the last call, or 0. */
+int emugb_take_breakpoint_hit(emugb *gb, emugb_breakpoint_hit *hit);
+
+/*
+ * Cheats. Game Genie codes ("ABC-DEF-GHI" or "ABC-DEF") patch ROM through
+ * the memory map; GameShark codes ("01VVLLHH") write RAM at the start of
+ * every VBlank. Instances without cheats pay nothing for them. An invalid
+ * code returns EMUGB_ERROR_INVALID_ARGUMENT.
+ */
+emugb_status emugb_add_cheat(emugb *gb, const char *code);
+emugb_status emugb_clear_cheats(emugb *gb);
+
+/*
+ * Batches step many instances of one ROM per call on a persistent thread
+ * pool. Each instance's observation is its screen (if requested) followed by
+ * one byte per entry of `ram_addresses`; all of them are written to one
+ * buffer of instance_count * emugb_batch_observation_size() bytes.
+ */
+typedef struct emugb_batch emugb_batch;
+
+/*
+ * `thread_count` 0 uses one thread per hardware thread; more threads than
+ * instances would idle, so it is capped at `instance_count`.
+ */
+emugb_status emugb_batch_create(const uint8_t *rom, size_t size,
+                                size_t instance_count, size_t thread_count,
+                                int screen, const uint16_t *ram_addresses,
+                                size_t ram_address_count, emugb_batch **out);
+void emugb_batch_destroy(emugb_batch *batch);
+
+size_t emugb_batch_observation_size(const emugb_batch *batch);
+
+/*
+ * Holds `actions[i]` on instance i for `frames` frames and writes the
+ * observations. Only the last frame of a step is drawn.
+ */
+emugb_status emugb_batch_step(emugb_batch *batch, const uint8_t *actions,
+                              uint32_t frames, uint8_t *observations,
+                              size_t size);
+
+/* Instances start at the post-boot state until a new start state is set. */
+emugb_status emugb_batch_reset(emugb_batch *batch, size_t instance);
+emugb_status emugb_batch_set_start_state(emugb_batch *batch, size_t instance);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EMUGB_INCLUDE_EMUGB_H */
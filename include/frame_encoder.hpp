@@ -0,0 +1,113 @@
+#ifndef EMUGB_INCLUDE_FRAME_ENCODER_HPP
+#define EMUGB_INCLUDE_FRAME_ENCODER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "ppu.hpp"
+#include "triple_buffer.hpp"
+
+enum class FrameFormat {
+  // One binary PPM image per frame.
+  Ppm,
+  // One 8-bit greyscale PNG per frame.
+  Png,
+  // A single uncompressed YUV4MPEG2 stream, luma only.
+  Y4m,
+};
+
+// Writes frames to disk on its own thread.
+//
+// submit() copies the framebuffer into a triple buffer and returns; the
+// encoder thread converts and writes the newest frame while emulation goes
+// on. If the encoder falls behind, frames are dropped rather than stalling
+// emulation. In a Y4M stream the frame after a gap is repeated to fill it, so
+// the video keeps its length.
+//
+// A frame identical to the previous one (see GameBoy::is_screen_unchanged())
+// is passed to repeat() instead, which copies nothing. A Y4M stream repeats
+// the previous frame for it; image files are only written for frames that
+// changed.
+class FrameEncoder {
+public:
+  using Pixels = std::array<uint8_t, PPU::width * PPU::height>;
+
+  struct Stats {
+    uint64_t submitted = 0;
+    uint64_t encoded = 0;
+    // Passed to repeat(); not encoded again.
+    uint64_t repeated = 0;
+    // Replaced by a newer frame before the encoder got to them.
+    uint64_t dropped = 0;
+    // Submitted but neither encoded nor dropped yet.
+    uint64_t backlog = 0;
+  };
+
+  // Picks the format from the extension of `path`: ".ppm" and ".png" write
+  // "<stem>-<frame><extension>" files, ".y4m" one stream. Prints an error
+  // and returns nullptr for other extensions or if the stream cannot be
+  // created.
+  static std::unique_ptr<FrameEncoder> open(const std::string &path);
+
+  // Calls finish().
+  ~FrameEncoder();
+
+  FrameEncoder(const FrameEncoder &) = delete;
+  FrameEncoder &operator=(const FrameEncoder &) = delete;
+
+  // Called from the emulation thread after frame `frame` was drawn.
+  void submit(uint64_t frame, const Pixels &pixels);
+  // Called instead of submit() after a frame identical to the previous one
+  // (or, before any submit(), to an all-white screen).
+  void repeat();
+  // Waits for the last submitted frame to be written and stops the encoder
+  // thread. No frames may be submitted afterwards.
+  void finish();
+
+  Stats get_stats() const;
+  // False once a write failed; later frames are then discarded.
+  bool is_ok() const { return ok.load(std::memory_order_relaxed); }
+
+private:
+  struct Slot {
+    uint64_t frame;
+    // Number of frames submitted or repeated up to and including this one.
+    uint64_t sequence;
+    // Of the frames between the previous submit() and this one, how many
+    // were repeats of it.
+    uint64_t repeats;
+    Pixels pixels;
+  };
+
+  FrameFormat format;
+  std::filesystem::path path;
+  // The Y4M stream.
+  std::ofstream stream;
+  // Sequence number and luma of the last frame written; only touched by the
+  // encoder thread.
+  uint64_t last_sequence = 0;
+  Pixels last_luma;
+  // Repeats since the last submit(); only touched by the emulation thread.
+  uint64_t pending_repeats = 0;
+
+  TripleBuffer<Slot> frames;
+  std::atomic<uint64_t> submitted = 0;
+  std::atomic<uint64_t> dropped = 0;
+  std::atomic<uint64_t> encoded = 0;
+  std::atomic<uint64_t> repeated = 0;
+  std::atomic<bool> ok = true;
+  std::thread thread;
+
+  FrameEncoder(FrameFormat format, const std::filesystem::path &path);
+  void run();
+  bool write(const Slot &slot);
+  bool write_y4m_frames(const Pixels &luma, uint64_t count);
+};
+
+#endif // EMUGB_INCLUDE_FRAME_ENCODER_HPP
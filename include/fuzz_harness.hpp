@@ -0,0 +1,65 @@
+#ifndef EMUGB_INCLUDE_FUZZ_HARNESS_HPP
+#define EMUGB_INCLUDE_FUZZ_HARNESS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "cartridge.hpp"
+#include "gameboy.hpp"
+#include "machine_state.hpp"
+
+struct FuzzOptions {
+  // Frames run after power-on before the snapshot every input starts from.
+  uint32_t boot_frames = 0;
+  // Joypad inputs: how long each input byte holds its buttons.
+  uint64_t joypad_step_cycles = GameBoy::cycles_per_frame / 4;
+  // Instruction streams: how long the stream runs.
+  uint64_t stream_cycles = 4096;
+  // Run every input twice and compare the resulting state hashes. Catches
+  // guest state that lives outside MachineState, at half the speed.
+  bool check_determinism = false;
+};
+
+// Runs fuzzer inputs against one machine, restoring a pre-booted snapshot in
+// place before each one, so no objects are created or ROMs loaded per input.
+//
+// The first byte of an input selects what the rest is. With bit 0 clear,
+// every following byte is a set of held buttons (Button flags) for
+// `joypad_step_cycles` cycles. With bit 0 set, the bytes are copied into
+// WRAM at 0xC000, followed by "JR -2", and run from there for
+// `stream_cycles` cycles with the rest of the machine as in the snapshot.
+//
+// After each input the emulator's own invariants are checked: the cycle
+// counter and event deadlines are consistent, the PPU is in a valid line and
+// mode, DMA flags agree with their events and the page table only points into
+// this machine's memory or ROM.
+class FuzzHarness {
+public:
+  static constexpr uint16_t stream_addr = 0xC000;
+
+  FuzzHarness(std::unique_ptr<Cartridge> cartridge, FuzzOptions options = {});
+
+  // Runs one input. Returns a description of the first violated invariant,
+  // or nullopt if there was none.
+  std::optional<std::string> run(const uint8_t *data, size_t size);
+
+  GameBoy &get_gameboy() { return gameboy; }
+
+private:
+  FuzzOptions options;
+  GameBoy gameboy;
+  MachineState snapshot;
+
+  // Returns the cycle the input was meant to run up to.
+  uint64_t run_input(const uint8_t *data, size_t size);
+  std::optional<std::string> check_invariants(uint64_t end) const;
+};
+
+// A 32 KiB ROM that does nothing but loop at 0x0100, for fuzzing instruction
+// streams without a game.
+std::unique_ptr<Cartridge> make_idle_cartridge();
+
+#endif // EMUGB_INCLUDE_FUZZ_HARNESS_HPP
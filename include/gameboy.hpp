@@ -0,0 +1,148 @@
+#ifndef EMUGB_INCLUDE_GAMEBOY_HPP
+#define EMUGB_INCLUDE_GAMEBOY_HPP
+
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "aot.hpp"
+#include "cartridge.hpp"
+#include "cheats.hpp"
+#include "cpu.hpp"
+#include "machine_state.hpp"
+#include "metrics.hpp"
+#include "mmu.hpp"
+#include "ppu.hpp"
+
+class Profiler;
+
+// Settings for running when only the game state matters. Emulation is never
+// throttled to real time; fast-forward additionally skips drawing pixels for
+// frames nobody looks at. Timing, interrupts and all guest-visible state are
+// identical in both modes.
+struct FastForward {
+  bool enabled = false;
+  // While enabled, draw every Nth frame and skip the others (0: draw none).
+  uint32_t display_interval = 0;
+};
+
+// Host time spent on the frames run with run-ahead, summed over `frames`.
+struct RunAheadStats {
+  uint64_t frames = 0;
+  // The real frame, saving the state, the frames run ahead, and restoring.
+  uint64_t frame_ns = 0;
+  uint64_t save_ns = 0;
+  uint64_t ahead_ns = 0;
+  uint64_t restore_ns = 0;
+  // Longest total for a single frame.
+  uint64_t max_total_ns = 0;
+};
+
+// One emulated Game Boy, started in the state the boot ROM leaves behind.
+class GameBoy {
+public:
+  static constexpr uint64_t cycles_per_frame = 70224;
+
+  MMU mmu;
+  CPU cpu;
+  PPU ppu;
+
+  GameBoy(std::unique_ptr<Cartridge> cartridge);
+
+  // Executes one instruction and handles every event that became due.
+  void step() {
+    cpu.execute();
+    const MachineState &state = mmu.get_state();
+    if (state.cycles >= state.scheduler.next) [[unlikely]] {
+      dispatch_events();
+    }
+  }
+
+  // Runs until the end of the current frame. Returns false if a breakpoint
+  // stopped it first (see MMU::take_trap_hit()); calling it again finishes
+  // the frame.
+  bool run_frame();
+
+  // Framebuffer lines the last finished run_frame() drew differently from
+  // the frame before. None means the screen did not change, so encoders and
+  // screen deduplication can skip it; PPU::get_frame_hash() identifies it.
+  const std::bitset<PPU::height> &get_changed_lines() const {
+    return changed_lines;
+  }
+  bool is_screen_unchanged() const { return changed_lines.none(); }
+
+  // Run-ahead hides the game's own input lag. After each frame from
+  // run_frame(), the state is saved and `frames` more frames run with the
+  // same buttons. Only the last of them is drawn, and then the saved state
+  // is restored. The framebuffer thus shows the game `frames` frames ahead,
+  // while timing, the state hash and movies follow the real frames. Skipped
+  // while breakpoints are set. The frames run ahead are seen by profilers,
+  // metrics and a link cable as if they were real, so do not combine it
+  // with a link cable.
+  void set_run_ahead(uint32_t frames);
+  uint32_t get_run_ahead() const { return run_ahead_frames; }
+  const RunAheadStats &get_run_ahead_stats() const { return run_ahead_stats; }
+
+  // Runs for at least `cycles` cycles; the last instruction may overshoot.
+  // Returns false if a breakpoint stopped it first.
+  bool run_cycles(uint64_t cycles);
+
+  uint64_t get_frame() const {
+    return mmu.get_state().cycles / cycles_per_frame;
+  }
+  void set_buttons(uint8_t buttons) { mmu.set_buttons(buttons); }
+  uint64_t hash_state() const { return ::hash_state(mmu.get_state()); }
+
+  void set_fast_forward(const FastForward &settings) {
+    fast_forward = settings;
+  }
+  const FastForward &get_fast_forward() const { return fast_forward; }
+
+  // Runs the blocks of `program` (see aot.hpp) instead of interpreting
+  // them; nullptr goes back to interpreting everything. Returns false, and
+  // keeps interpreting, if `program` was generated from another ROM. Steps
+  // with breakpoints set or an instruction trace attached are interpreted,
+  // and heatmaps do not see the accesses of compiled blocks.
+  bool set_aot_program(const AotProgram *program);
+
+  // Replaces the active cheats. ROM patches go into the memory map (see
+  // MMU::set_rom_patches()) and RAM cheats are written at the start of every
+  // VBlank, so without cheats nothing is checked at all. Compiled blocks are
+  // not used while the ROM is patched.
+  void set_cheats(const Cheats &cheats);
+
+  // Samples into `profiler` (not owned) every profiler->get_interval()
+  // cycles from now on; nullptr stops sampling. Sampling does not change
+  // timing or the state hash. Loading a snapshot keeps the snapshot's
+  // sampling deadline, so set the profiler again afterwards.
+  void set_profiler(Profiler *profiler);
+
+  // Host-side counters of the work done so far, for metrics.
+  PerfCounters get_counters() const;
+
+private:
+  FastForward fast_forward;
+  uint32_t run_ahead_frames = 0;
+  // Where the real frame is kept while running ahead.
+  std::unique_ptr<MachineState> run_ahead_state;
+  RunAheadStats run_ahead_stats;
+  std::bitset<PPU::height> changed_lines;
+  std::vector<RamCheat> ram_cheats;
+  Profiler *profiler = nullptr;
+  // The compiled block starting at each ROM offset, if any; empty when
+  // interpreting.
+  std::vector<AotBlockFunction> aot_blocks;
+  // Steps that looked for a compiled block at PC, and found one.
+  uint64_t aot_lookups = 0;
+  uint64_t aot_hits = 0;
+  // End of the current run; a breakpoint cuts it short by zeroing it.
+  uint64_t run_end = 0;
+
+  bool run_until(uint64_t end);
+  void run_frame_ahead(bool draw);
+  void step_aot();
+  void dispatch_events();
+};
+
+#endif // EMUGB_INCLUDE_GAMEBOY_HPP
@@ -0,0 +1,26 @@
+#ifndef EMUGB_INCLUDE_HASH_HPP
+#define EMUGB_INCLUDE_HASH_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Streaming XXH64, a fast non-cryptographic 64-bit hash.
+class Hasher64 {
+public:
+  Hasher64(uint64_t seed = 0);
+
+  void update(const void *data, size_t size);
+  uint64_t digest() const;
+
+private:
+  std::array<uint64_t, 4> acc;
+  std::array<uint8_t, 32> buffer;
+  size_t buffered = 0;
+  uint64_t total = 0;
+  uint64_t seed;
+};
+
+uint64_t hash64(const void *data, size_t size, uint64_t seed = 0);
+
+#endif // EMUGB_INCLUDE_HASH_HPP
@@ -0,0 +1,69 @@
+#ifndef EMUGB_INCLUDE_HEATMAP_HPP
+#define EMUGB_INCLUDE_HEATMAP_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "memory.hpp"
+
+// Per-address counts of the reads, writes and opcode fetches an MMU makes.
+//
+// The MMU only calls record() when the library is built with
+// EMUGB_HEATMAP=ON; otherwise the hooks do not exist and a Heatmap never
+// sees an access. With a sample interval of N only every Nth access is
+// counted, and exported counts are scaled back up by N. The counters take
+// 1.5 MiB, so allocate it on the heap.
+class Heatmap {
+public:
+  static constexpr size_t page_size = 256;
+
+  Heatmap(uint32_t sample_interval = 1);
+
+  void record(Access access, uint16_t addr) {
+    if (--countdown == 0) [[unlikely]] {
+      countdown = sample_interval;
+      counts[index(access)][addr] += 1;
+    }
+  }
+
+  uint32_t get_sample_interval() const { return sample_interval; }
+  // Estimated number of accesses of one kind to one address.
+  uint64_t get_count(Access access, uint16_t addr) const {
+    return counts[index(access)][addr] * sample_interval;
+  }
+
+  void clear();
+
+  // Writes the counts per 256-byte page and per address, skipping those
+  // never accessed. The format is JSON if `path` ends in ".json" and CSV
+  // otherwise. The frame range is recorded in the file.
+  bool write(const std::string &path, uint64_t first_frame,
+             uint64_t last_frame) const;
+
+private:
+  static constexpr size_t kind_count = 3;
+
+  uint32_t sample_interval;
+  uint32_t countdown;
+  std::array<std::array<uint64_t, 0x10000>, kind_count> counts;
+
+  static size_t index(Access access) {
+    switch (access) {
+    case Access::Read:
+      return 0;
+    case Access::Write:
+      return 1;
+    case Access::Execute:
+      return 2;
+    }
+    std::unreachable();
+  }
+
+  std::string to_csv(uint64_t first_frame, uint64_t last_frame) const;
+  std::string to_json(uint64_t first_frame, uint64_t last_frame) const;
+};
+
+#endif // EMUGB_INCLUDE_HEATMAP_HPP
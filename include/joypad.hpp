@@ -0,0 +1,32 @@
+#ifndef EMUGB_INCLUDE_JOYPAD_HPP
+#define EMUGB_INCLUDE_JOYPAD_HPP
+
+#include <cstdint>
+
+// Joypad buttons, as bits of MachineState::buttons (1 = pressed).
+enum class Button : uint8_t {
+  Right = 0b00000001,
+  Left = 0b00000010,
+  Up = 0b00000100,
+  Down = 0b00001000,
+  A = 0b00010000,
+  B = 0b00100000,
+  Select = 0b01000000,
+  Start = 0b10000000
+};
+
+// P1 (0xFF00) as seen by the CPU. `select` is the last value written to the
+// register; bit 4 low selects the direction keys, bit 5 low the action
+// buttons. Pressed buttons of the selected groups read as 0.
+inline uint8_t read_joypad(uint8_t select, uint8_t buttons) {
+  uint8_t pressed = 0;
+  if ((select & 0x10) == 0) {
+    pressed |= buttons & 0x0F;
+  }
+  if ((select & 0x20) == 0) {
+    pressed |= buttons >> 4;
+  }
+  return 0xC0 | (select & 0x30) | (~pressed & 0x0F);
+}
+
+#endif // EMUGB_INCLUDE_JOYPAD_HPP
@@ -0,0 +1,107 @@
+#ifndef EMUGB_INCLUDE_LINK_CABLE_HPP
+#define EMUGB_INCLUDE_LINK_CABLE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "gameboy.hpp"
+#include "mmu.hpp"
+#include "spsc_channel.hpp"
+
+// One end of a link cable, owned by a LinkCable and driven by the MMU.
+//
+// Both ends count synchronisation points ("epochs") every `quantum` cycles
+// of their own clock, and every message is tagged with the epoch its sender
+// was in. Transfers are resolved on fixed epochs, so the outcome depends only
+// on the two emulated timelines and never on how the threads interleave:
+//
+// - A transfer started with the internal clock in epoch j sends the byte to
+//   the other end, which answers at its epoch j + 2. If the other end is
+//   waiting with the external clock at that point, both bytes are swapped
+//   and its transfer completes; otherwise the answer is 0xFF.
+// - The starting end completes its transfer at its epoch j + 4 (3 to 4
+//   quanta, about the 4096 cycles of a real transfer).
+//
+// Ends only wait for each other when the outcome depends on the other
+// timeline: while waiting with the external clock, where each epoch waits
+// for the other end to be at most one epoch behind, and when a transfer
+// completes without its answer having arrived yet. The rest of the time an
+// end only publishes its epoch and polls its inbox once per quantum.
+class LinkPort {
+public:
+  // Divides GameBoy::cycles_per_frame, so that runs of whole frames end on
+  // a synchronisation point.
+  static constexpr uint64_t quantum = 1232;
+
+  LinkPort(MMU &mmu);
+
+  LinkPort(const LinkPort &) = delete;
+  LinkPort &operator=(const LinkPort &) = delete;
+
+  // Called by the MMU when an internal-clock transfer starts.
+  void start_transfer();
+  // Handles the synchronisation point due at Event::Link.
+  void sync();
+
+private:
+  friend class LinkCable;
+
+  struct Message {
+    enum class Kind : uint8_t { Start, Answer } kind;
+    uint8_t value;
+    uint64_t epoch;
+  };
+
+  MMU &mmu;
+  LinkPort *partner = nullptr;
+  uint64_t origin;
+  uint64_t epoch;
+  // Epoch in which our own transfer started, until it completes.
+  std::optional<uint64_t> sent_epoch;
+  std::optional<uint8_t> answer;
+  // A transfer of the other end that we answer at its epoch + 2.
+  std::optional<Message> received;
+
+  // Written by this end and read by the other one.
+  alignas(64) std::atomic<uint64_t> published_epoch = 0;
+  std::atomic<uint64_t> finished_runs = 0;
+  // Messages from the other end.
+  SpscChannel<Message, 16> inbox;
+
+  void send(const Message &message);
+  void poll();
+  void answer_received();
+  // Polls until `done()` holds, yielding the thread in between.
+  template <typename Done> void wait_until(Done done);
+  void finish_run();
+};
+
+// Connects two instances through their serial ports and runs them on two
+// threads.
+//
+// Snapshots do not cover the cable, so connected instances must not be
+// restored from one, and breakpoints are not supported while connected.
+class LinkCable {
+public:
+  // Both instances must stay alive until the cable is destroyed, which
+  // disconnects them again.
+  LinkCable(GameBoy &first, GameBoy &second);
+  ~LinkCable();
+
+  LinkCable(const LinkCable &) = delete;
+  LinkCable &operator=(const LinkCable &) = delete;
+
+  // Runs both instances for `frames` frames, the second one on a new thread.
+  void run_frames(uint32_t frames);
+
+private:
+  GameBoy *gameboys[2];
+  std::unique_ptr<LinkPort> ports[2];
+
+  void run_side(size_t side, uint32_t frames);
+};
+
+#endif // EMUGB_INCLUDE_LINK_CABLE_HPP
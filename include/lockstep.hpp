@@ -0,0 +1,96 @@
+#ifndef EMUGB_INCLUDE_LOCKSTEP_HPP
+#define EMUGB_INCLUDE_LOCKSTEP_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "gameboy.hpp"
+
+// Runs many copies of one ROM in lockstep.
+//
+// Every lane is a GameBoy, started in the post-boot state and running the
+// ROM without a memory bank controller. While run() goes, the registers,
+// cycle counts and next event deadlines of all lanes are kept in
+// structure-of-arrays form. Lanes that share a PC in ROM fetch the same
+// instruction, so register-only instructions and branches are executed for
+// the whole group at once with branchless per-lane loops the compiler turns
+// into SIMD code (build with EMUGB_NATIVE=ON to let it use AVX2/AVX-512).
+//
+// A lane takes part only if the instruction cannot reach its next event
+// and no interrupt, HALT or EI delay needs handling, which is exactly when
+// GameBoy::step() would execute just that instruction. Everything else,
+// lanes whose PC points into RAM, and lanes with breakpoints, ROM patches
+// or an instruction trace go through the lane's GameBoy::step(). Such a
+// lane keeps stepping on its own until its next instruction could join a
+// group again.
+//
+// This is an experiment, used only by the --lockstep bench. It falls well
+// short of the several-fold speedup it was written for: most instructions
+// in real ROMs touch memory and still run one lane at a time, and on the
+// test ROMs it runs at 0.8x to 1.3x the speed of separate instances.
+class LockstepBatch {
+public:
+  static constexpr size_t lane_count = 32;
+
+  LockstepBatch(const std::vector<uint8_t> &rom);
+
+  // Steps every lane `steps` times. Lanes end up in the same state as
+  // GameBoy instances that called step() as often, but may be out of step
+  // with each other in between.
+  void run(uint64_t steps);
+
+  // Lanes may be inspected and changed (buttons, memory, breakpoints)
+  // between runs.
+  GameBoy &get_lane(size_t lane) { return *lanes[lane]; }
+  const GameBoy &get_lane(size_t lane) const { return *lanes[lane]; }
+
+  // Number of (lane, step) pairs taken by each path.
+  uint64_t get_vector_steps() const { return vector_steps; }
+  uint64_t get_scalar_steps() const { return scalar_steps; }
+
+private:
+  using LaneMask = std::array<uint8_t, lane_count>;
+  template <typename T> using LaneArray = std::array<T, lane_count>;
+
+  // Register file, one entry per lane. Indexed like the r8 operand field of
+  // an opcode (B, C, D, E, H, L, -, A); index 6 is (HL) and stays unused.
+  alignas(64) std::array<LaneArray<uint8_t>, 8> r8;
+  alignas(64) LaneArray<uint8_t> f;
+  alignas(64) LaneArray<uint16_t> sp;
+  alignas(64) LaneArray<uint16_t> pc;
+  alignas(64) LaneArray<uint64_t> cycles;
+  alignas(64) LaneArray<uint64_t> deadlines;
+  alignas(64) LaneArray<uint64_t> instructions;
+  // 0xFF for lanes whose state allows the vector path at all (see above).
+  alignas(64) LaneMask ready;
+  // Opcodes execute_vector() has turned down.
+  std::array<bool, 256> scalar_opcodes{};
+
+  std::vector<std::unique_ptr<GameBoy>> lanes;
+  uint64_t vector_steps = 0;
+  uint64_t scalar_steps = 0;
+
+  // Copy a lane between its GameBoy and the arrays above.
+  void load_lane(size_t lane);
+  void store_lane(size_t lane);
+
+  bool execute_vector(const LaneMask &mask, uint16_t group_pc, uint8_t opcode,
+                      uint8_t imm8, uint16_t imm16);
+  // Whether the lane's next instruction would go through GameBoy::step()
+  // anyway.
+  bool stays_scalar(const GameBoy &gameboy) const;
+  // Steps a lane once, then on while stays_scalar(), taking the extra steps
+  // from `remaining`.
+  void execute_scalar(size_t lane, uint64_t &remaining);
+  void set_r16(const LaneMask &mask, size_t hi, size_t lo, uint16_t value);
+  void add_r16(const LaneMask &mask, size_t hi, size_t lo, uint16_t delta);
+  void alu(const LaneMask &mask, uint8_t op, const LaneArray<uint8_t> &src);
+  void jump_if(const LaneMask &mask, uint8_t opcode, uint8_t condition,
+               uint16_t taken, uint16_t not_taken);
+  void advance(const LaneMask &mask, uint8_t opcode, uint16_t length);
+};
+
+#endif // EMUGB_INCLUDE_LOCKSTEP_HPP
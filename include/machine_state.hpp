@@ -0,0 +1,77 @@
+#ifndef EMUGB_INCLUDE_MACHINE_STATE_HPP
+#define EMUGB_INCLUDE_MACHINE_STATE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "register.hpp"
+#include "scheduler.hpp"
+
+// Every piece of mutable guest state of one Game Boy, packed into a single
+// cache-line aligned block.
+//
+// The registers and the page table share the first cache lines so the
+// instruction fetch/decode path touches as few lines as possible; the RAM
+// regions follow. The block is trivially copyable, so a snapshot is one
+// memcpy. The page table holds host pointers, so a block copied into a
+// different MMU must be re-mapped (see MMU::load_state()).
+struct alignas(64) MachineState {
+  static constexpr size_t page_shift = 12;
+  static constexpr size_t page_size = size_t{1} << page_shift;
+  static constexpr size_t page_count = 0x10000 / page_size;
+
+  RegFile regs;
+  // Interrupt master enable, and whether EI is waiting one instruction to
+  // set it.
+  bool ime;
+  bool ime_pending;
+  bool halted;
+  // T-cycles executed since power-on.
+  uint64_t cycles;
+  Scheduler scheduler;
+
+  // Host pointer to the start of each 4 KiB page of the address space, or
+  // nullptr if accesses to the page must go through MMU's slow path.
+  std::array<const uint8_t *, page_count> read_pages;
+  std::array<uint8_t *, page_count> write_pages;
+
+  alignas(64) std::array<uint8_t, 0x2000> wram; // 0xC000-0xDFFF
+  std::array<uint8_t, 0x80> io;                 // 0xFF00-0xFF7F
+  std::array<uint8_t, 0x7F> hram;               // 0xFF80-0xFFFE
+  uint8_t ie;                                   // 0xFFFF
+  // Currently held joypad buttons, a bitwise OR of Button values.
+  uint8_t buttons;
+  // Whether the PPU is running; it restarts at line 0 when LCDC bit 7 is set
+  // again.
+  bool lcd_on;
+  // Window row to draw on the next line that shows the window.
+  uint8_t window_line;
+  // Level of the combined STAT interrupt line; interrupts fire on its
+  // rising edge.
+  bool stat_line;
+  // CGB mode; for now this only enables the HDMA registers.
+  bool cgb_mode;
+  // While OAM DMA runs the CPU reads 0xFF from OAM and cannot write it.
+  bool oam_dma_active;
+  // HBlank DMA in progress: the next 16-byte block goes from `hdma_source`
+  // to VRAM offset `hdma_dest`; `hdma_blocks` are left.
+  bool hdma_active;
+  uint8_t hdma_blocks;
+  uint16_t hdma_source;
+  uint16_t hdma_dest;
+  alignas(64) std::array<uint8_t, 0x2000> vram; // 0x8000-0x9FFF
+  std::array<uint8_t, 0xA0> oam;                // 0xFE00-0xFE9F
+};
+
+static_assert(std::is_trivially_copyable_v<MachineState>);
+static_assert(offsetof(MachineState, scheduler) < 64);
+static_assert(offsetof(MachineState, read_pages) < 128);
+
+// Hash of the guest-visible state, for checking that two runs ended up in
+// the same place. Host pointers and padding are left out, so the value is
+// stable across processes and hosts.
+uint64_t hash_state(const MachineState &state);
+
+#endif // EMUGB_INCLUDE_MACHINE_STATE_HPP
@@ -3,6 +3,14 @@
 
 #include <cstdint>
 
+// Kinds of memory access; combined as a bit mask where a set is needed.
+enum class Access : uint8_t {
+  Read = 1,
+  Write = 2,
+  // Opcode fetch
+  Execute = 4,
+};
+
 class Memory {
 public:
   virtual uint8_t get_byte(uint16_t addr) const = 0;
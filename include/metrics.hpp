@@ -0,0 +1,94 @@
+#ifndef EMUGB_INCLUDE_METRICS_HPP
+#define EMUGB_INCLUDE_METRICS_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "triple_buffer.hpp"
+
+// Work done by one instance since it was created (see
+// GameBoy::get_counters()).
+struct PerfCounters {
+  uint64_t instructions = 0;
+  // Emulated T-cycles and frames, taken from the machine state; they go
+  // back when an older snapshot is loaded.
+  uint64_t cycles = 0;
+  uint64_t frames = 0;
+  // Cycles the CPU spent in HALT.
+  uint64_t halted_cycles = 0;
+  // Steps that looked for a compiled block, and how many found one (both
+  // stay 0 without an AOT program).
+  uint64_t block_lookups = 0;
+  uint64_t block_hits = 0;
+  // Bytes copied by OAM DMA and HDMA.
+  uint64_t dma_bytes = 0;
+};
+
+// Writes the counters of one instance as JSON lines on its own thread.
+//
+// The emulation thread only publishes a copy of the counters, typically once
+// per frame, through a triple buffer. Every `interval` the exporter thread
+// takes the newest copy and writes a line with the counters and the rates
+// since the previous line:
+//
+//   {"time":1.000,"instructions":...,"cycles":...,"frames":...,
+//    "halted_cycles":...,"block_lookups":...,"block_hits":...,
+//    "dma_bytes":...,"mips":...,"fps":...,"cycles_per_ns":...,
+//    "speed":...,"halted_share":...,"block_hit_rate":...}
+//
+// `time` is seconds since open(), and `speed` is emulated time over host
+// time (1.0 is real hardware). When nothing was published during an interval
+// the rates are 0, so a stalled instance shows up as such.
+class MetricsExporter {
+public:
+  // Writes to stdout if `path` is "-". Prints an error and returns nullptr if
+  // the file cannot be created.
+  static std::unique_ptr<MetricsExporter>
+  open(const std::string &path, std::chrono::milliseconds interval);
+
+  // Calls finish().
+  ~MetricsExporter();
+
+  MetricsExporter(const MetricsExporter &) = delete;
+  MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+  // Called from the emulation thread.
+  void publish(const PerfCounters &counters);
+  // Writes a last line for the last published counters and stops the
+  // exporter thread. Nothing may be published afterwards.
+  void finish();
+
+private:
+  struct Sample {
+    // Host time of publish(), since open().
+    uint64_t host_ns = 0;
+    PerfCounters counters;
+  };
+
+  std::FILE *file;
+  bool owns_file;
+  std::chrono::milliseconds interval;
+  std::chrono::steady_clock::time_point start;
+  TripleBuffer<Sample> samples;
+  // Only touched by the exporter thread.
+  Sample latest;
+  Sample previous;
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool stopping = false;
+  std::thread thread;
+
+  MetricsExporter(std::FILE *file, bool owns_file,
+                  std::chrono::milliseconds interval);
+  void run();
+  void write_line();
+};
+
+#endif // EMUGB_INCLUDE_METRICS_HPP
@@ -2,18 +2,211 @@
 #define EMUGB_INCLUDE_MMU_HPP
 
 #include "cartridge.hpp"
+#include "cheats.hpp"
+#include "machine_state.hpp"
 #include "memory.hpp"
+#include <array>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <span>
 
-class MMU : public Memory {
+struct TrapHit {
+  Access access;
+  uint16_t addr;
+  // The byte read or written, or the opcode about to be executed.
+  uint8_t value;
+};
+
+class Heatmap;
+class LinkPort;
+
+class MMU final : public Memory {
 private:
+  // Breakpoints, allocated when the first one is added.
+  struct Traps {
+    MachineState &state;
+    // Access bits per address.
+    std::array<uint8_t, 0x10000> flags{};
+    // Trapped addresses per page that need reads (or fetches) or writes to
+    // leave the page table.
+    std::array<uint32_t, MachineState::page_count> read_counts{};
+    std::array<uint32_t, MachineState::page_count> write_counts{};
+    std::optional<TrapHit> hit;
+    // Execute breakpoint to let through once, so that running again after
+    // stopping at it executes the instruction.
+    std::optional<uint16_t> resume_addr;
+
+    Traps(MachineState &state) : state(state) {}
+    bool has(Access access, uint16_t addr) const {
+      return (flags[addr] & static_cast<uint8_t>(access)) != 0;
+    }
+    void record(Access access, uint16_t addr, uint8_t value);
+  };
+
+  static constexpr size_t rom_page_count = 0x8000 / MachineState::page_size;
+  // Patched copies of the ROM pages that hold a ROM patch; nullptr for the
+  // others.
+  using RomPages = std::array<std::unique_ptr<uint8_t[]>, rom_page_count>;
+
+  // Kept as the first member so the hot part of the state block sits at the
+  // start of the MMU object.
+  MachineState state;
   std::unique_ptr<Cartridge> cartridge;
+  std::unique_ptr<Traps> traps;
+  // Allocated while ROM patches are set.
+  std::unique_ptr<RomPages> patched_rom;
+  LinkPort *link = nullptr;
+  // Bytes copied by OAM DMA and HDMA, for metrics.
+  uint64_t dma_bytes = 0;
+#ifdef EMUGB_HEATMAP
+  Heatmap *heatmap = nullptr;
+#endif
+
+  void map_pages();
+  uint8_t get_byte_slow(uint16_t addr) const;
+  uint8_t read_unmapped(uint16_t addr) const;
+  void set_byte_slow(uint16_t addr, uint8_t value);
+  void write_unmapped(uint16_t addr, uint8_t value);
+  bool fetch_opcode_slow(uint16_t addr, uint8_t &opcode);
+  void copy_block(uint16_t src, uint8_t *dst, size_t size) const;
+  void start_oam_dma(uint8_t value);
+  void start_hdma(uint8_t value);
+  void write_serial_control(uint8_t value);
 
 public:
-  MMU(std::unique_ptr<Cartridge> cartridge) : cartridge(std::move(cartridge)) {}
+  MMU(std::unique_ptr<Cartridge> cartridge);
+
+  MMU(const MMU &) = delete;
+  MMU &operator=(const MMU &) = delete;
+
+  uint8_t get_byte(uint16_t addr) const override {
+#ifdef EMUGB_HEATMAP
+    record_access(Access::Read, addr);
+#endif
+    const uint8_t *page = state.read_pages[addr >> MachineState::page_shift];
+    if (page != nullptr) [[likely]] {
+      return page[addr & (MachineState::page_size - 1)];
+    }
+    return get_byte_slow(addr);
+  }
+
+  void set_byte(uint16_t addr, uint8_t value) override {
+#ifdef EMUGB_HEATMAP
+    record_access(Access::Write, addr);
+#endif
+    uint8_t *page = state.write_pages[addr >> MachineState::page_shift];
+    if (page != nullptr) [[likely]] {
+      page[addr & (MachineState::page_size - 1)] = value;
+      return;
+    }
+    set_byte_slow(addr, value);
+  }
+
+  // Opcode fetch, which unlike get_byte() honours execute breakpoints.
+  // Returns false, without fetching, when one stops execution at `addr`.
+  bool fetch_opcode(uint16_t addr, uint8_t &opcode) {
+#ifdef EMUGB_HEATMAP
+    record_access(Access::Execute, addr);
+#endif
+    const uint8_t *page = state.read_pages[addr >> MachineState::page_shift];
+    if (page != nullptr) [[likely]] {
+      opcode = page[addr & (MachineState::page_size - 1)];
+      return true;
+    }
+    return fetch_opcode_slow(addr, opcode);
+  }
+
+  // Reads a byte without triggering breakpoints or counting the access, for
+  // debuggers and the disassembler.
+  uint8_t peek(uint16_t addr) const {
+    const uint8_t *page = state.read_pages[addr >> MachineState::page_shift];
+    if (page != nullptr) [[likely]] {
+      return page[addr & (MachineState::page_size - 1)];
+    }
+    return read_unmapped(addr);
+  }
 
-  uint8_t get_byte(uint16_t addr) const override;
-  void set_byte(uint16_t addr, uint8_t value) override;
+  // Writes a byte without triggering breakpoints or counting the access, for
+  // cheats and debuggers. Side effects of I/O registers still apply.
+  void poke(uint16_t addr, uint8_t value) {
+    uint8_t *page = state.write_pages[addr >> MachineState::page_shift];
+    if (page != nullptr) [[likely]] {
+      page[addr & (MachineState::page_size - 1)] = value;
+      return;
+    }
+    write_unmapped(addr, value);
+  }
+
+  MachineState &get_state() { return state; }
+  const MachineState &get_state() const { return state; }
+  const Cartridge &get_cartridge() const { return *cartridge; }
+
+  // Updates the held joypad buttons (a bitwise OR of Button values).
+  void set_buttons(uint8_t buttons);
+
+  // Snapshots are plain copies of the state block.
+  void save_state(MachineState &snapshot) const { snapshot = state; }
+  void load_state(const MachineState &snapshot);
+  // Same as above for a copy held in a plain byte buffer of
+  // sizeof(MachineState) bytes, which need not be suitably aligned.
+  void load_state(const void *snapshot);
+
+  // DMA. OAM DMA (0xFF46) copies all 160 bytes when started and keeps OAM
+  // off-limits to the CPU until Event::OamDma. In CGB mode, 0xFF55 starts a
+  // general-purpose DMA, copied and paid for in stalled cycles at once, or
+  // an HBlank DMA, copied one 16-byte block per Event::Hdma, which the PPU
+  // schedules at the start of every HBlank.
+  void finish_oam_dma() { state.oam_dma_active = false; }
+  void run_hdma_block();
+  uint64_t get_dma_bytes() const { return dma_bytes; }
+
+  // Serial port. An internal-clock transfer started through SC (0xFF02)
+  // goes over the link cable if one is connected, and otherwise receives
+  // 0xFF when Event::Serial fires after 8 bits at 8192 Hz.
+  void set_link(LinkPort *port);
+  void sync_link();
+  // Ends the current transfer: SB takes `received` and the serial interrupt
+  // is requested.
+  void complete_serial_transfer(uint8_t received);
+
+  // ROM patches replace the set before. Every page holding one is mapped to
+  // a patched copy, made from the banks mapped at the time, so reads keep
+  // the fast path and pages without patches are not affected at all. A
+  // patch with a compare value only applies if the ROM holds that value.
+  void set_rom_patches(std::span<const RomPatch> patches);
+  bool has_rom_patches() const { return patched_rom != nullptr; }
+
+  // Breakpoints. Pages that hold one are taken out of the page table, so
+  // accesses elsewhere keep the fast path and only accesses to those pages
+  // compare exact addresses. A hit schedules Event::Debug for the current
+  // cycle: execute breakpoints stop before the instruction, read and write
+  // breakpoints after the instruction that made the access.
+  void add_trap(Access access, uint16_t addr);
+  void remove_trap(Access access, uint16_t addr);
+  void clear_traps();
+  bool has_traps() const { return traps != nullptr; }
+  // Returns and forgets the first hit since the last call.
+  std::optional<TrapHit> take_trap_hit();
+
+#ifdef EMUGB_HEATMAP
+  // Counts every access into `heatmap` (not owned) until replaced; nullptr
+  // stops counting.
+  void set_heatmap(Heatmap *heatmap) { this->heatmap = heatmap; }
+
+private:
+  void record_access(Access access, uint16_t addr) const;
+#endif
 };
 
+#ifdef EMUGB_HEATMAP
+#include "heatmap.hpp"
+
+inline void MMU::record_access(Access access, uint16_t addr) const {
+  if (heatmap != nullptr) [[unlikely]] {
+    heatmap->record(access, addr);
+  }
+}
+#endif
+
 #endif // EMUGB_INCLUDE_MMU_HPP
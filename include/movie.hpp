@@ -0,0 +1,57 @@
+#ifndef EMUGB_INCLUDE_MOVIE_HPP
+#define EMUGB_INCLUDE_MOVIE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "gameboy.hpp"
+
+// The held buttons change to `buttons` at the start of `frame`.
+struct MovieInput {
+  uint32_t frame;
+  uint8_t buttons;
+};
+
+// A recorded run: frame-indexed joypad changes plus the state hash the run
+// ended with, so that replaying it doubles as a determinism check.
+//
+// On disk: the magic "EMUGBMOV", a little-endian header (u16 version,
+// u32 frame count, u64 ROM hash, u64 final state hash, u32 input count) and
+// one (varint frame delta, u8 buttons) pair per input change.
+struct Movie {
+  static constexpr uint16_t version = 1;
+
+  uint64_t rom_hash = 0;
+  uint32_t frame_count = 0;
+  uint64_t final_state_hash = 0;
+  std::vector<MovieInput> inputs;
+
+  static std::optional<Movie> load(const std::string &path);
+  bool save(const std::string &path) const;
+};
+
+// Builds a movie from the buttons held in each frame of a run.
+class MovieRecorder {
+public:
+  MovieRecorder(uint64_t rom_hash);
+
+  // Records the buttons held during `frame`; frames must be non-decreasing.
+  void record(uint32_t frame, uint8_t buttons);
+  Movie finish(uint32_t frame_count, uint64_t final_state_hash);
+
+private:
+  Movie movie;
+  uint8_t last_buttons = 0;
+};
+
+// Replays `movie` from the current state of `gameboy` and returns the final
+// state hash. `after_frame`, if set, is called with each finished frame.
+uint64_t play_movie(
+    GameBoy &gameboy, const Movie &movie,
+    const std::function<void(uint32_t frame)> &after_frame = nullptr);
+
+#endif // EMUGB_INCLUDE_MOVIE_HPP
@@ -0,0 +1,354 @@
+#ifndef EMUGB_INCLUDE_OPCODES_HPP
+#define EMUGB_INCLUDE_OPCODES_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+enum class Operand : uint8_t {
+  None,
+  // 8-bit registers in the order of the 3-bit register field of opcodes,
+  // with (HL) in place 6.
+  B,
+  C,
+  D,
+  E,
+  H,
+  L,
+  HlIndirect,
+  A,
+  BC,
+  DE,
+  HL,
+  SP,
+  AF,
+  BcIndirect,
+  DeIndirect,
+  HlIncrement, // (HL+)
+  HlDecrement, // (HL-)
+  CondNz,
+  CondZ,
+  CondNc,
+  CondC,
+  Imm8,
+  Imm16,
+  // Signed 8-bit immediate (ADD SP, e8).
+  Signed8,
+  // Signed 8-bit offset from the next instruction (JR).
+  Relative8,
+  // (a16)
+  Address16,
+  // (0xFF00 + a8) of LDH.
+  HighAddress8,
+  // (0xFF00 + C) of LDH.
+  HighC,
+  // SP plus a signed 8-bit immediate.
+  SpOffset,
+  // The bit number of BIT/RES/SET, held in OpcodeInfo::value.
+  Bit,
+  // The target of RST, held in OpcodeInfo::value.
+  Vector,
+};
+
+struct OpcodeInfo {
+  // Empty for opcodes that do not exist.
+  std::string_view mnemonic;
+  // In bytes, including the 0xCB prefix.
+  uint8_t length;
+  // T-cycles, with conditional branches not taken. Opcodes that do not exist
+  // count as 4 so that execution always makes progress.
+  uint8_t cycles;
+  // T-cycles when a conditional branch is taken; `cycles` otherwise.
+  uint8_t branch_cycles;
+  std::array<Operand, 2> operands;
+  // Bit number or RST target.
+  uint8_t value;
+  // Effect on Z, N, H and C, in that order: '-' unchanged, '0' or '1' set
+  // to that value, or the flag's letter if it depends on the result.
+  std::string_view flags;
+};
+
+namespace opcode_detail {
+
+constexpr std::array<Operand, 8> registers = {
+    Operand::B, Operand::C, Operand::D,          Operand::E,
+    Operand::H, Operand::L, Operand::HlIndirect, Operand::A,
+};
+constexpr std::array<Operand, 4> pairs = {Operand::BC, Operand::DE,
+                                          Operand::HL, Operand::SP};
+constexpr std::array<Operand, 4> stack_pairs = {Operand::BC, Operand::DE,
+                                                Operand::HL, Operand::AF};
+constexpr std::array<Operand, 4> conditions = {
+    Operand::CondNz, Operand::CondZ, Operand::CondNc, Operand::CondC};
+
+// T-cycles of each base opcode with conditional branches not taken.
+constexpr std::array<uint8_t, 256> base_cycles = {
+    // clang-format off
+    4, 12,  8,  8,  4,  4,  8,  4, 20,  8,  8,  8,  4,  4,  8,  4, // 0x00
+    4, 12,  8,  8,  4,  4,  8,  4, 12,  8,  8,  8,  4,  4,  8,  4, // 0x10
+    8, 12,  8,  8,  4,  4,  8,  4,  8,  8,  8,  8,  4,  4,  8,  4, // 0x20
+    8, 12,  8,  8, 12, 12, 12,  4,  8,  8,  8,  8,  4,  4,  8,  4, // 0x30
+    4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4, // 0x40
+    4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4, // 0x50
+    4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4, // 0x60
+    8,  8,  8,  8,  8,  8,  4,  8,  4,  4,  4,  4,  4,  4,  8,  4, // 0x70
+    4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4, // 0x80
+    4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4, // 0x90
+    4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4, // 0xA0
+    4,  4,  4,  4,  4,  4,  8,  4,  4,  4,  4,  4,  4,  4,  8,  4, // 0xB0
+    8, 12, 12, 16, 12, 16,  8, 16,  8, 16, 12,  4, 12, 24,  8, 16, // 0xC0
+    8, 12, 12,  4, 12, 16,  8, 16,  8, 16, 12,  4, 12,  4,  8, 16, // 0xD0
+   12, 12,  8,  4,  4, 16,  8, 16, 16,  4, 16,  4,  4,  4,  8, 16, // 0xE0
+   12, 12,  8,  4,  4, 16,  8, 16, 12,  8, 16,  4,  4,  4,  8, 16, // 0xF0
+    // clang-format on
+};
+
+constexpr uint8_t operand_bytes(Operand operand) {
+  switch (operand) {
+  case Operand::Imm8:
+  case Operand::Signed8:
+  case Operand::Relative8:
+  case Operand::HighAddress8:
+  case Operand::SpOffset:
+    return 1;
+  case Operand::Imm16:
+  case Operand::Address16:
+    return 2;
+  default:
+    return 0;
+  }
+}
+
+constexpr OpcodeInfo make(std::string_view mnemonic,
+                          std::array<Operand, 2> operands,
+                          std::string_view flags = "----", uint8_t value = 0) {
+  return {mnemonic,
+          static_cast<uint8_t>(1 + operand_bytes(operands[0]) +
+                               operand_bytes(operands[1])),
+          0,
+          0,
+          operands,
+          value,
+          flags};
+}
+
+constexpr OpcodeInfo decode_base(uint8_t opcode) {
+  const uint8_t x = opcode >> 6;
+  const uint8_t y = (opcode >> 3) & 0x07;
+  const uint8_t z = opcode & 0x07;
+  const uint8_t p = y >> 1;
+  const bool q = (y & 1) != 0;
+  constexpr Operand none = Operand::None;
+
+  constexpr std::array<std::string_view, 8> alu = {
+      "ADD", "ADC", "SUB", "SBC", "AND", "XOR", "OR", "CP"};
+  constexpr std::array<std::string_view, 8> alu_flags = {
+      "Z0HC", "Z0HC", "Z1HC", "Z1HC", "Z010", "Z000", "Z000", "Z1HC"};
+  constexpr std::array<std::string_view, 8> accumulator_ops = {
+      "RLCA", "RRCA", "RLA", "RRA", "DAA", "CPL", "SCF", "CCF"};
+  constexpr std::array<std::string_view, 8> accumulator_flags = {
+      "000C", "000C", "000C", "000C", "Z-0C", "-11-", "-001", "-00C"};
+  constexpr std::array<Operand, 4> indirect = {
+      Operand::BcIndirect, Operand::DeIndirect, Operand::HlIncrement,
+      Operand::HlDecrement};
+
+  switch (x) {
+  case 0:
+    switch (z) {
+    case 0:
+      if (y == 0) {
+        return make("NOP", {none, none});
+      }
+      if (y == 1) {
+        return make("LD", {Operand::Address16, Operand::SP});
+      }
+      if (y == 2) {
+        // STOP is executed as a single byte; the byte after it is decoded
+        // as the next instruction.
+        return make("STOP", {none, none});
+      }
+      if (y == 3) {
+        return make("JR", {Operand::Relative8, none});
+      }
+      return make("JR", {conditions[y - 4], Operand::Relative8});
+    case 1:
+      return q ? make("ADD", {Operand::HL, pairs[p]}, "-0HC")
+               : make("LD", {pairs[p], Operand::Imm16});
+    case 2:
+      return q ? make("LD", {Operand::A, indirect[p]})
+               : make("LD", {indirect[p], Operand::A});
+    case 3:
+      return make(q ? "DEC" : "INC", {pairs[p], none});
+    case 4:
+      return make("INC", {registers[y], none}, "Z0H-");
+    case 5:
+      return make("DEC", {registers[y], none}, "Z1H-");
+    case 6:
+      return make("LD", {registers[y], Operand::Imm8});
+    default:
+      return make(accumulator_ops[y], {none, none}, accumulator_flags[y]);
+    }
+
+  case 1:
+    if (y == 6 && z == 6) {
+      return make("HALT", {none, none});
+    }
+    return make("LD", {registers[y], registers[z]});
+
+  case 2:
+    return make(alu[y], {Operand::A, registers[z]}, alu_flags[y]);
+
+  default:
+    switch (z) {
+    case 0:
+      if (y < 4) {
+        return make("RET", {conditions[y], none});
+      }
+      if (y == 4) {
+        return make("LDH", {Operand::HighAddress8, Operand::A});
+      }
+      if (y == 5) {
+        return make("ADD", {Operand::SP, Operand::Signed8}, "00HC");
+      }
+      if (y == 6) {
+        return make("LDH", {Operand::A, Operand::HighAddress8});
+      }
+      return make("LD", {Operand::HL, Operand::SpOffset}, "00HC");
+    case 1:
+      if (!q) {
+        return make("POP", {stack_pairs[p], none},
+                    p == 3 ? "ZNHC" : "----");
+      }
+      if (p == 0) {
+        return make("RET", {none, none});
+      }
+      if (p == 1) {
+        return make("RETI", {none, none});
+      }
+      if (p == 2) {
+        return make("JP", {Operand::HL, none});
+      }
+      return make("LD", {Operand::SP, Operand::HL});
+    case 2:
+      if (y < 4) {
+        return make("JP", {conditions[y], Operand::Imm16});
+      }
+      if (y == 4) {
+        return make("LDH", {Operand::HighC, Operand::A});
+      }
+      if (y == 5) {
+        return make("LD", {Operand::Address16, Operand::A});
+      }
+      if (y == 6) {
+        return make("LDH", {Operand::A, Operand::HighC});
+      }
+      return make("LD", {Operand::A, Operand::Address16});
+    case 3:
+      if (y == 0) {
+        return make("JP", {Operand::Imm16, none});
+      }
+      if (y == 1) {
+        // The prefix alone; the CB table describes the instruction.
+        return make("PREFIX", {none, none});
+      }
+      if (y == 6) {
+        return make("DI", {none, none});
+      }
+      if (y == 7) {
+        return make("EI", {none, none});
+      }
+      return make({}, {none, none});
+    case 4:
+      if (y < 4) {
+        return make("CALL", {conditions[y], Operand::Imm16});
+      }
+      return make({}, {none, none});
+    case 5:
+      if (!q) {
+        return make("PUSH", {stack_pairs[p], none});
+      }
+      if (p == 0) {
+        return make("CALL", {Operand::Imm16, none});
+      }
+      return make({}, {none, none});
+    case 6:
+      return make(alu[y], {Operand::A, Operand::Imm8}, alu_flags[y]);
+    default:
+      return make("RST", {Operand::Vector, none}, "----",
+                  static_cast<uint8_t>(y * 8));
+    }
+  }
+}
+
+constexpr OpcodeInfo decode_cb(uint8_t opcode) {
+  const uint8_t x = opcode >> 6;
+  const uint8_t y = (opcode >> 3) & 0x07;
+  const Operand target = registers[opcode & 0x07];
+  constexpr std::array<std::string_view, 8> shifts = {
+      "RLC", "RRC", "RL", "RR", "SLA", "SRA", "SWAP", "SRL"};
+
+  OpcodeInfo info;
+  switch (x) {
+  case 0:
+    info = make(shifts[y], {target, Operand::None}, y == 6 ? "Z000" : "Z00C");
+    break;
+  case 1:
+    info = make("BIT", {Operand::Bit, target}, "Z01-", y);
+    break;
+  case 2:
+    info = make("RES", {Operand::Bit, target}, "----", y);
+    break;
+  default:
+    info = make("SET", {Operand::Bit, target}, "----", y);
+    break;
+  }
+  info.length = 2;
+  // (HL) adds a read, and a write unless the instruction is BIT.
+  const bool memory = target == Operand::HlIndirect;
+  info.cycles = !memory ? 8 : x == 1 ? 12 : 16;
+  info.branch_cycles = info.cycles;
+  return info;
+}
+
+constexpr std::array<OpcodeInfo, 512> make_table() {
+  std::array<OpcodeInfo, 512> table{};
+  for (size_t opcode = 0; opcode < 256; ++opcode) {
+    OpcodeInfo info = decode_base(static_cast<uint8_t>(opcode));
+    info.cycles = base_cycles[opcode];
+    info.branch_cycles = info.cycles;
+    const Operand first = info.operands[0];
+    if (first >= Operand::CondNz && first <= Operand::CondC) {
+      // Taken JR/JP add 4 cycles, taken CALL and RET 12.
+      const bool jump = info.mnemonic == "JR" || info.mnemonic == "JP";
+      info.branch_cycles = info.cycles + (jump ? 4 : 12);
+    }
+    table[opcode] = info;
+    table[256 + opcode] = decode_cb(static_cast<uint8_t>(opcode));
+  }
+  return table;
+}
+
+} // namespace opcode_detail
+
+// Base opcodes at [0, 256), 0xCB-prefixed ones at [256, 512).
+inline constexpr std::array<OpcodeInfo, 512> opcode_table =
+    opcode_detail::make_table();
+
+constexpr const OpcodeInfo &get_opcode_info(uint8_t opcode) {
+  return opcode_table[opcode];
+}
+
+constexpr const OpcodeInfo &get_cb_opcode_info(uint8_t opcode) {
+  return opcode_table[256 + opcode];
+}
+
+static_assert(get_opcode_info(0xCD).length == 3 &&
+              get_opcode_info(0xCD).cycles == 24);
+static_assert(get_opcode_info(0xC4).branch_cycles == 24);
+static_assert(get_opcode_info(0x20).branch_cycles == 12);
+static_assert(get_opcode_info(0xF8).flags == "00HC");
+static_assert(get_cb_opcode_info(0x46).cycles == 12);
+static_assert(get_opcode_info(0xD3).mnemonic.empty());
+
+#endif // EMUGB_INCLUDE_OPCODES_HPP
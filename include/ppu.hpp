@@ -0,0 +1,67 @@
+#ifndef EMUGB_INCLUDE_PPU_HPP
+#define EMUGB_INCLUDE_PPU_HPP
+
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+
+#include "machine_state.hpp"
+
+// Scanline-based DMG picture processing unit.
+//
+// Mode changes, LY/LYC/STAT and the VBlank/STAT interrupts are driven by
+// Event::Ppu, whether or not pixels are drawn. Drawing a line happens when
+// the line enters HBlank and can be switched off per frame; all guest-visible
+// state is updated the same way either way.
+//
+// Each line is hashed as it is drawn, so comparing screens costs a look at
+// the lines that changed rather than a pass over the framebuffer.
+class PPU {
+public:
+  static constexpr size_t width = 160;
+  static constexpr size_t height = 144;
+  static constexpr uint64_t cycles_per_line = 456;
+  static constexpr uint8_t lines_per_frame = 154;
+
+  PPU(MachineState &state);
+
+  // Starts line 0 at the current cycle.
+  void reset();
+
+  // Handles Event::Ppu that was due at `deadline`. Returns true if VBlank
+  // started.
+  bool update(uint64_t deadline);
+
+  void set_render_enabled(bool enabled) { render_enabled = enabled; }
+  bool is_render_enabled() const { return render_enabled; }
+
+  // Shades 0 (white) to 3 (black), row-major.
+  const std::array<uint8_t, width * height> &get_framebuffer() const {
+    return framebuffer;
+  }
+
+  // hash64() of each framebuffer line.
+  const std::array<uint64_t, height> &get_line_hashes() const {
+    return line_hashes;
+  }
+  // Hash of the whole framebuffer, combined from the line hashes.
+  uint64_t get_frame_hash() const;
+  // Returns the lines drawn differently from what they held before since
+  // the last call, and starts over.
+  std::bitset<height> take_changed_lines();
+
+private:
+  MachineState &state;
+  bool render_enabled = true;
+  std::array<uint8_t, width * height> framebuffer;
+  std::array<uint64_t, height> line_hashes;
+  std::bitset<height> changed_lines;
+
+  void set_mode(uint8_t mode);
+  void start_line(uint8_t ly);
+  void update_stat_line();
+  void render_line(uint8_t ly);
+};
+
+#endif // EMUGB_INCLUDE_PPU_HPP
@@ -0,0 +1,66 @@
+#ifndef EMUGB_INCLUDE_PROFILER_HPP
+#define EMUGB_INCLUDE_PROFILER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "control_flow.hpp"
+#include "symbols.hpp"
+
+class MMU;
+
+// Sampling profile of where emulated time goes, by guest routine.
+//
+// GameBoy::set_profiler() makes Event::Profile call sample() every
+// `interval` emulated cycles, so the cost is independent of the instructions
+// executed. Each sample stands for `interval` cycles and records the (bank,
+// PC) about to execute, whether the CPU is halted, and the guest call stack.
+//
+// The Game Boy has no frame pointers, so the call stack is recovered by
+// scanning the stack from SP up: a word that points into ROM just past a
+// CALL or RST (other than RST 0x38) is taken as a return address and
+// attributed to that instruction. Data that looks like a return address adds
+// a spurious caller. Interrupt handlers show up under the callers of the
+// code they interrupted, since the interrupted PC itself is not preceded by
+// a call.
+//
+// Samples are aggregated per distinct stack as they are taken. Symbols are
+// only needed for the report.
+class Profiler {
+public:
+  // Deepest stack recorded, and how many stack words are scanned for it.
+  static constexpr size_t max_depth = 32;
+  static constexpr size_t max_scan_words = 64;
+
+  // `interval` is rounded up to a multiple of 4 cycles, so that sampling
+  // never moves the CPU out of HALT at a different cycle.
+  Profiler(uint64_t interval = 1024);
+
+  uint64_t get_interval() const { return interval; }
+  uint64_t get_sample_count() const { return sample_count; }
+
+  void sample(const MMU &mmu);
+  void clear();
+
+  // A flat profile (self and total share of cycles per routine) followed by
+  // the call tree, with routines named by `symbols`.
+  std::string format(const SymbolTable &symbols) const;
+  bool write(const std::string &path, const SymbolTable &symbols) const;
+
+private:
+  struct Counts {
+    uint64_t samples = 0;
+    uint64_t halted = 0;
+  };
+
+  uint64_t interval;
+  uint64_t sample_count = 0;
+  // Keyed by the stack, outermost caller first and the sampled PC last.
+  std::map<std::vector<CodeAddress>, Counts> stacks;
+  std::vector<CodeAddress> frames;
+};
+
+#endif // EMUGB_INCLUDE_PROFILER_HPP
@@ -26,6 +26,21 @@ public:
 
   RegFile() : a(0), f(0), b(0), c(0), d(0), e(0), h(0), l(0), sp(0), pc(0) {}
 
+  // Register values left behind by the DMG boot ROM when it hands control to
+  // the cartridge entry point.
+  inline void reset_post_boot() {
+    a = 0x01;
+    f = 0xB0;
+    b = 0x00;
+    c = 0x13;
+    d = 0x00;
+    e = 0xD8;
+    h = 0x01;
+    l = 0x4D;
+    sp = 0xFFFE;
+    pc = 0x0100;
+  }
+
   inline uint16_t get_af() const {
     const uint16_t af = (static_cast<uint16_t>(a) << 8) | f;
     return af;
@@ -0,0 +1,72 @@
+#ifndef EMUGB_INCLUDE_ROM_CATALOG_HPP
+#define EMUGB_INCLUDE_ROM_CATALOG_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "rom_header.hpp"
+#include "thread_pool.hpp"
+
+struct CatalogEntry {
+  std::string path;
+  uint64_t file_size = 0;
+  // Last write time, in ticks of std::filesystem::file_time_type.
+  int64_t mtime = 0;
+  // hash64() of the whole file, the same hash movies record.
+  uint64_t hash = 0;
+  RomHeader header;
+};
+
+// An on-disk index of ROM files.
+//
+// Scanning only reads files that are new or whose size or modification
+// time changed since the last scan, so keeping a large library indexed is
+// mostly directory walking. Loading the catalog reads one file.
+//
+// On disk: the magic "EMUGBCAT", a little-endian u16 version and u32 entry
+// count, then per entry: u16 path length and path, u64 file size, i64
+// mtime, u64 hash, u8 CGB flag, u8 cartridge type, u32 ROM size, u32 RAM
+// size, u8 header checksum, u16 global checksum, u8 flags (bit 0: header
+// checksum ok, bit 1: global checksum ok), u8 title length and title.
+class RomCatalog {
+public:
+  static constexpr uint16_t version = 1;
+
+  struct ScanStats {
+    size_t files = 0;
+    // Read and hashed, because they are new or changed.
+    size_t hashed = 0;
+    // Left out because they could not be read or have no valid header.
+    size_t failed = 0;
+    // Entries under a scanned directory whose file is gone.
+    size_t removed = 0;
+  };
+
+  // A missing file is an empty catalog; nullopt means the file is corrupt.
+  static std::optional<RomCatalog> load(const std::string &path);
+  bool save(const std::string &path) const;
+
+  // Recursively indexes every .gb/.gbc file under `roots`, hashing on
+  // `pool`.
+  ScanStats scan(const std::vector<std::filesystem::path> &roots,
+                 ThreadPool &pool);
+
+  const std::vector<CatalogEntry> &get_entries() const { return entries; }
+  const CatalogEntry *find_by_hash(uint64_t hash) const;
+  // Case-insensitive substring match.
+  std::vector<const CatalogEntry *> find_by_title(std::string_view text) const;
+
+private:
+  std::vector<CatalogEntry> entries;
+  std::unordered_map<uint64_t, size_t> by_hash;
+
+  void rebuild_index();
+};
+
+#endif // EMUGB_INCLUDE_ROM_CATALOG_HPP
@@ -0,0 +1,60 @@
+#ifndef EMUGB_INCLUDE_ROM_FILE_HPP
+#define EMUGB_INCLUDE_ROM_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cartridge.hpp"
+
+// Reads a ROM image from a raw file, a gzip file or a zip archive (stored
+// or deflate; the first .gb/.gbc entry, else the first file). Compressed
+// data is inflated straight into the returned buffer while the file is
+// read, without temporary files.
+std::expected<std::vector<uint8_t>, LoadError>
+read_rom_file(const std::string &path);
+
+// ROM images as returned by read_rom_file(), by file. The least recently
+// used ones are dropped once their total size exceeds the capacity. A file
+// that changed on disk (size or modification time) is a miss. Safe to share
+// between threads.
+class RomCache {
+public:
+  RomCache(size_t capacity_bytes);
+
+  RomCache(const RomCache &) = delete;
+  RomCache &operator=(const RomCache &) = delete;
+
+  // Returns the cached image of `path`, reading and inserting it on a miss.
+  std::expected<RomImage, LoadError> load(const std::string &path);
+
+  void set_capacity(size_t capacity_bytes);
+  size_t get_size() const;
+  uint64_t get_hits() const;
+  uint64_t get_misses() const;
+
+private:
+  struct Entry {
+    std::string key;
+    RomImage image;
+  };
+
+  mutable std::mutex mutex;
+  size_t capacity;
+  size_t size = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  // Most recently used first.
+  std::list<Entry> entries;
+  std::unordered_map<std::string, std::list<Entry>::iterator> by_key;
+
+  void evict();
+};
+
+#endif // EMUGB_INCLUDE_ROM_FILE_HPP
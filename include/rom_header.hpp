@@ -0,0 +1,41 @@
+#ifndef EMUGB_INCLUDE_ROM_HEADER_HPP
+#define EMUGB_INCLUDE_ROM_HEADER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+// The cartridge header at 0x0100-0x014F.
+struct RomHeader {
+  static constexpr size_t end = 0x0150;
+
+  std::string title;
+  // 0x80: also runs on DMG, 0xC0: CGB only, anything else: DMG game.
+  uint8_t cgb_flag = 0;
+  uint8_t cartridge_type = 0;
+  // In bytes; 0 if the size code is unknown.
+  uint32_t rom_size = 0;
+  uint32_t ram_size = 0;
+  uint8_t header_checksum = 0;
+  uint16_t global_checksum = 0;
+  bool header_checksum_ok = false;
+  // Real hardware never checks this one; plenty of ROMs get it wrong.
+  bool global_checksum_ok = false;
+
+  bool is_cgb() const { return (cgb_flag & 0x80) != 0; }
+
+  // Returns nullopt if `rom` is too small to hold a header.
+  static std::optional<RomHeader> parse(std::span<const uint8_t> rom);
+};
+
+// The title field, up to the first NUL. CGB games use its last byte as the
+// CGB flag, so it is one byte shorter for them.
+std::string read_title(std::span<const uint8_t> rom);
+
+// E.g. "MBC1+RAM+BATTERY"; "unknown" for unassigned codes.
+std::string_view cartridge_type_name(uint8_t cartridge_type);
+
+#endif // EMUGB_INCLUDE_ROM_HEADER_HPP
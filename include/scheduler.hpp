@@ -0,0 +1,76 @@
+#ifndef EMUGB_INCLUDE_SCHEDULER_HPP
+#define EMUGB_INCLUDE_SCHEDULER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// Hardware events that happen at a known future cycle.
+enum class Event : uint8_t {
+  Ppu,     // Next PPU mode or line change
+  OamDma,  // OAM DMA finishes
+  Hdma,    // HBlank DMA copies its next block
+  Serial,  // Serial transfer with nothing connected finishes
+  Link,    // Link cable synchronisation point
+  Debug,   // A breakpoint was hit
+  Profile, // The profiler takes its next sample
+  Count
+};
+
+// Deadlines of pending events, in absolute T-cycles. The emulation loop only
+// compares the cycle counter against `next` after each instruction, so
+// components are not stepped cycle by cycle. Lives in MachineState and is
+// trivially copyable.
+struct Scheduler {
+  static constexpr uint64_t never = std::numeric_limits<uint64_t>::max();
+  static constexpr size_t event_count = static_cast<size_t>(Event::Count);
+
+  // Earliest deadline of all events.
+  uint64_t next;
+  std::array<uint64_t, event_count> deadlines;
+
+  void clear() {
+    deadlines.fill(never);
+    next = never;
+  }
+
+  void schedule(Event event, uint64_t cycle) {
+    deadlines[static_cast<size_t>(event)] = cycle;
+    refresh();
+  }
+
+  void cancel(Event event) { schedule(event, never); }
+
+  uint64_t get_deadline(Event event) const {
+    return deadlines[static_cast<size_t>(event)];
+  }
+
+  // Removes the earliest event due at `now`. Returns false if none is due.
+  bool pop_due(uint64_t now, Event &event, uint64_t &deadline) {
+    if (next > now) {
+      return false;
+    }
+    size_t earliest = 0;
+    for (size_t i = 1; i < event_count; ++i) {
+      if (deadlines[i] < deadlines[earliest]) {
+        earliest = i;
+      }
+    }
+    event = static_cast<Event>(earliest);
+    deadline = deadlines[earliest];
+    deadlines[earliest] = never;
+    refresh();
+    return true;
+  }
+
+private:
+  void refresh() {
+    next = never;
+    for (const uint64_t deadline : deadlines) {
+      next = deadline < next ? deadline : next;
+    }
+  }
+};
+
+#endif // EMUGB_INCLUDE_SCHEDULER_HPP
@@ -0,0 +1,58 @@
+#ifndef EMUGB_INCLUDE_SPSC_CHANNEL_HPP
+#define EMUGB_INCLUDE_SPSC_CHANNEL_HPP
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+
+// A bounded lock-free queue between exactly one producer thread and one
+// consumer thread.
+//
+// Each side keeps a cached copy of the other side's index and only reloads
+// it when the queue looks full or empty, so an uncontended push or pop
+// touches no cache line written by the other thread.
+template <typename T, size_t Capacity> class SpscChannel {
+  static_assert(std::has_single_bit(Capacity),
+                "capacity must be a power of two");
+
+public:
+  // Producer side. Returns false if the queue is full.
+  bool try_push(const T &value) {
+    const size_t tail = write_index.load(std::memory_order_relaxed);
+    if (tail - cached_read_index == Capacity) {
+      cached_read_index = read_index.load(std::memory_order_acquire);
+      if (tail - cached_read_index == Capacity) {
+        return false;
+      }
+    }
+    slots[tail & (Capacity - 1)] = value;
+    write_index.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false if the queue is empty.
+  bool try_pop(T &value) {
+    const size_t head = read_index.load(std::memory_order_relaxed);
+    if (head == cached_write_index) {
+      cached_write_index = write_index.load(std::memory_order_acquire);
+      if (head == cached_write_index) {
+        return false;
+      }
+    }
+    value = slots[head & (Capacity - 1)];
+    read_index.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  // Written by the consumer.
+  alignas(64) std::atomic<size_t> read_index = 0;
+  size_t cached_write_index = 0;
+  // Written by the producer.
+  alignas(64) std::atomic<size_t> write_index = 0;
+  size_t cached_read_index = 0;
+  alignas(64) std::array<T, Capacity> slots{};
+};
+
+#endif // EMUGB_INCLUDE_SPSC_CHANNEL_HPP
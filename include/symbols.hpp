@@ -0,0 +1,39 @@
+#ifndef EMUGB_INCLUDE_SYMBOLS_HPP
+#define EMUGB_INCLUDE_SYMBOLS_HPP
+
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "control_flow.hpp"
+
+// Routine names from an RGBDS or no$gmb symbol file: one "BB:AAAA Name" per
+// line, bank and address in hex, with ';' starting a comment. RAM addresses
+// use the bank of their region (0 for WRAM0 and HRAM, 1 for WRAMX on a DMG).
+class SymbolTable {
+public:
+  // Returns nullopt if the file cannot be read; lines that are not symbols
+  // are skipped.
+  static std::optional<SymbolTable> load(const std::string &path);
+
+  // Local labels ("Routine.loop") are ignored, so that code after them still
+  // counts as part of their routine.
+  void add(CodeAddress address, std::string_view name);
+  size_t size() const { return symbols.size(); }
+
+  // The routine containing `address`: the closest symbol at or before it in
+  // the same bank and memory region. Without one, the address itself as
+  // "BB:AAAA".
+  std::string get_routine(CodeAddress address) const;
+
+private:
+  std::map<CodeAddress, std::string> symbols;
+};
+
+// Where RGBDS puts the symbols of the ROM at `rom_path`: the same path with
+// the extension replaced by ".sym".
+std::string get_sym_path(const std::string &rom_path);
+
+#endif // EMUGB_INCLUDE_SYMBOLS_HPP
@@ -0,0 +1,55 @@
+#ifndef EMUGB_INCLUDE_THREAD_POOL_HPP
+#define EMUGB_INCLUDE_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that run parallel loops.
+//
+// The threads are started once and sleep between loops, so a loop costs one
+// wake-up and one join instead of creating threads. The calling thread takes
+// part in every loop.
+class ThreadPool {
+public:
+  // `thread_count` includes the calling thread; 0 uses one per hardware
+  // thread.
+  ThreadPool(size_t thread_count = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  size_t get_thread_count() const { return workers.size() + 1; }
+
+  // Calls `task(i)` for every i in [0, count) and returns once all calls
+  // finished. Indices are handed out one at a time, so uneven tasks balance
+  // out across threads.
+  void run(size_t count, const std::function<void(size_t)> &task);
+
+private:
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  bool stopping = false;
+  uint64_t generation = 0;
+  // Workers still inside the current loop.
+  size_t busy = 0;
+
+  const std::function<void(size_t)> *task = nullptr;
+  size_t task_count = 0;
+  std::atomic<size_t> next_index = 0;
+
+  void work();
+  // Wakes and joins every worker.
+  void stop();
+  void worker_loop();
+};
+
+#endif // EMUGB_INCLUDE_THREAD_POOL_HPP
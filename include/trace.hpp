@@ -0,0 +1,121 @@
+#ifndef EMUGB_INCLUDE_TRACE_HPP
+#define EMUGB_INCLUDE_TRACE_HPP
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "disassembler.hpp"
+#include "mmu.hpp"
+#include "register.hpp"
+
+// Appends one register-state line in the Gameboy Doctor format:
+// "A:01 F:B0 B:00 C:13 D:00 E:D8 H:01 L:4D SP:FFFE PC:0100 PCMEM:00,C3,13,02"
+// PCMEM is read with MMU::peek(), so tracing neither trips breakpoints nor
+// shows up in heatmaps.
+void append_doctor_line(std::string &out, const RegFile &regFile,
+                        const MMU &mmu);
+
+// Result of comparing an emitted trace against a reference log.
+struct TraceMismatch {
+  // 1-based line number of the first differing line.
+  size_t line;
+  std::string expected;
+  std::string actual;
+  // Reference lines immediately preceding the mismatch (oldest first).
+  std::vector<std::string> context;
+};
+
+// Streams trace lines against a memory-mapped reference log.
+//
+// The emulation thread appends lines with submit(); completed chunks are
+// handed to a worker thread which compares them byte-for-byte against the
+// mapped file, so the emulation thread never touches the reference log.
+class TraceComparator {
+public:
+  static constexpr size_t chunk_size = 1 << 20;
+  static constexpr size_t max_pending_chunks = 8;
+  static constexpr size_t context_lines = 8;
+
+  TraceComparator(const std::string &reference_path);
+  ~TraceComparator();
+
+  TraceComparator(const TraceComparator &) = delete;
+  TraceComparator &operator=(const TraceComparator &) = delete;
+
+  bool is_open() const { return reference != nullptr; }
+
+  // Appends one complete line (including the trailing newline).
+  void submit(const std::string &line);
+
+  // Cheap check for the emulation loop; set once a mismatch was found or the
+  // whole reference log has been matched.
+  bool stopped() const { return stop.load(std::memory_order_relaxed); }
+
+  // Flushes pending lines, waits for the worker and returns the first
+  // mismatch, if any. Running out of lines on either side is not a mismatch.
+  const TraceMismatch *finish();
+
+private:
+  const char *reference = nullptr;
+  size_t reference_size = 0;
+  // Bytes of the reference log already matched by the worker.
+  size_t matched = 0;
+
+  std::string current;
+  std::deque<std::string> pending;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool closing = false;
+  std::atomic<bool> stop = false;
+  bool found_mismatch = false;
+  TraceMismatch mismatch;
+  std::thread worker;
+
+  void flush_chunk();
+  void run();
+  void compare(const std::string &chunk);
+  void record_mismatch(const std::string &chunk, size_t offset);
+};
+
+// Keeps the raw bytes of the last `capacity` (at least 1) executed
+// instructions.
+//
+// Recording is a copy into a ring buffer; the instructions are only decoded
+// and formatted when the trace is read.
+class InstructionTrace {
+public:
+  struct Entry {
+    // Machine cycle at which the instruction started.
+    uint64_t cycle;
+    uint16_t pc;
+    InstructionBytes bytes;
+  };
+
+  InstructionTrace(size_t capacity) : entries(capacity) {}
+
+  void record(uint64_t cycle, uint16_t pc, const InstructionBytes &bytes) {
+    entries[next % entries.size()] = {cycle, pc, bytes};
+    next += 1;
+  }
+
+  // Number of instructions recorded so far, including overwritten ones.
+  uint64_t get_recorded() const { return next; }
+  // The retained entries, oldest first.
+  std::vector<Entry> get_entries() const;
+  // One "<cycle> <pc>: <disassembly>" line per retained entry, oldest first.
+  std::string format() const;
+
+private:
+  std::vector<Entry> entries;
+  uint64_t next = 0;
+};
+
+#endif // EMUGB_INCLUDE_TRACE_HPP
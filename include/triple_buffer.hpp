@@ -0,0 +1,86 @@
+#ifndef EMUGB_INCLUDE_TRIPLE_BUFFER_HPP
+#define EMUGB_INCLUDE_TRIPLE_BUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Hands the newest of a stream of values from one producer thread to one
+// consumer thread without either ever waiting for the other.
+//
+// The producer fills the back buffer and swaps it with the middle one; the
+// consumer swaps the middle one with its front buffer. A value published
+// before the consumer took the previous one replaces it and is lost.
+template <typename T> class TripleBuffer {
+public:
+  // Producer: the buffer to fill before publish().
+  T &get_back() { return buffers[back]; }
+
+  // Producer: makes the back buffer the newest value. Returns false if this
+  // dropped a value the consumer never took.
+  bool publish() {
+    const uint8_t previous =
+        middle.exchange(back | fresh, std::memory_order_acq_rel);
+    back = previous & index_mask;
+    middle.notify_one();
+    return (previous & fresh) == 0;
+  }
+
+  // Producer: wakes the consumer for good once nothing is left to take.
+  void close() {
+    middle.fetch_or(closed, std::memory_order_release);
+    middle.notify_one();
+  }
+
+  // Consumer: blocks until a value is published and returns it, or returns
+  // nullptr once closed with nothing left. The value stays valid until the
+  // next call.
+  const T *take() {
+    uint8_t current = middle.load(std::memory_order_acquire);
+    for (;;) {
+      if ((current & fresh) == 0) {
+        if ((current & closed) != 0) {
+          return nullptr;
+        }
+        middle.wait(current, std::memory_order_acquire);
+        current = middle.load(std::memory_order_acquire);
+      } else if (middle.compare_exchange_weak(
+                     current, front | (current & closed),
+                     std::memory_order_acq_rel, std::memory_order_acquire)) {
+        front = current & index_mask;
+        return &buffers[front];
+      }
+    }
+  }
+
+  // Consumer: like take(), but returns nullptr instead of waiting when
+  // nothing new was published.
+  const T *try_take() {
+    uint8_t current = middle.load(std::memory_order_acquire);
+    while ((current & fresh) != 0) {
+      if (middle.compare_exchange_weak(
+              current, front | (current & closed), std::memory_order_acq_rel,
+              std::memory_order_acquire)) {
+        front = current & index_mask;
+        return &buffers[front];
+      }
+    }
+    return nullptr;
+  }
+
+private:
+  static constexpr uint8_t index_mask = 0x03;
+  // The middle buffer holds a value the consumer has not taken.
+  static constexpr uint8_t fresh = 0x04;
+  static constexpr uint8_t closed = 0x08;
+
+  std::array<T, 3> buffers{};
+  // Index of the middle buffer and the flags above.
+  alignas(64) std::atomic<uint8_t> middle = 1;
+  // Owned by the producer.
+  alignas(64) uint8_t back = 0;
+  // Owned by the consumer.
+  alignas(64) uint8_t front = 2;
+};
+
+#endif // EMUGB_INCLUDE_TRIPLE_BUFFER_HPP
@@ -0,0 +1,64 @@
+#ifndef EMUGB_INCLUDE_VEC_ENV_HPP
+#define EMUGB_INCLUDE_VEC_ENV_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "gameboy.hpp"
+#include "instance_pool.hpp"
+#include "machine_state.hpp"
+#include "thread_pool.hpp"
+
+// What one instance contributes to the observation buffer after a step, in
+// this order.
+struct ObservationSpec {
+  // PPU::width * PPU::height shades.
+  bool screen = true;
+  // One byte per address, read through the memory map.
+  std::vector<uint16_t> ram_addresses;
+};
+
+// Many independent instances of one ROM, stepped together.
+//
+// A step runs every instance on a persistent thread pool and writes all
+// observations into one caller-provided buffer, so a training loop pays the
+// call and synchronisation cost once per step rather than once per instance.
+// Only the last frame of a step is drawn. The instances live in one
+// InstancePool, backed by transparent huge pages once it spans one.
+class VecEnv {
+public:
+  VecEnv(const std::vector<uint8_t> &rom, size_t instance_count,
+         ObservationSpec spec, size_t thread_count = 0);
+
+  size_t get_instance_count() const { return instances.size(); }
+  size_t get_observation_size() const { return observation_size; }
+
+  // Holds `actions[i]` (Button flags) on instance i for `frames` frames, then
+  // writes its observation to `observations + i * get_observation_size()`.
+  // With `frames` 0 this only writes the observations, but the screen is
+  // only valid once a frame has been drawn.
+  void step(const uint8_t *actions, uint32_t frames, uint8_t *observations);
+
+  // Puts an instance back into its start state. Every instance starts at the
+  // post-boot state until set_start_state() replaces it.
+  void reset(size_t instance);
+  void set_start_state(size_t instance);
+
+  GameBoy &get_instance(size_t instance) { return *instances[instance]; }
+
+private:
+  ObservationSpec spec;
+  size_t observation_size;
+  InstancePool instance_pool;
+  std::vector<InstancePool::Pointer> instances;
+  // Shared between instances until set_start_state() gives one its own.
+  std::vector<std::shared_ptr<const MachineState>> start_states;
+  ThreadPool pool;
+
+  void step_instance(size_t instance, uint8_t buttons, uint32_t frames,
+                     uint8_t *observation);
+};
+
+#endif // EMUGB_INCLUDE_VEC_ENV_HPP
@@ -0,0 +1,96 @@
+#include "aot.hpp"
+#include "cartridge.hpp"
+#include "gameboy.hpp"
+#include "hash.hpp"
+#include "metrics.hpp"
+#include "movie.hpp"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A movie player for the one ROM whose code emugb-aot compiled into it (see
+// emugb_add_aot_runner() in CMakeLists.txt). Other ROMs, and code the
+// compiled blocks do not cover, run in the interpreter.
+
+static void print_usage(const char *program) {
+  std::println(stderr,
+               "Usage: {} <rom_path> --play <movie_path> [--fast-forward] "
+               "[--interpret]",
+               program);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  std::optional<std::string> play_path;
+  bool fast_forward = false;
+  bool interpret = false;
+  for (int i = 2; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg == "--play" && i + 1 < argc) {
+      play_path = argv[++i];
+    } else if (arg == "--fast-forward") {
+      fast_forward = true;
+    } else if (arg == "--interpret") {
+      interpret = true;
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (!play_path) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  const char *rom_path = argv[1];
+  LoadResult loaded = load_from_path(rom_path);
+  if (!loaded) {
+    std::println(stderr, "Error: {}: {}", to_string(loaded.error()), rom_path);
+    return 1;
+  }
+  const std::optional<Movie> movie = Movie::load(*play_path);
+  if (!movie) {
+    return 1;
+  }
+  const std::vector<uint8_t> &rom = (*loaded)->get_rom();
+  if (movie->rom_hash != hash64(rom.data(), rom.size())) {
+    std::println(stderr, "Warning: movie was recorded with a different ROM");
+  }
+
+  GameBoy gameboy(std::move(*loaded));
+  gameboy.set_fast_forward({.enabled = fast_forward});
+  if (!interpret && !gameboy.set_aot_program(&aot_program)) {
+    std::println(stderr,
+                 "Warning: not the ROM this runner was built for; "
+                 "interpreting");
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const uint64_t state_hash = play_movie(gameboy, *movie);
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::println("frames: {}", movie->frame_count);
+  std::println("time: {:.3f} s ({:.1f} fps)", elapsed.count(),
+               movie->frame_count / elapsed.count());
+  const PerfCounters counters = gameboy.get_counters();
+  std::println("compiled blocks: {} of {} steps", counters.block_hits,
+               counters.block_lookups);
+  std::println("state hash: {:016x}", state_hash);
+  if (state_hash != movie->final_state_hash) {
+    std::println(stderr, "state hash mismatch: movie expects {:016x}",
+                 movie->final_state_hash);
+    return 1;
+  }
+  return 0;
+}
@@ -1,50 +1,120 @@
 #include "cartridge.hpp"
 
+#include "hash.hpp"
+#include "machine_state.hpp"
+#include "rom_file.hpp"
+#include "rom_header.hpp"
+#include <cstddef>
 #include <cstdint>
-#include <cstdlib>
-#include <fstream>
+#include <expected>
 #include <memory>
-#include <print>
-#include <sstream>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+namespace {
+
+constexpr size_t min_rom_size = RomHeader::end;
+
+struct RomRegistry {
+  std::mutex mutex;
+  // Images by hash64() of their contents; more than one only on a collision.
+  std::unordered_map<uint64_t,
+                     std::vector<std::weak_ptr<const std::vector<uint8_t>>>>
+      images;
+};
+
+RomRegistry &get_rom_registry() {
+  static RomRegistry registry;
+  return registry;
+}
+
+} // namespace
+
+RomImage intern_rom(RomImage rom) {
+  const uint64_t hash = hash64(rom->data(), rom->size());
+  RomRegistry &registry = get_rom_registry();
+  const std::lock_guard lock(registry.mutex);
+  auto &images = registry.images[hash];
+  std::erase_if(images, [](const auto &image) { return image.expired(); });
+  for (const auto &entry : images) {
+    RomImage image = entry.lock();
+    if (image != nullptr && *image == *rom) {
+      return image;
+    }
+  }
+  images.push_back(rom);
+  return rom;
+}
+
+RomImage intern_rom(std::vector<uint8_t> &&rom) {
+  return intern_rom(
+      std::make_shared<const std::vector<uint8_t>>(std::move(rom)));
+}
+
 uint8_t RomOnly::get_byte(uint16_t addr) const {
-  if (addr >= rom.size()) {
+  if (addr >= rom->size()) {
     return 0;
   }
-  return rom[addr];
+  return (*rom)[addr];
 }
 
 // ROM is read-only; writes are intentionally ignored.
 void RomOnly::set_byte(uint16_t addr, uint8_t value) {}
 
-std::string Cartridge::get_title() const {
-  std::stringstream ss;
-  const size_t title_start = 0x0134;
-  const size_t title_end = 0x0143;
+const uint8_t *RomOnly::get_rom_page(uint16_t addr) const {
+  // Pages past the end of a short ROM keep going through get_byte().
+  if (addr >= 0x8000 || addr + MachineState::page_size > rom->size()) {
+    return nullptr;
+  }
+  return rom->data() + addr;
+}
+
+std::string Cartridge::get_title() const { return read_title(get_rom()); }
 
-  for (size_t addr = title_start; addr <= title_end; ++addr) {
-    const uint8_t byte = get_byte(static_cast<uint16_t>(addr));
-    if (byte == 0) {
-      break;
+std::string_view to_string(LoadError error) {
+  switch (error) {
+  case LoadError::OpenFailed:
+    return "could not open file";
+  case LoadError::ReadFailed:
+    return "could not read file";
+  case LoadError::InvalidRom:
+    return "not a Game Boy ROM";
+  case LoadError::InvalidArchive:
+    return "corrupt or unsupported archive";
+  }
+  std::unreachable();
+}
+
+LoadResult load_from_path(const std::string &path, RomCache *cache) {
+  if (cache != nullptr) {
+    const std::expected<RomImage, LoadError> image = cache->load(path);
+    if (!image) {
+      return std::unexpected(image.error());
     }
-    ss << static_cast<char>(byte);
+    return load_from_image(*image);
   }
 
-  return ss.str();
+  std::expected<std::vector<uint8_t>, LoadError> rom = read_rom_file(path);
+  if (!rom) {
+    return std::unexpected(rom.error());
+  }
+  return load_from_memory(std::move(*rom));
 }
 
-std::unique_ptr<Cartridge> load_from_path(const std::string &path) {
-  std::ifstream file(path, std::ios::binary);
-  if (!file) {
-    std::println(stderr, "Error: Could not open file {}", path);
-    std::exit(EXIT_FAILURE);
+LoadResult load_from_memory(std::vector<uint8_t> &&rom) {
+  if (rom.size() < min_rom_size) {
+    return std::unexpected(LoadError::InvalidRom);
   }
+  return std::make_unique<RomOnly>(intern_rom(std::move(rom)));
+}
 
-  std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)),
-                           std::istreambuf_iterator<char>());
-  file.close();
-
-  return std::make_unique<RomOnly>(std::move(rom));
+LoadResult load_from_image(RomImage rom) {
+  if (rom->size() < min_rom_size) {
+    return std::unexpected(LoadError::InvalidRom);
+  }
+  return std::make_unique<RomOnly>(intern_rom(std::move(rom)));
 }
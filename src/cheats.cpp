@@ -0,0 +1,87 @@
+#include "cheats.hpp"
+
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace {
+
+template <typename T> bool parse_hex(std::string_view text, T &value) {
+  const std::from_chars_result result =
+      std::from_chars(text.data(), text.data() + text.size(), value, 16);
+  return result.ec == std::errc{} && result.ptr == text.data() + text.size();
+}
+
+// Game Genie: "ABCDEF" or "ABCDEFGHI" without dashes. AB is the new value
+// and FCDE the address with F inverted. GI, rotated right by two and XORed
+// with 0xBA, is the value to compare against; H is not used.
+std::optional<RomPatch> parse_game_genie(std::string_view code) {
+  if (code.size() != 6 && code.size() != 9) {
+    return std::nullopt;
+  }
+  RomPatch patch;
+  uint16_t digits;
+  if (!parse_hex(code.substr(0, 2), patch.value) ||
+      !parse_hex(code.substr(2, 4), digits)) {
+    return std::nullopt;
+  }
+  patch.addr = static_cast<uint16_t>(std::rotr(digits, 4) ^ 0xF000);
+  if (patch.addr >= 0x8000) {
+    return std::nullopt;
+  }
+  if (code.size() == 9) {
+    uint8_t compare;
+    uint8_t unused;
+    const char digits_gi[] = {code[6], code[8]};
+    if (!parse_hex(std::string_view(digits_gi, 2), compare) ||
+        !parse_hex(code.substr(7, 1), unused)) {
+      return std::nullopt;
+    }
+    patch.compare = static_cast<uint8_t>(std::rotr(compare, 2) ^ 0xBA);
+  }
+  return patch;
+}
+
+// GameShark: "TTVVLLHH", type, value and the address low byte first.
+std::optional<RamCheat> parse_gameshark(std::string_view code) {
+  uint8_t type;
+  RamCheat cheat;
+  uint8_t low;
+  uint8_t high;
+  if (code.size() != 8 || !parse_hex(code.substr(0, 2), type) ||
+      !parse_hex(code.substr(2, 2), cheat.value) ||
+      !parse_hex(code.substr(4, 2), low) ||
+      !parse_hex(code.substr(6, 2), high)) {
+    return std::nullopt;
+  }
+  cheat.addr = static_cast<uint16_t>(high << 8 | low);
+  // Only RAM can be written.
+  if (cheat.addr < 0x8000) {
+    return std::nullopt;
+  }
+  return cheat;
+}
+
+} // namespace
+
+bool Cheats::add(std::string_view code) {
+  std::string digits;
+  for (const char c : code) {
+    if (c != '-') {
+      digits.push_back(c);
+    }
+  }
+  if (const std::optional<RamCheat> cheat = parse_gameshark(digits)) {
+    ram_cheats.push_back(*cheat);
+    return true;
+  }
+  if (const std::optional<RomPatch> patch = parse_game_genie(digits)) {
+    rom_patches.push_back(*patch);
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,486 @@
+#include "control_flow.hpp"
+
+#include "disassembler.hpp"
+#include "hash.hpp"
+#include "opcodes.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr std::string_view magic = "EMUGBCFG";
+// Bytes of a block without successors.
+constexpr size_t min_block_size = 10;
+constexpr size_t bank_size = 0x4000;
+constexpr size_t cartridge_type_addr = 0x0147;
+
+void put_le(std::vector<uint8_t> &out, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; ++i) {
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+class Reader {
+public:
+  Reader(const std::vector<uint8_t> &data) : data(data) {}
+
+  bool get_le(uint64_t &value, size_t bytes) {
+    if (data.size() - pos < bytes) {
+      return false;
+    }
+    value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+      value |= static_cast<uint64_t>(data[pos++]) << (8 * i);
+    }
+    return true;
+  }
+
+  size_t get_remaining() const { return data.size() - pos; }
+
+private:
+  const std::vector<uint8_t> &data;
+  size_t pos = magic.size();
+};
+
+// Per-byte marks of a bank.
+constexpr uint8_t instruction_start = 0x01;
+// Control reaches the byte from somewhere other than the instruction before.
+constexpr uint8_t branch_target = 0x02;
+
+// Where control goes after one instruction.
+struct Flow {
+  // Fallthrough for instructions that are not branches.
+  BlockExit exit;
+  // Execution may continue with the next instruction.
+  bool continues;
+  std::optional<uint16_t> target;
+};
+
+Flow get_flow(const OpcodeInfo &info, const InstructionBytes &bytes,
+              uint16_t addr) {
+  const std::string_view mnemonic = info.mnemonic;
+  const bool conditional = info.operands[0] >= Operand::CondNz &&
+                           info.operands[0] <= Operand::CondC;
+  const uint16_t word = static_cast<uint16_t>(bytes[1] | bytes[2] << 8);
+  if (mnemonic.empty()) {
+    return {BlockExit::Stop, false, std::nullopt};
+  }
+  if (mnemonic == "JP") {
+    if (info.operands[0] == Operand::HL) {
+      return {BlockExit::Indirect, false, std::nullopt};
+    }
+    return {BlockExit::Jump, conditional, word};
+  }
+  if (mnemonic == "JR") {
+    return {BlockExit::Jump, conditional,
+            static_cast<uint16_t>(addr + info.length +
+                                  static_cast<int8_t>(bytes[1]))};
+  }
+  if (mnemonic == "CALL") {
+    return {BlockExit::Call, true, word};
+  }
+  if (mnemonic == "RST") {
+    return {BlockExit::Call, true, info.value};
+  }
+  if (mnemonic == "RET" || mnemonic == "RETI") {
+    return {BlockExit::Return, conditional, std::nullopt};
+  }
+  return {BlockExit::Fallthrough, true, std::nullopt};
+}
+
+// Analysis state of one bank, only touched by the thread tracing it.
+struct Bank {
+  struct Seed {
+    uint16_t addr;
+    // Bank selected by the code on the path here, if known.
+    std::optional<uint16_t> selected_bank;
+  };
+
+  uint16_t index = 0;
+  // Address the bank shows up at: 0x0000 or 0x4000.
+  uint16_t base = 0;
+  const uint8_t *rom = nullptr;
+  // ROM bytes in this bank; less than bank_size for a short last bank.
+  size_t size = 0;
+  std::vector<uint8_t> marks;
+  std::vector<Seed> pending;
+  // Targets in other banks found this round.
+  std::vector<CodeAddress> outgoing;
+  // Target bank of each bank 0 jump into 0x4000-0x7FFF that could be
+  // worked out, by the address of the jump.
+  std::unordered_map<uint16_t, uint16_t> far_banks;
+  std::vector<BasicBlock> blocks;
+
+  // Offset of `addr` into the bank; only meaningful if contains(addr).
+  size_t offset(uint16_t addr) const { return size_t{addr} - base; }
+
+  bool contains(uint16_t addr) const {
+    return addr >= base && offset(addr) < size;
+  }
+
+  // Zero past the end of the bank, which decode() reads as NOP.
+  InstructionBytes read(uint16_t addr) const {
+    InstructionBytes bytes{};
+    for (size_t i = 0; i < bytes.size() && offset(addr) + i < size; ++i) {
+      bytes[i] = rom[offset(addr) + i];
+    }
+    return bytes;
+  }
+
+  std::optional<CodeAddress> resolve(uint16_t from, uint16_t target) const {
+    if (target < 0x4000) {
+      return CodeAddress{0, target};
+    }
+    if (target >= 0x8000) {
+      return std::nullopt;
+    }
+    if (index != 0) {
+      return CodeAddress{index, target};
+    }
+    const auto it = far_banks.find(from);
+    if (it == far_banks.end()) {
+      return std::nullopt;
+    }
+    return CodeAddress{it->second, target};
+  }
+};
+
+// Whether the instruction may leave A with a different value. Calls count,
+// since the callee may do anything with A.
+bool may_change_a(const OpcodeInfo &info) {
+  const std::string_view mnemonic = info.mnemonic;
+  if (mnemonic == "CALL" || mnemonic == "RST" || mnemonic == "RLCA" ||
+      mnemonic == "RRCA" || mnemonic == "RLA" || mnemonic == "RRA" ||
+      mnemonic == "DAA" || mnemonic == "CPL") {
+    return true;
+  }
+  if (mnemonic == "RES" || mnemonic == "SET") {
+    return info.operands[1] == Operand::A;
+  }
+  // CP and BIT only read A.
+  return mnemonic != "CP" && (info.operands[0] == Operand::A ||
+                              info.operands[0] == Operand::AF);
+}
+
+void add_target(Bank &bank, size_t bank_count, uint16_t from, uint16_t target,
+                std::optional<uint16_t> selected_bank) {
+  if (bank.contains(target)) {
+    bank.pending.push_back({target, selected_bank});
+    return;
+  }
+  if (target < 0x4000) {
+    bank.outgoing.push_back({0, target});
+  } else if (target < 0x8000 && bank.index == 0) {
+    // Without a bank switch on the way, a 32 KiB ROM can only mean bank 1.
+    const uint16_t far_bank = selected_bank.value_or(bank_count == 2 ? 1 : 0);
+    if (far_bank != 0 && far_bank < bank_count) {
+      bank.far_banks[from] = far_bank;
+      bank.outgoing.push_back({far_bank, target});
+    }
+  }
+}
+
+// MBC1, MBC2 and MBC3 map bank 1 when 0 is written to the bank register;
+// MBC5 maps bank 0.
+bool zero_selects_bank_one(const std::vector<uint8_t> &rom) {
+  if (rom.size() <= cartridge_type_addr) {
+    return true;
+  }
+  const uint8_t type = rom[cartridge_type_addr];
+  return type < 0x19 || type > 0x1E;
+}
+
+void trace(Bank &bank, size_t bank_count, bool zero_is_one) {
+  while (!bank.pending.empty()) {
+    const Bank::Seed seed = bank.pending.back();
+    bank.pending.pop_back();
+    if (!bank.contains(seed.addr)) {
+      continue;
+    }
+    bank.marks[bank.offset(seed.addr)] |= branch_target;
+
+    uint16_t addr = seed.addr;
+    std::optional<uint16_t> selected_bank = seed.selected_bank;
+    // Bank that writing A to the MBC selects, while A holds a known value.
+    std::optional<uint16_t> a_bank;
+    while (bank.contains(addr) &&
+           (bank.marks[bank.offset(addr)] & instruction_start) == 0) {
+      const InstructionBytes bytes = bank.read(addr);
+      const OpcodeInfo &info = decode(bytes);
+      if (bank.offset(addr) + info.length > bank.size) {
+        break;
+      }
+      bank.marks[bank.offset(addr)] |= instruction_start;
+
+      const uint16_t word = static_cast<uint16_t>(bytes[1] | bytes[2] << 8);
+      if (info.mnemonic == "LD" && info.operands[0] == Operand::A &&
+          info.operands[1] == Operand::Imm8) {
+        a_bank = zero_is_one ? std::max<uint16_t>(bytes[1], 1) : bytes[1];
+      } else if (info.mnemonic == "LD" &&
+                 info.operands[0] == Operand::Address16 &&
+                 info.operands[1] == Operand::A && word >= 0x2000 &&
+                 word < 0x4000 && a_bank) {
+        selected_bank = a_bank;
+      } else if (may_change_a(info)) {
+        a_bank.reset();
+      }
+
+      const Flow flow = get_flow(info, bytes, addr);
+      if (flow.target) {
+        add_target(bank, bank_count, addr, *flow.target, selected_bank);
+      }
+      if (!flow.continues) {
+        break;
+      }
+      addr = static_cast<uint16_t>(addr + info.length);
+    }
+  }
+}
+
+void build_blocks(Bank &bank) {
+  size_t offset = 0;
+  while (offset < bank.size) {
+    if ((bank.marks[offset] & instruction_start) == 0) {
+      offset += 1;
+      continue;
+    }
+
+    BasicBlock block{{bank.index, static_cast<uint16_t>(bank.base + offset)},
+                     0, 0, BlockExit::Stop, {}};
+    for (;;) {
+      const uint16_t addr = static_cast<uint16_t>(bank.base + offset);
+      const InstructionBytes bytes = bank.read(addr);
+      const OpcodeInfo &info = decode(bytes);
+      const Flow flow = get_flow(info, bytes, addr);
+      block.instruction_count += 1;
+      offset += info.length;
+      block.end = static_cast<uint16_t>(bank.base + offset);
+      const bool next_decoded =
+          offset < bank.size && (bank.marks[offset] & instruction_start) != 0;
+
+      if (flow.exit != BlockExit::Fallthrough) {
+        block.exit = flow.exit;
+        if (flow.target) {
+          if (const std::optional<CodeAddress> target =
+                  bank.resolve(addr, *flow.target)) {
+            block.successors.push_back(*target);
+          }
+        }
+        if (flow.continues && next_decoded) {
+          block.successors.push_back({bank.index, block.end});
+        }
+        break;
+      }
+      if (!next_decoded) {
+        block.exit = BlockExit::Stop;
+        break;
+      }
+      if ((bank.marks[offset] & branch_target) != 0) {
+        block.exit = BlockExit::Fallthrough;
+        block.successors.push_back({bank.index, block.end});
+        break;
+      }
+    }
+    bank.blocks.push_back(std::move(block));
+  }
+}
+
+} // namespace
+
+ControlFlowGraph ControlFlowGraph::analyze(const std::vector<uint8_t> &rom,
+                                           ThreadPool &pool) {
+  const size_t bank_count =
+      std::max<size_t>((rom.size() + bank_size - 1) / bank_size, 1);
+  std::vector<Bank> banks(bank_count);
+  for (size_t i = 0; i < bank_count; ++i) {
+    Bank &bank = banks[i];
+    bank.index = static_cast<uint16_t>(i);
+    bank.base = i == 0 ? 0x0000 : 0x4000;
+    bank.rom = rom.data() + i * bank_size;
+    bank.size = std::min(bank_size, rom.size() - std::min(rom.size(),
+                                                           i * bank_size));
+    bank.marks.resize(bank.size);
+  }
+
+  // The entry point, the RST vectors and the interrupt vectors.
+  banks[0].pending.push_back({0x0100, std::nullopt});
+  for (uint16_t vector = 0x00; vector <= 0x60; vector += 0x08) {
+    banks[0].pending.push_back({vector, std::nullopt});
+  }
+
+  const bool zero_is_one = zero_selects_bank_one(rom);
+  std::vector<size_t> active;
+  for (;;) {
+    active.clear();
+    for (size_t i = 0; i < bank_count; ++i) {
+      if (!banks[i].pending.empty()) {
+        active.push_back(i);
+      }
+    }
+    if (active.empty()) {
+      break;
+    }
+    pool.run(active.size(),
+             [&](size_t i) {
+               trace(banks[active[i]], bank_count, zero_is_one);
+             });
+    for (Bank &bank : banks) {
+      for (const CodeAddress &target : bank.outgoing) {
+        banks[target.bank].pending.push_back({target.addr, std::nullopt});
+      }
+      bank.outgoing.clear();
+    }
+  }
+
+  pool.run(bank_count, [&](size_t i) { build_blocks(banks[i]); });
+
+  ControlFlowGraph graph;
+  graph.rom_hash = hash64(rom.data(), rom.size());
+  for (Bank &bank : banks) {
+    std::ranges::move(bank.blocks, std::back_inserter(graph.blocks));
+  }
+  return graph;
+}
+
+std::optional<ControlFlowGraph>
+ControlFlowGraph::load(const std::string &path, uint64_t rom_hash) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return std::nullopt;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+  if (data.size() < magic.size() ||
+      std::string_view(reinterpret_cast<const char *>(data.data()),
+                       magic.size()) != magic) {
+    return std::nullopt;
+  }
+
+  ControlFlowGraph graph;
+  Reader reader(data);
+  uint64_t file_version, block_count;
+  if (!reader.get_le(file_version, 2) || file_version != version ||
+      !reader.get_le(graph.rom_hash, 8) || graph.rom_hash != rom_hash ||
+      !reader.get_le(block_count, 4) ||
+      block_count > reader.get_remaining() / min_block_size) {
+    return std::nullopt;
+  }
+
+  graph.blocks.resize(block_count);
+  for (BasicBlock &block : graph.blocks) {
+    uint64_t bank, start, end, instruction_count, exit, successor_count;
+    if (!reader.get_le(bank, 2) || !reader.get_le(start, 2) ||
+        !reader.get_le(end, 2) || !reader.get_le(instruction_count, 2) ||
+        !reader.get_le(exit, 1) || exit > static_cast<uint8_t>(BlockExit::Stop) ||
+        !reader.get_le(successor_count, 1)) {
+      return std::nullopt;
+    }
+    block.start = {static_cast<uint16_t>(bank), static_cast<uint16_t>(start)};
+    block.end = static_cast<uint16_t>(end);
+    block.instruction_count = static_cast<uint16_t>(instruction_count);
+    block.exit = static_cast<BlockExit>(exit);
+    block.successors.resize(successor_count);
+    for (CodeAddress &successor : block.successors) {
+      uint64_t successor_bank, successor_addr;
+      if (!reader.get_le(successor_bank, 2) ||
+          !reader.get_le(successor_addr, 2)) {
+        return std::nullopt;
+      }
+      successor = {static_cast<uint16_t>(successor_bank),
+                   static_cast<uint16_t>(successor_addr)};
+    }
+  }
+  return graph;
+}
+
+bool ControlFlowGraph::save(const std::string &path) const {
+  std::vector<uint8_t> data(magic.begin(), magic.end());
+  put_le(data, version, 2);
+  put_le(data, rom_hash, 8);
+  put_le(data, blocks.size(), 4);
+  for (const BasicBlock &block : blocks) {
+    put_le(data, block.start.bank, 2);
+    put_le(data, block.start.addr, 2);
+    put_le(data, block.end, 2);
+    put_le(data, block.instruction_count, 2);
+    put_le(data, static_cast<uint8_t>(block.exit), 1);
+    put_le(data, block.successors.size(), 1);
+    for (const CodeAddress &successor : block.successors) {
+      put_le(data, successor.bank, 2);
+      put_le(data, successor.addr, 2);
+    }
+  }
+
+  // Write to a temporary file first so that a concurrent launch never reads
+  // half a cache.
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary);
+    if (!file) {
+      std::println(stderr, "Error: Could not open file {}", temporary);
+      return false;
+    }
+    file.write(reinterpret_cast<const char *>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    if (!file) {
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    std::println(stderr, "Error: Could not write file {}", path);
+    return false;
+  }
+  return true;
+}
+
+ControlFlowGraph
+ControlFlowGraph::load_or_analyze(const std::vector<uint8_t> &rom,
+                                  const std::string &cache_path,
+                                  ThreadPool &pool, bool *cache_hit) {
+  std::optional<ControlFlowGraph> cached =
+      load(cache_path, hash64(rom.data(), rom.size()));
+  if (cache_hit != nullptr) {
+    *cache_hit = cached.has_value();
+  }
+  if (cached) {
+    return std::move(*cached);
+  }
+  ControlFlowGraph graph = analyze(rom, pool);
+  // A read-only ROM directory only costs the next launch its head start.
+  graph.save(cache_path);
+  return graph;
+}
+
+const BasicBlock *ControlFlowGraph::find_block(CodeAddress start) const {
+  const auto it = std::ranges::lower_bound(blocks, start, {}, &BasicBlock::start);
+  if (it == blocks.end() || it->start != start) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+size_t ControlFlowGraph::get_instruction_count() const {
+  size_t count = 0;
+  for (const BasicBlock &block : blocks) {
+    count += block.instruction_count;
+  }
+  return count;
+}
+
+std::string get_cfg_cache_path(const std::string &rom_path) {
+  return rom_path + ".cfg";
+}
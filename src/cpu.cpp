@@ -1,7 +1,14 @@
 #include "cpu.hpp"
 
-#include "memory.hpp"
+#include "disassembler.hpp"
+#include "machine_state.hpp"
+#include "mmu.hpp"
+#include "opcodes.hpp"
 #include "register.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
 #include <print>
 
 uint8_t CPU::imm_byte() {
@@ -147,12 +154,89 @@ void CPU::alu_ret() {
 
 void CPU::alu_jp(uint16_t addr) { regFile.pc = addr; }
 
+void CPU::alu_push(uint16_t value) {
+  regFile.sp -= 2;
+  memory.set_word(regFile.sp, value);
+}
+
+uint16_t CPU::alu_pop() {
+  const uint16_t value = memory.get_word(regFile.sp);
+  regFile.sp += 2;
+  return value;
+}
+
+void CPU::alu_call(uint16_t addr) {
+  alu_push(regFile.pc);
+  regFile.pc = addr;
+}
+
+// Dispatches the highest-priority pending interrupt if IME is set. Any
+// pending interrupt ends HALT, even with IME clear.
+bool CPU::service_interrupt() {
+  MachineState &state = memory.get_state();
+  const uint8_t pending = state.ie & state.io[0x0F] & 0x1F;
+  state.halted = false;
+  if (!state.ime) {
+    return false;
+  }
+
+  const int bit = std::countr_zero(pending);
+  state.ime = false;
+  state.io[0x0F] &= ~(1 << bit);
+  alu_call(static_cast<uint16_t>(0x40 + bit * 8));
+  tick(20);
+  if (log_instructions) {
+    std::println("INT 0x{:02X}", regFile.pc);
+  }
+  return true;
+}
+
+void CPU::record_instruction(uint16_t pc) {
+  const InstructionBytes bytes = read_instruction(memory, pc);
+  if (trace != nullptr) {
+    trace->record(memory.get_state().cycles, pc, bytes);
+  }
+  if (log_instructions) {
+    std::println("{}", disassemble(pc, bytes));
+  }
+}
+
 void CPU::execute() {
-  const uint8_t byte0 = imm_byte();
+  MachineState &state = memory.get_state();
+  if ((state.ie & state.io[0x0F] & 0x1F) != 0) [[unlikely]] {
+    if (service_interrupt()) {
+      return;
+    }
+  }
+  if (state.halted) [[unlikely]] {
+    // Nothing can change until the next scheduled event.
+    const uint64_t wake = std::max(state.cycles + 4, state.scheduler.next);
+    halted_cycles += wake - state.cycles;
+    state.cycles = wake;
+    return;
+  }
+  if (state.ime_pending) [[unlikely]] {
+    // EI takes effect after the instruction following it.
+    state.ime_pending = false;
+    state.ime = true;
+  }
+
+  uint8_t byte0;
+  if (!memory.fetch_opcode(regFile.pc, byte0)) [[unlikely]] {
+    // Stopped at an execute breakpoint.
+    return;
+  }
+  if (log_instructions || trace != nullptr) [[unlikely]] {
+    record_instruction(regFile.pc);
+  }
+  regFile.pc += 1;
+  instruction_count += 1;
+  // Taken conditional branches add the difference to branch_cycles.
+  const OpcodeInfo &info = get_opcode_info(byte0);
+  tick(info.cycles);
   switch (byte0) {
   // NOP
   case 0x00: {
-    std::println("NOP");
     break;
   }
 
@@ -160,25 +244,21 @@ void CPU::execute() {
   case 0x01: {
     const uint16_t imm16 = imm_word();
     regFile.set_bc(imm16);
-    std::println("LD BC, 0x{:04X}", imm16);
     break;
   }
   case 0x11: {
     const uint16_t imm16 = imm_word();
     regFile.set_de(imm16);
-    std::println("LD DE, 0x{:04X}", imm16);
     break;
   }
   case 0x21: {
     const uint16_t imm16 = imm_word();
     regFile.set_hl(imm16);
-    std::println("LD HL, 0x{:04X}", imm16);
     break;
   }
   case 0x31: {
     const uint16_t imm16 = imm_word();
     regFile.sp = imm16;
-    std::println("LD SP, 0x{:04X}", imm16);
     break;
   }
 
@@ -186,27 +266,23 @@ void CPU::execute() {
   case 0x02: {
     const uint16_t addr = regFile.get_bc();
     memory.set_byte(addr, regFile.a);
-    std::println("LD (BC), A");
     break;
   }
   case 0x12: {
     const uint16_t addr = regFile.get_de();
     memory.set_byte(addr, regFile.a);
-    std::println("LD (DE), A");
     break;
   }
   case 0x22: {
     const uint16_t addr = regFile.get_hl();
     memory.set_byte(addr, regFile.a);
     regFile.set_hl(addr + 1);
-    std::println("LD (HL+), A");
     break;
   }
   case 0x32: {
     const uint16_t addr = regFile.get_hl();
     memory.set_byte(addr, regFile.a);
     regFile.set_hl(addr - 1);
-    std::println("LD (HL-), A");
     break;
   }
 
@@ -214,27 +290,23 @@ void CPU::execute() {
   case 0x0A: {
     const uint16_t addr = regFile.get_bc();
     regFile.a = memory.get_byte(addr);
-    std::println("LD A, (BC)");
     break;
   }
   case 0x1A: {
     const uint16_t addr = regFile.get_de();
     regFile.a = memory.get_byte(addr);
-    std::println("LD A, (DE)");
     break;
   }
   case 0x2A: {
     const uint16_t addr = regFile.get_hl();
     regFile.a = memory.get_byte(addr);
     regFile.set_hl(addr + 1);
-    std::println("LD A, (HL+)");
     break;
   }
   case 0x3A: {
     const uint16_t addr = regFile.get_hl();
     regFile.a = memory.get_byte(addr);
     regFile.set_hl(addr - 1);
-    std::println("LD A, (HL-)");
     break;
   }
 
@@ -242,7 +314,6 @@ void CPU::execute() {
   case 0x08: {
     const uint16_t addr = imm_word();
     memory.set_word(addr, regFile.sp);
-    std::println("LD (0x{:04X}), SP", addr);
     break;
   }
 
@@ -250,24 +321,20 @@ void CPU::execute() {
   case 0x03: {
     const uint16_t value = regFile.get_bc();
     regFile.set_bc(value + 1);
-    std::println("INC BC");
     break;
   }
   case 0x13: {
     const uint16_t value = regFile.get_de();
     regFile.set_de(value + 1);
-    std::println("INC DE");
     break;
   }
   case 0x23: {
     const uint16_t value = regFile.get_hl();
     regFile.set_hl(value + 1);
-    std::println("INC HL");
     break;
   }
   case 0x33: {
     regFile.sp += 1;
-    std::println("INC SP");
     break;
   }
 
@@ -275,63 +342,52 @@ void CPU::execute() {
   case 0x0B: {
     const uint16_t value = regFile.get_bc();
     regFile.set_bc(value - 1);
-    std::println("DEC BC");
     break;
   }
   case 0x1B: {
     const uint16_t value = regFile.get_de();
     regFile.set_de(value - 1);
-    std::println("DEC DE");
     break;
   }
   case 0x2B: {
     const uint16_t value = regFile.get_hl();
     regFile.set_hl(value - 1);
-    std::println("DEC HL");
     break;
   }
   case 0x3B: {
     regFile.sp -= 1;
-    std::println("DEC SP");
     break;
   }
 
   // ADD HL, r16
   case 0x09: {
     alu_add_hl(regFile.get_bc());
-    std::println("ADD HL, BC");
     break;
   }
   case 0x19: {
     alu_add_hl(regFile.get_de());
-    std::println("ADD HL, DE");
     break;
   }
   case 0x29: {
     alu_add_hl(regFile.get_hl());
-    std::println("ADD HL, HL");
     break;
   }
   case 0x39: {
     alu_add_hl(regFile.sp);
-    std::println("ADD HL, SP");
     break;
   }
 
   // INC r8
   case 0x04: {
     regFile.b = alu_inc(regFile.b);
-    std::println("INC B");
     break;
   }
   case 0x14: {
     regFile.d = alu_inc(regFile.d);
-    std::println("INC D");
     break;
   }
   case 0x24: {
     regFile.h = alu_inc(regFile.h);
-    std::println("INC H");
     break;
   }
   case 0x34: {
@@ -339,44 +395,36 @@ void CPU::execute() {
     const uint8_t value = memory.get_byte(addr);
     const uint8_t result = alu_inc(value);
     memory.set_byte(addr, result);
-    std::println("INC (HL)");
     break;
   }
   case 0x0C: {
     regFile.c = alu_inc(regFile.c);
-    std::println("INC C");
     break;
   }
   case 0x1C: {
     regFile.e = alu_inc(regFile.e);
-    std::println("INC E");
     break;
   }
   case 0x2C: {
     regFile.l = alu_inc(regFile.l);
-    std::println("INC L");
     break;
   }
   case 0x3C: {
     regFile.a = alu_inc(regFile.a);
-    std::println("INC A");
     break;
   }
 
   // DEC r8
   case 0x05: {
     regFile.b = alu_dec(regFile.b);
-    std::println("DEC B");
     break;
   }
   case 0x15: {
     regFile.d = alu_dec(regFile.d);
-    std::println("DEC D");
     break;
   }
   case 0x25: {
     regFile.h = alu_dec(regFile.h);
-    std::println("DEC H");
     break;
   }
   case 0x35: {
@@ -384,27 +432,22 @@ void CPU::execute() {
     const uint8_t value = memory.get_byte(addr);
     const uint8_t result = alu_dec(value);
     memory.set_byte(addr, result);
-    std::println("DEC (HL)");
     break;
   }
   case 0x0D: {
     regFile.c = alu_dec(regFile.c);
-    std::println("DEC C");
     break;
   }
   case 0x1D: {
     regFile.e = alu_dec(regFile.e);
-    std::println("DEC E");
     break;
   }
   case 0x2D: {
     regFile.l = alu_dec(regFile.l);
-    std::println("DEC L");
     break;
   }
   case 0x3D: {
     regFile.a = alu_dec(regFile.a);
-    std::println("DEC A");
     break;
   }
 
@@ -412,50 +455,42 @@ void CPU::execute() {
   case 0x06: {
     const uint8_t imm8 = imm_byte();
     regFile.b = imm8;
-    std::println("LD B, 0x{:02X}", imm8);
     break;
   }
   case 0x16: {
     const uint8_t imm8 = imm_byte();
     regFile.d = imm8;
-    std::println("LD D, 0x{:02X}", imm8);
     break;
   }
   case 0x26: {
     const uint8_t imm8 = imm_byte();
     regFile.h = imm8;
-    std::println("LD H, 0x{:02X}", imm8);
     break;
   }
   case 0x36: {
     const uint8_t imm8 = imm_byte();
     const uint16_t addr = regFile.get_hl();
     memory.set_byte(addr, imm8);
-    std::println("LD (HL), 0x{:02X}", imm8);
     break;
   }
   case 0x0E: {
     const uint8_t imm8 = imm_byte();
     regFile.c = imm8;
-    std::println("LD C, 0x{:02X}", imm8);
     break;
   }
   case 0x1E: {
     const uint8_t imm8 = imm_byte();
     regFile.e = imm8;
-    std::println("LD E, 0x{:02X}", imm8);
     break;
   }
   case 0x2E: {
     const uint8_t imm8 = imm_byte();
     regFile.l = imm8;
-    std::println("LD L, 0x{:02X}", imm8);
     break;
   }
   case 0x3E: {
     const uint8_t imm8 = imm_byte();
     regFile.a = imm8;
-    std::println("LD A, 0x{:02X}", imm8);
     break;
   }
 
@@ -472,7 +507,6 @@ void CPU::execute() {
   case 0x18: {
     const uint8_t imm8 = imm_byte();
     alu_jr(imm8);
-    std::println("JR 0x{:02X}", imm8);
     break;
   }
 
@@ -481,9 +515,7 @@ void CPU::execute() {
     const uint8_t imm8 = imm_byte();
     if (!regFile.get_flag(Flag::Z)) {
       alu_jr(imm8);
-      std::println("JR NZ, 0x{:02X}", imm8);
-    } else {
-      std::println("JR NZ, 0x{:02X} (not taken)", imm8);
+      tick(info.branch_cycles - info.cycles);
     }
     break;
   }
@@ -491,9 +523,7 @@ void CPU::execute() {
     const uint8_t imm8 = imm_byte();
     if (!regFile.get_flag(Flag::C)) {
       alu_jr(imm8);
-      std::println("JR NC, 0x{:02X}", imm8);
-    } else {
-      std::println("JR NC, 0x{:02X} (not taken)", imm8);
+      tick(info.branch_cycles - info.cycles);
     }
     break;
   }
@@ -501,9 +531,7 @@ void CPU::execute() {
     const uint8_t imm8 = imm_byte();
     if (regFile.get_flag(Flag::Z)) {
       alu_jr(imm8);
-      std::println("JR Z, 0x{:02X}", imm8);
-    } else {
-      std::println("JR Z, 0x{:02X} (not taken)", imm8);
+      tick(info.branch_cycles - info.cycles);
     }
     break;
   }
@@ -511,698 +539,568 @@ void CPU::execute() {
     const uint8_t imm8 = imm_byte();
     if (regFile.get_flag(Flag::C)) {
       alu_jr(imm8);
-      std::println("JR C, 0x{:02X}", imm8);
-    } else {
-      std::println("JR C, 0x{:02X} (not taken)", imm8);
+      tick(info.branch_cycles - info.cycles);
     }
     break;
   }
 
   // STOP
   case 0x10: {
-    std::println("STOP");
     break;
   }
 
   // LD r8, r8
   case 0x40: {
-    std::println("LD B, B");
     break;
   }
   case 0x50: {
     regFile.d = regFile.b;
-    std::println("LD D, B");
     break;
   }
   case 0x60: {
     regFile.h = regFile.b;
-    std::println("LD H, B");
     break;
   }
   case 0x70: {
     const uint16_t addr = regFile.get_hl();
     memory.set_byte(addr, regFile.b);
-    std::println("LD (HL), B");
     break;
   }
   case 0x41: {
     regFile.b = regFile.c;
-    std::println("LD B, C");
     break;
   }
   case 0x51: {
     regFile.d = regFile.c;
-    std::println("LD D, C");
     break;
   }
   case 0x61: {
     regFile.h = regFile.c;
-    std::println("LD H, C");
     break;
   }
   case 0x71: {
     const uint16_t addr = regFile.get_hl();
     memory.set_byte(addr, regFile.c);
-    std::println("LD (HL), C");
     break;
   }
   case 0x42: {
     regFile.b = regFile.d;
-    std::println("LD B, D");
     break;
   }
   case 0x52: {
-    std::println("LD D, D");
     break;
   }
   case 0x62: {
     regFile.h = regFile.d;
-    std::println("LD H, D");
     break;
   }
   case 0x72: {
     const uint16_t addr = regFile.get_hl();
     memory.set_byte(addr, regFile.d);
-    std::println("LD (HL), D");
     break;
   }
   case 0x43: {
     regFile.b = regFile.e;
-    std::println("LD B, E");
     break;
   }
   case 0x53: {
     regFile.d = regFile.e;
-    std::println("LD D, E");
     break;
   }
   case 0x63: {
     regFile.h = regFile.e;
-    std::println("LD H, E");
     break;
   }
   case 0x73: {
     const uint16_t addr = regFile.get_hl();
     memory.set_byte(addr, regFile.e);
-    std::println("LD (HL), E");
     break;
   }
   case 0x44: {
     regFile.b = regFile.h;
-    std::println("LD B, H");
     break;
   }
   case 0x54: {
     regFile.d = regFile.h;
-    std::println("LD D, H");
     break;
   }
   case 0x64: {
-    std::println("LD H, H");
     break;
   }
   case 0x74: {
     const uint16_t addr = regFile.get_hl();
     memory.set_byte(addr, regFile.h);
-    std::println("LD (HL), H");
     break;
   }
   case 0x45: {
     regFile.b = regFile.l;
-    std::println("LD B, L");
     break;
   }
   case 0x55: {
     regFile.d = regFile.l;
-    std::println("LD D, L");
     break;
   }
   case 0x65: {
     regFile.h = regFile.l;
-    std::println("LD H, L");
     break;
   }
   case 0x75: {
     const uint16_t addr = regFile.get_hl();
     memory.set_byte(addr, regFile.l);
-    std::println("LD (HL), L");
     break;
   }
   case 0x46: {
     const uint16_t addr = regFile.get_hl();
     regFile.b = memory.get_byte(addr);
-    std::println("LD B, (HL)");
     break;
   }
   case 0x56: {
     const uint16_t addr = regFile.get_hl();
     regFile.d = memory.get_byte(addr);
-    std::println("LD D, (HL)");
     break;
   }
   case 0x66: {
     const uint16_t addr = regFile.get_hl();
     regFile.h = memory.get_byte(addr);
-    std::println("LD H, (HL)");
     break;
   }
   case 0x76: {
-    std::println("HALT");
+    state.halted = true;
     break;
   }
   case 0x47: {
     regFile.b = regFile.a;
-    std::println("LD B, A");
     break;
   }
   case 0x57: {
     regFile.d = regFile.a;
-    std::println("LD D, A");
     break;
   }
   case 0x67: {
     regFile.h = regFile.a;
-    std::println("LD H, A");
     break;
   }
   case 0x77: {
     const uint16_t addr = regFile.get_hl();
     memory.set_byte(addr, regFile.a);
-    std::println("LD (HL), A");
     break;
   }
   case 0x48: {
     regFile.c = regFile.b;
-    std::println("LD C, B");
     break;
   }
   case 0x58: {
     regFile.e = regFile.b;
-    std::println("LD E, B");
     break;
   }
   case 0x68: {
     regFile.l = regFile.b;
-    std::println("LD L, B");
     break;
   }
   case 0x78: {
     regFile.a = regFile.b;
-    std::println("LD A, B");
     break;
   }
   case 0x49: {
-    std::println("LD C, C");
     break;
   }
   case 0x59: {
     regFile.e = regFile.c;
-    std::println("LD E, C");
     break;
   }
   case 0x69: {
     regFile.l = regFile.c;
-    std::println("LD L, C");
     break;
   }
   case 0x79: {
     regFile.a = regFile.c;
-    std::println("LD A, C");
     break;
   }
   case 0x4A: {
     regFile.c = regFile.d;
-    std::println("LD C, D");
     break;
   }
   case 0x5A: {
     regFile.e = regFile.d;
-    std::println("LD E, D");
     break;
   }
   case 0x6A: {
     regFile.l = regFile.d;
-    std::println("LD L, D");
     break;
   }
   case 0x7A: {
     regFile.a = regFile.d;
-    std::println("LD A, D");
     break;
   }
   case 0x4B: {
     regFile.c = regFile.e;
-    std::println("LD C, E");
     break;
   }
   case 0x5B: {
     regFile.e = regFile.e;
-    std::println("LD E, E");
     break;
   }
   case 0x6B: {
     regFile.l = regFile.e;
-    std::println("LD L, E");
     break;
   }
   case 0x7B: {
     regFile.a = regFile.e;
-    std::println("LD A, E");
     break;
   }
   case 0x4C: {
     regFile.c = regFile.h;
-    std::println("LD C, H");
     break;
   }
   case 0x5C: {
     regFile.e = regFile.h;
-    std::println("LD E, H");
     break;
   }
   case 0x6C: {
     regFile.l = regFile.h;
-    std::println("LD L, H");
     break;
   }
   case 0x7C: {
     regFile.a = regFile.h;
-    std::println("LD A, H");
     break;
   }
   case 0x4D: {
     regFile.c = regFile.l;
-    std::println("LD C, L");
     break;
   }
   case 0x5D: {
     regFile.e = regFile.l;
-    std::println("LD E, L");
     break;
   }
   case 0x6D: {
     regFile.l = regFile.l;
-    std::println("LD L, L");
     break;
   }
   case 0x7D: {
     regFile.a = regFile.l;
-    std::println("LD A, L");
     break;
   }
   case 0x4E: {
     const uint16_t addr = regFile.get_hl();
     regFile.c = memory.get_byte(addr);
-    std::println("LD C, (HL)");
     break;
   }
   case 0x5E: {
     const uint16_t addr = regFile.get_hl();
     regFile.e = memory.get_byte(addr);
-    std::println("LD E, (HL)");
     break;
   }
   case 0x6E: {
     const uint16_t addr = regFile.get_hl();
     regFile.l = memory.get_byte(addr);
-    std::println("LD L, (HL)");
     break;
   }
   case 0x7E: {
     const uint16_t addr = regFile.get_hl();
     regFile.a = memory.get_byte(addr);
-    std::println("LD A, (HL)");
     break;
   }
   case 0x4F: {
     regFile.c = regFile.a;
-    std::println("LD C, A");
     break;
   }
   case 0x5F: {
     regFile.e = regFile.a;
-    std::println("LD E, A");
     break;
   }
   case 0x6F: {
     regFile.l = regFile.a;
-    std::println("LD L, A");
     break;
   }
   case 0x7F: {
     regFile.a = regFile.a;
-    std::println("LD A, A");
     break;
   }
 
   // ADD A, r8
   case 0x80: {
     regFile.a = alu_add(regFile.b);
-    std::println("ADD A, B");
     break;
   }
   case 0x81: {
     regFile.a = alu_add(regFile.c);
-    std::println("ADD A, C");
     break;
   }
   case 0x82: {
     regFile.a = alu_add(regFile.d);
-    std::println("ADD A, D");
     break;
   }
   case 0x83: {
     regFile.a = alu_add(regFile.e);
-    std::println("ADD A, E");
     break;
   }
   case 0x84: {
     regFile.a = alu_add(regFile.h);
-    std::println("ADD A, H");
     break;
   }
   case 0x85: {
     regFile.a = alu_add(regFile.l);
-    std::println("ADD A, L");
     break;
   }
   case 0x86: {
     const uint16_t addr = regFile.get_hl();
     const uint8_t value = memory.get_byte(addr);
     regFile.a = alu_add(value);
-    std::println("ADD A, (HL)");
     break;
   }
   case 0x87: {
     regFile.a = alu_add(regFile.a);
-    std::println("ADD A, A");
     break;
   }
 
   // ADC A, r8
   case 0x88: {
     regFile.a = alu_adc(regFile.b);
-    std::println("ADC A, B");
     break;
   }
   case 0x89: {
     regFile.a = alu_adc(regFile.c);
-    std::println("ADC A, C");
     break;
   }
   case 0x8A: {
     regFile.a = alu_adc(regFile.d);
-    std::println("ADC A, D");
     break;
   }
   case 0x8B: {
     regFile.a = alu_adc(regFile.e);
-    std::println("ADC A, E");
     break;
   }
   case 0x8C: {
     regFile.a = alu_adc(regFile.h);
-    std::println("ADC A, H");
     break;
   }
   case 0x8D: {
     regFile.a = alu_adc(regFile.l);
-    std::println("ADC A, L");
     break;
   }
   case 0x8E: {
     const uint16_t addr = regFile.get_hl();
     const uint8_t value = memory.get_byte(addr);
     regFile.a = alu_adc(value);
-    std::println("ADC A, (HL)");
     break;
   }
   case 0x8F: {
     regFile.a = alu_adc(regFile.a);
-    std::println("ADC A, A");
     break;
   }
 
   // SUB A, r8
   case 0x90: {
     regFile.a = alu_sub(regFile.b);
-    std::println("SUB A, B");
     break;
   }
   case 0x91: {
     regFile.a = alu_sub(regFile.c);
-    std::println("SUB A, C");
     break;
   }
   case 0x92: {
     regFile.a = alu_sub(regFile.d);
-    std::println("SUB A, D");
     break;
   }
   case 0x93: {
     regFile.a = alu_sub(regFile.e);
-    std::println("SUB A, E");
     break;
   }
   case 0x94: {
     regFile.a = alu_sub(regFile.h);
-    std::println("SUB A, H");
     break;
   }
   case 0x95: {
     regFile.a = alu_sub(regFile.l);
-    std::println("SUB A, L");
     break;
   }
   case 0x96: {
     const uint16_t addr = regFile.get_hl();
     const uint8_t value = memory.get_byte(addr);
     regFile.a = alu_sub(value);
-    std::println("SUB A, (HL)");
     break;
   }
   case 0x97: {
     regFile.a = alu_sub(regFile.a);
-    std::println("SUB A, A");
     break;
   }
 
   // SBC A, r8
   case 0x98: {
     regFile.a = alu_sbc(regFile.b);
-    std::println("SBC A, B");
     break;
   }
   case 0x99: {
     regFile.a = alu_sbc(regFile.c);
-    std::println("SBC A, C");
     break;
   }
   case 0x9A: {
     regFile.a = alu_sbc(regFile.d);
-    std::println("SBC A, D");
     break;
   }
   case 0x9B: {
     regFile.a = alu_sbc(regFile.e);
-    std::println("SBC A, E");
     break;
   }
   case 0x9C: {
     regFile.a = alu_sbc(regFile.h);
-    std::println("SBC A, H");
     break;
   }
   case 0x9D: {
     regFile.a = alu_sbc(regFile.l);
-    std::println("SBC A, L");
     break;
   }
   case 0x9E: {
     const uint16_t addr = regFile.get_hl();
     const uint8_t value = memory.get_byte(addr);
     regFile.a = alu_sbc(value);
-    std::println("SBC A, (HL)");
     break;
   }
   case 0x9F: {
     regFile.a = alu_sbc(regFile.a);
-    std::println("SBC A, A");
     break;
   }
 
   // AND A, r8
   case 0xA0: {
     regFile.a = alu_and(regFile.b);
-    std::println("AND A, B");
     break;
   }
   case 0xA1: {
     regFile.a = alu_and(regFile.c);
-    std::println("AND A, C");
     break;
   }
   case 0xA2: {
     regFile.a = alu_and(regFile.d);
-    std::println("AND A, D");
     break;
   }
   case 0xA3: {
     regFile.a = alu_and(regFile.e);
-    std::println("AND A, E");
     break;
   }
   case 0xA4: {
     regFile.a = alu_and(regFile.h);
-    std::println("AND A, H");
     break;
   }
   case 0xA5: {
     regFile.a = alu_and(regFile.l);
-    std::println("AND A, L");
     break;
   }
   case 0xA6: {
     const uint16_t addr = regFile.get_hl();
     const uint8_t value = memory.get_byte(addr);
     regFile.a = alu_and(value);
-    std::println("AND A, (HL)");
     break;
   }
   case 0xA7: {
     regFile.a = alu_and(regFile.a);
-    std::println("AND A, A");
     break;
   }
 
   case 0xA8: {
     regFile.a = alu_xor(regFile.b);
-    std::println("XOR A, B");
     break;
   }
   case 0xA9: {
     regFile.a = alu_xor(regFile.c);
-    std::println("XOR A, C");
     break;
   }
   case 0xAA: {
     regFile.a = alu_xor(regFile.d);
-    std::println("XOR A, D");
     break;
   }
   case 0xAB: {
     regFile.a = alu_xor(regFile.e);
-    std::println("XOR A, E");
     break;
   }
   case 0xAC: {
     regFile.a = alu_xor(regFile.h);
-    std::println("XOR A, H");
     break;
   }
   case 0xAD: {
     regFile.a = alu_xor(regFile.l);
-    std::println("XOR A, L");
     break;
   }
   case 0xAE: {
     const uint16_t addr = regFile.get_hl();
     const uint8_t value = memory.get_byte(addr);
     regFile.a = alu_xor(value);
-    std::println("XOR A, (HL)");
     break;
   }
   case 0xAF: {
     regFile.a = alu_xor(regFile.a);
-    std::println("XOR A, A");
     break;
   }
 
   // OR A, r8
   case 0xB0: {
     regFile.a = alu_or(regFile.b);
-    std::println("OR A, B");
     break;
   }
   case 0xB1: {
     regFile.a = alu_or(regFile.c);
-    std::println("OR A, C");
     break;
   }
   case 0xB2: {
     regFile.a = alu_or(regFile.d);
-    std::println("OR A, D");
     break;
   }
   case 0xB3: {
     regFile.a = alu_or(regFile.e);
-    std::println("OR A, E");
     break;
   }
   case 0xB4: {
     regFile.a = alu_or(regFile.h);
-    std::println("OR A, H");
     break;
   }
   case 0xB5: {
     regFile.a = alu_or(regFile.l);
-    std::println("OR A, L");
     break;
   }
   case 0xB6: {
     const uint16_t addr = regFile.get_hl();
     const uint8_t value = memory.get_byte(addr);
     regFile.a = alu_or(value);
-    std::println("OR A, (HL)");
     break;
   }
   case 0xB7: {
     regFile.a = alu_or(regFile.a);
-    std::println("OR A, A");
     break;
   }
 
   // CP A, r8
   case 0xB8: {
     alu_cp(regFile.b);
-    std::println("CP A, B");
     break;
   }
   case 0xB9: {
     alu_cp(regFile.c);
-    std::println("CP A, C");
     break;
   }
   case 0xBA: {
     alu_cp(regFile.d);
-    std::println("CP A, D");
     break;
   }
   case 0xBB: {
     alu_cp(regFile.e);
-    std::println("CP A, E");
     break;
   }
   case 0xBC: {
     alu_cp(regFile.h);
-    std::println("CP A, H");
     break;
   }
   case 0xBD: {
     alu_cp(regFile.l);
-    std::println("CP A, L");
     break;
   }
   case 0xBE: {
     const uint16_t addr = regFile.get_hl();
     const uint8_t value = memory.get_byte(addr);
     alu_cp(value);
-    std::println("CP A, (HL)");
     break;
   }
   case 0xBF: {
     alu_cp(regFile.a);
-    std::println("CP A, A");
     break;
   }
 
@@ -1210,7 +1108,6 @@ void CPU::execute() {
   case 0xC6: {
     const uint8_t imm8 = imm_byte();
     regFile.a = alu_add(imm8);
-    std::println("ADD A, 0x{:02X}", imm8);
     break;
   }
 
@@ -1218,7 +1115,6 @@ void CPU::execute() {
   case 0xD6: {
     const uint8_t imm8 = imm_byte();
     regFile.a = alu_sub(imm8);
-    std::println("SUB A, 0x{:02X}", imm8);
     break;
   }
 
@@ -1226,7 +1122,6 @@ void CPU::execute() {
   case 0xE6: {
     const uint8_t imm8 = imm_byte();
     regFile.a = alu_and(imm8);
-    std::println("AND A, 0x{:02X}", imm8);
     break;
   }
 
@@ -1234,7 +1129,6 @@ void CPU::execute() {
   case 0xF6: {
     const uint8_t imm8 = imm_byte();
     regFile.a = alu_or(imm8);
-    std::println("OR A, 0x{:02X}", imm8);
     break;
   }
 
@@ -1242,36 +1136,28 @@ void CPU::execute() {
   case 0xC0: {
     if (!regFile.get_flag(Flag::Z)) {
       alu_ret();
-      std::println("RET NZ");
-    } else {
-      std::println("RET NZ (not taken)");
+      tick(info.branch_cycles - info.cycles);
     }
     break;
   }
   case 0xD0: {
     if (!regFile.get_flag(Flag::C)) {
       alu_ret();
-      std::println("RET NC");
-    } else {
-      std::println("RET NC (not taken)");
+      tick(info.branch_cycles - info.cycles);
     }
     break;
   }
   case 0xC8: {
     if (regFile.get_flag(Flag::Z)) {
       alu_ret();
-      std::println("RET Z");
-    } else {
-      std::println("RET Z (not taken)");
+      tick(info.branch_cycles - info.cycles);
     }
     break;
   }
   case 0xD8: {
     if (regFile.get_flag(Flag::C)) {
       alu_ret();
-      std::println("RET C");
-    } else {
-      std::println("RET C (not taken)");
+      tick(info.branch_cycles - info.cycles);
     }
     break;
   }
@@ -1279,20 +1165,16 @@ void CPU::execute() {
   // RET
   case 0xC9: {
     alu_ret();
-    std::println("RET");
     break;
   }
 
-  // todo: implement IME flag and RETI instruction
 
   // JP cond, imm16
   case 0xC2: {
     const uint16_t addr = imm_word();
     if (!regFile.get_flag(Flag::Z)) {
       alu_jp(addr);
-      std::println("JP NZ, 0x{:04X}", addr);
-    } else {
-      std::println("JP NZ, 0x{:04X} (not taken)", addr);
+      tick(info.branch_cycles - info.cycles);
     }
     break;
   }
@@ -1300,9 +1182,7 @@ void CPU::execute() {
     const uint16_t addr = imm_word();
     if (!regFile.get_flag(Flag::C)) {
       alu_jp(addr);
-      std::println("JP NC, 0x{:04X}", addr);
-    } else {
-      std::println("JP NC, 0x{:04X} (not taken)", addr);
+      tick(info.branch_cycles - info.cycles);
     }
     break;
   }
@@ -1310,9 +1190,7 @@ void CPU::execute() {
     const uint16_t addr = imm_word();
     if (regFile.get_flag(Flag::Z)) {
       alu_jp(addr);
-      std::println("JP Z, 0x{:04X}", addr);
-    } else {
-      std::println("JP Z, 0x{:04X} (not taken)", addr);
+      tick(info.branch_cycles - info.cycles);
     }
     break;
   }
@@ -1320,9 +1198,7 @@ void CPU::execute() {
     const uint16_t addr = imm_word();
     if (regFile.get_flag(Flag::C)) {
       alu_jp(addr);
-      std::println("JP C, 0x{:04X}", addr);
-    } else {
-      std::println("JP C, 0x{:04X} (not taken)", addr);
+      tick(info.branch_cycles - info.cycles);
     }
     break;
   }
@@ -1331,7 +1207,6 @@ void CPU::execute() {
   case 0xC3: {
     const uint16_t addr = imm_word();
     alu_jp(addr);
-    std::println("JP 0x{:04X}", addr);
     break;
   }
 
@@ -1339,14 +1214,159 @@ void CPU::execute() {
   case 0xE9: {
     const uint16_t addr = regFile.get_hl();
     alu_jp(addr);
-    std::println("JP HL");
+    break;
+  }
+
+  // RETI
+  case 0xD9: {
+    alu_ret();
+    state.ime = true;
+    break;
+  }
+
+  // CALL imm16
+  case 0xCD: {
+    const uint16_t addr = imm_word();
+    alu_call(addr);
+    break;
+  }
+
+  // CALL cond, imm16
+  case 0xC4: {
+    const uint16_t addr = imm_word();
+    if (!regFile.get_flag(Flag::Z)) {
+      alu_call(addr);
+      tick(info.branch_cycles - info.cycles);
+    }
+    break;
+  }
+  case 0xD4: {
+    const uint16_t addr = imm_word();
+    if (!regFile.get_flag(Flag::C)) {
+      alu_call(addr);
+      tick(info.branch_cycles - info.cycles);
+    }
+    break;
+  }
+  case 0xCC: {
+    const uint16_t addr = imm_word();
+    if (regFile.get_flag(Flag::Z)) {
+      alu_call(addr);
+      tick(info.branch_cycles - info.cycles);
+    }
+    break;
+  }
+  case 0xDC: {
+    const uint16_t addr = imm_word();
+    if (regFile.get_flag(Flag::C)) {
+      alu_call(addr);
+      tick(info.branch_cycles - info.cycles);
+    }
+    break;
+  }
+
+  // RST vec
+  case 0xC7:
+  case 0xCF:
+  case 0xD7:
+  case 0xDF:
+  case 0xE7:
+  case 0xEF:
+  case 0xF7:
+  case 0xFF: {
+    const uint16_t addr = byte0 & 0x38;
+    alu_call(addr);
+    break;
+  }
+
+  // POP r16
+  case 0xC1: {
+    regFile.set_bc(alu_pop());
+    break;
+  }
+  case 0xD1: {
+    regFile.set_de(alu_pop());
+    break;
+  }
+  case 0xE1: {
+    regFile.set_hl(alu_pop());
+    break;
+  }
+  case 0xF1: {
+    // The low nibble of F always reads as zero.
+    regFile.set_af(alu_pop() & 0xFFF0);
+    break;
+  }
+
+  // PUSH r16
+  case 0xC5: {
+    alu_push(regFile.get_bc());
+    break;
+  }
+  case 0xD5: {
+    alu_push(regFile.get_de());
+    break;
+  }
+  case 0xE5: {
+    alu_push(regFile.get_hl());
+    break;
+  }
+  case 0xF5: {
+    alu_push(regFile.get_af());
+    break;
+  }
+
+  // LDH (imm8), A / LDH A, (imm8)
+  case 0xE0: {
+    const uint8_t imm8 = imm_byte();
+    memory.set_byte(0xFF00 + imm8, regFile.a);
+    break;
+  }
+  case 0xF0: {
+    const uint8_t imm8 = imm_byte();
+    regFile.a = memory.get_byte(0xFF00 + imm8);
+    break;
+  }
+
+  // LDH (C), A / LDH A, (C)
+  case 0xE2: {
+    memory.set_byte(0xFF00 + regFile.c, regFile.a);
+    break;
+  }
+  case 0xF2: {
+    regFile.a = memory.get_byte(0xFF00 + regFile.c);
+    break;
+  }
+
+  // LD (imm16), A / LD A, (imm16)
+  case 0xEA: {
+    const uint16_t addr = imm_word();
+    memory.set_byte(addr, regFile.a);
+    break;
+  }
+  case 0xFA: {
+    const uint16_t addr = imm_word();
+    regFile.a = memory.get_byte(addr);
+    break;
+  }
+
+  // DI / EI
+  case 0xF3: {
+    state.ime = false;
+    state.ime_pending = false;
+    break;
+  }
+  case 0xFB: {
+    state.ime_pending = true;
     break;
   }
 
   default: {
-    std::println(stderr,
-                 "Error: Unknown opcode found (PC: 0x{:04X} OPCODE: 0x{:02X})",
-                 regFile.pc - 1, byte0);
+    if (report_unknown_opcodes) {
+      std::println(
+          stderr, "Error: Unknown opcode found (PC: 0x{:04X} OPCODE: 0x{:02X})",
+          regFile.pc - 1, byte0);
+    }
     break;
   }
   }
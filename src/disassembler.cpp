@@ -0,0 +1,138 @@
+#include "disassembler.hpp"
+
+#include "mmu.hpp"
+#include "opcodes.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+namespace {
+
+std::string_view operand_name(Operand operand) {
+  switch (operand) {
+  case Operand::B:
+    return "B";
+  case Operand::C:
+  case Operand::CondC:
+    return "C";
+  case Operand::D:
+    return "D";
+  case Operand::E:
+    return "E";
+  case Operand::H:
+    return "H";
+  case Operand::L:
+    return "L";
+  case Operand::HlIndirect:
+    return "(HL)";
+  case Operand::A:
+    return "A";
+  case Operand::BC:
+    return "BC";
+  case Operand::DE:
+    return "DE";
+  case Operand::HL:
+    return "HL";
+  case Operand::SP:
+    return "SP";
+  case Operand::AF:
+    return "AF";
+  case Operand::BcIndirect:
+    return "(BC)";
+  case Operand::DeIndirect:
+    return "(DE)";
+  case Operand::HlIncrement:
+    return "(HL+)";
+  case Operand::HlDecrement:
+    return "(HL-)";
+  case Operand::CondNz:
+    return "NZ";
+  case Operand::CondZ:
+    return "Z";
+  case Operand::CondNc:
+    return "NC";
+  case Operand::HighC:
+    return "(C)";
+  default:
+    return {};
+  }
+}
+
+uint16_t get_word(const uint8_t *immediate) {
+  return static_cast<uint16_t>(immediate[0] | immediate[1] << 8);
+}
+
+int get_offset(const uint8_t *immediate) {
+  return static_cast<int8_t>(immediate[0]);
+}
+
+// `immediate` points at the bytes after the opcode, and only operands that
+// take immediates read it; it is nullptr for CB instructions, which have
+// none.
+void append_operand(std::string &out, Operand operand, const OpcodeInfo &info,
+                    uint16_t addr, const uint8_t *immediate) {
+  switch (operand) {
+  case Operand::Imm8:
+    std::format_to(std::back_inserter(out), "0x{:02X}", immediate[0]);
+    break;
+  case Operand::Imm16:
+    std::format_to(std::back_inserter(out), "0x{:04X}", get_word(immediate));
+    break;
+  case Operand::Signed8:
+    std::format_to(std::back_inserter(out), "{:+}", get_offset(immediate));
+    break;
+  case Operand::Relative8:
+    std::format_to(std::back_inserter(out), "0x{:04X}",
+                   static_cast<uint16_t>(addr + info.length +
+                                         get_offset(immediate)));
+    break;
+  case Operand::Address16:
+    std::format_to(std::back_inserter(out), "(0x{:04X})",
+                   get_word(immediate));
+    break;
+  case Operand::HighAddress8:
+    std::format_to(std::back_inserter(out), "(0x{:02X})", immediate[0]);
+    break;
+  case Operand::SpOffset:
+    std::format_to(std::back_inserter(out), "SP{:+}", get_offset(immediate));
+    break;
+  case Operand::Bit:
+    std::format_to(std::back_inserter(out), "{}", info.value);
+    break;
+  case Operand::Vector:
+    std::format_to(std::back_inserter(out), "0x{:02X}", info.value);
+    break;
+  default:
+    out += operand_name(operand);
+    break;
+  }
+}
+
+} // namespace
+
+std::string disassemble(uint16_t addr, const InstructionBytes &bytes) {
+  const OpcodeInfo &info = decode(bytes);
+  if (info.mnemonic.empty()) {
+    return std::format("DB 0x{:02X}", bytes[0]);
+  }
+
+  std::string out(info.mnemonic);
+  // Immediates follow the opcode; CB instructions have none.
+  const uint8_t *immediate = bytes[0] == 0xCB ? nullptr : bytes.data() + 1;
+  for (size_t i = 0; i < info.operands.size(); ++i) {
+    if (info.operands[i] == Operand::None) {
+      break;
+    }
+    out += i == 0 ? " " : ", ";
+    append_operand(out, info.operands[i], info, addr, immediate);
+  }
+  return out;
+}
+
+InstructionBytes read_instruction(const MMU &mmu, uint16_t addr) {
+  return {mmu.peek(addr), mmu.peek(static_cast<uint16_t>(addr + 1)),
+          mmu.peek(static_cast<uint16_t>(addr + 2))};
+}
@@ -0,0 +1,446 @@
+#include "emugb.h"
+
+#include "cartridge.hpp"
+#include "cheats.hpp"
+#include "gameboy.hpp"
+#include "joypad.hpp"
+#include "machine_state.hpp"
+#include "mmu.hpp"
+#include "ppu.hpp"
+#include "rom_file.hpp"
+#include "vec_env.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+struct emugb {
+  GameBoy gameboy;
+  // Codes added through emugb_add_cheat().
+  Cheats cheats{};
+};
+
+struct emugb_batch {
+  VecEnv env;
+};
+
+namespace {
+
+static_assert(EMUGB_BUTTON_RIGHT == static_cast<int>(Button::Right));
+static_assert(EMUGB_BUTTON_LEFT == static_cast<int>(Button::Left));
+static_assert(EMUGB_BUTTON_UP == static_cast<int>(Button::Up));
+static_assert(EMUGB_BUTTON_DOWN == static_cast<int>(Button::Down));
+static_assert(EMUGB_BUTTON_A == static_cast<int>(Button::A));
+static_assert(EMUGB_BUTTON_B == static_cast<int>(Button::B));
+static_assert(EMUGB_BUTTON_SELECT == static_cast<int>(Button::Select));
+static_assert(EMUGB_BUTTON_START == static_cast<int>(Button::Start));
+static_assert(EMUGB_ACCESS_READ == static_cast<int>(Access::Read));
+static_assert(EMUGB_ACCESS_WRITE == static_cast<int>(Access::Write));
+static_assert(EMUGB_ACCESS_EXECUTE == static_cast<int>(Access::Execute));
+static_assert(EMUGB_SCREEN_WIDTH == PPU::width);
+static_assert(EMUGB_SCREEN_HEIGHT == PPU::height);
+static_assert(EMUGB_CYCLES_PER_FRAME == GameBoy::cycles_per_frame);
+
+// Prepended to the state block so that a buffer from elsewhere, or from a
+// build with a different MachineState layout, is rejected.
+struct SnapshotHeader {
+  char magic[8];
+  uint64_t state_size;
+};
+
+constexpr char snapshot_magic[8] = {'E', 'M', 'U', 'G', 'B', 'S', 'N', 'P'};
+
+emugb_status to_status(LoadError error) {
+  switch (error) {
+  case LoadError::OpenFailed:
+    return EMUGB_ERROR_OPEN_FAILED;
+  case LoadError::ReadFailed:
+    return EMUGB_ERROR_READ_FAILED;
+  case LoadError::InvalidRom:
+    return EMUGB_ERROR_INVALID_ROM;
+  case LoadError::InvalidArchive:
+    return EMUGB_ERROR_INVALID_ARCHIVE;
+  }
+  std::unreachable();
+}
+
+RomCache rom_cache(0);
+std::atomic<bool> rom_cache_enabled = false;
+
+emugb_status create(LoadResult cartridge, emugb **out) {
+  if (!cartridge) {
+    return to_status(cartridge.error());
+  }
+  *out = new (std::nothrow) emugb{GameBoy(std::move(*cartridge))};
+  return *out != nullptr ? EMUGB_OK : EMUGB_ERROR_OUT_OF_MEMORY;
+}
+
+} // namespace
+
+extern "C" {
+
+const char *emugb_status_string(emugb_status status) {
+  switch (status) {
+  case EMUGB_OK:
+    return "ok";
+  case EMUGB_ERROR_INVALID_ARGUMENT:
+    return "invalid argument";
+  case EMUGB_ERROR_OPEN_FAILED:
+    return "could not open file";
+  case EMUGB_ERROR_READ_FAILED:
+    return "could not read file";
+  case EMUGB_ERROR_INVALID_ROM:
+    return "not a Game Boy ROM";
+  case EMUGB_ERROR_INVALID_SNAPSHOT:
+    return "invalid snapshot";
+  case EMUGB_ERROR_OUT_OF_MEMORY:
+    return "out of memory";
+  case EMUGB_BREAKPOINT:
+    return "stopped at a breakpoint";
+  case EMUGB_ERROR_INVALID_ARCHIVE:
+    return "corrupt or unsupported archive";
+  case EMUGB_ERROR_THREAD_FAILED:
+    return "could not start a thread";
+  }
+  return "unknown error";
+}
+
+emugb_status emugb_create_from_path(const char *path, emugb **out) {
+  if (path == nullptr || out == nullptr) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  *out = nullptr;
+  try {
+    RomCache *cache = rom_cache_enabled.load(std::memory_order_relaxed)
+                          ? &rom_cache
+                          : nullptr;
+    return create(load_from_path(path, cache), out);
+  } catch (const std::bad_alloc &) {
+    return EMUGB_ERROR_OUT_OF_MEMORY;
+  }
+}
+
+emugb_status emugb_create_from_memory(const uint8_t *rom, size_t size,
+                                      emugb **out) {
+  if ((rom == nullptr && size != 0) || out == nullptr) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  *out = nullptr;
+  try {
+    return create(load_from_memory(std::vector<uint8_t>(rom, rom + size)),
+                  out);
+  } catch (const std::bad_alloc &) {
+    return EMUGB_ERROR_OUT_OF_MEMORY;
+  }
+}
+
+void emugb_destroy(emugb *gb) { delete gb; }
+
+void emugb_set_rom_cache_capacity(size_t bytes) {
+  rom_cache.set_capacity(bytes);
+  rom_cache_enabled.store(bytes != 0, std::memory_order_relaxed);
+}
+
+emugb_status emugb_run_frames(emugb *gb, uint32_t frames) {
+  if (gb == nullptr) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  for (uint32_t i = 0; i < frames; ++i) {
+    if (!gb->gameboy.run_frame()) {
+      return EMUGB_BREAKPOINT;
+    }
+  }
+  return EMUGB_OK;
+}
+
+emugb_status emugb_run_cycles(emugb *gb, uint64_t cycles) {
+  if (gb == nullptr) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  return gb->gameboy.run_cycles(cycles) ? EMUGB_OK : EMUGB_BREAKPOINT;
+}
+
+emugb_status emugb_set_input(emugb *gb, uint8_t buttons) {
+  if (gb == nullptr) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  gb->gameboy.set_buttons(buttons);
+  return EMUGB_OK;
+}
+
+emugb_status emugb_set_fast_forward(emugb *gb, int enabled,
+                                    uint32_t display_interval) {
+  if (gb == nullptr) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  gb->gameboy.set_fast_forward(
+      {.enabled = enabled != 0, .display_interval = display_interval});
+  return EMUGB_OK;
+}
+
+emugb_status emugb_set_run_ahead(emugb *gb, uint32_t frames) {
+  if (gb == nullptr) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  gb->gameboy.set_run_ahead(frames);
+  return EMUGB_OK;
+}
+
+uint64_t emugb_cycles(const emugb *gb) {
+  return gb->gameboy.mmu.get_state().cycles;
+}
+
+uint64_t emugb_state_hash(const emugb *gb) {
+  return gb->gameboy.hash_state();
+}
+
+size_t emugb_snapshot_size(void) {
+  return sizeof(SnapshotHeader) + sizeof(MachineState);
+}
+
+emugb_status emugb_snapshot_save(const emugb *gb, void *buffer, size_t size) {
+  if (gb == nullptr || buffer == nullptr || size < emugb_snapshot_size()) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  SnapshotHeader header;
+  std::memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+  header.state_size = sizeof(MachineState);
+
+  auto *bytes = static_cast<uint8_t *>(buffer);
+  std::memcpy(bytes, &header, sizeof(header));
+  std::memcpy(bytes + sizeof(header), &gb->gameboy.mmu.get_state(),
+              sizeof(MachineState));
+  return EMUGB_OK;
+}
+
+emugb_status emugb_snapshot_restore(emugb *gb, const void *buffer,
+                                    size_t size) {
+  if (gb == nullptr || buffer == nullptr) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  if (size < emugb_snapshot_size()) {
+    return EMUGB_ERROR_INVALID_SNAPSHOT;
+  }
+  const auto *bytes = static_cast<const uint8_t *>(buffer);
+  SnapshotHeader header;
+  std::memcpy(&header, bytes, sizeof(header));
+  if (std::memcmp(header.magic, snapshot_magic, sizeof(header.magic)) != 0 ||
+      header.state_size != sizeof(MachineState)) {
+    return EMUGB_ERROR_INVALID_SNAPSHOT;
+  }
+  gb->gameboy.mmu.load_state(bytes + sizeof(header));
+  return EMUGB_OK;
+}
+
+const uint8_t *emugb_framebuffer(const emugb *gb) {
+  return gb->gameboy.ppu.get_framebuffer().data();
+}
+
+uint64_t emugb_frame_hash(const emugb *gb) {
+  return gb->gameboy.ppu.get_frame_hash();
+}
+
+uint32_t emugb_changed_lines(const emugb *gb, uint8_t *lines) {
+  const std::bitset<PPU::height> &changed = gb->gameboy.get_changed_lines();
+  if (lines != nullptr) {
+    for (size_t y = 0; y < PPU::height; ++y) {
+      lines[y] = changed[y] ? 1 : 0;
+    }
+  }
+  return static_cast<uint32_t>(changed.count());
+}
+
+const int16_t *emugb_audio_samples(const emugb *, size_t *count) {
+  if (count != nullptr) {
+    *count = 0;
+  }
+  return nullptr;
+}
+
+uint8_t *emugb_memory(emugb *gb, emugb_memory_region region, size_t *size) {
+  MachineState &state = gb->gameboy.mmu.get_state();
+  uint8_t *data = nullptr;
+  size_t length = 0;
+  switch (region) {
+  case EMUGB_MEMORY_WRAM:
+    data = state.wram.data();
+    length = state.wram.size();
+    break;
+  case EMUGB_MEMORY_VRAM:
+    data = state.vram.data();
+    length = state.vram.size();
+    break;
+  case EMUGB_MEMORY_OAM:
+    data = state.oam.data();
+    length = state.oam.size();
+    break;
+  case EMUGB_MEMORY_IO:
+    data = state.io.data();
+    length = state.io.size();
+    break;
+  case EMUGB_MEMORY_HRAM:
+    data = state.hram.data();
+    length = state.hram.size();
+    break;
+  }
+  if (size != nullptr) {
+    *size = length;
+  }
+  return data;
+}
+
+const uint8_t *emugb_rom(const emugb *gb, size_t *size) {
+  const std::vector<uint8_t> &rom = gb->gameboy.mmu.get_cartridge().get_rom();
+  if (size != nullptr) {
+    *size = rom.size();
+  }
+  return rom.data();
+}
+
+emugb_status emugb_add_breakpoint(emugb *gb, int access, uint16_t addr) {
+  constexpr int all = EMUGB_ACCESS_READ | EMUGB_ACCESS_WRITE |
+                      EMUGB_ACCESS_EXECUTE;
+  if (gb == nullptr || (access & ~all) != 0) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  try {
+    gb->gameboy.mmu.add_trap(static_cast<Access>(access), addr);
+  } catch (const std::bad_alloc &) {
+    return EMUGB_ERROR_OUT_OF_MEMORY;
+  }
+  return EMUGB_OK;
+}
+
+emugb_status emugb_remove_breakpoint(emugb *gb, int access, uint16_t addr) {
+  if (gb == nullptr) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  gb->gameboy.mmu.remove_trap(static_cast<Access>(access), addr);
+  return EMUGB_OK;
+}
+
+emugb_status emugb_clear_breakpoints(emugb *gb) {
+  if (gb == nullptr) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  gb->gameboy.mmu.clear_traps();
+  return EMUGB_OK;
+}
+
+int emugb_take_breakpoint_hit(emugb *gb, emugb_breakpoint_hit *hit) {
+  const std::optional<TrapHit> trap_hit = gb->gameboy.mmu.take_trap_hit();
+  if (!trap_hit) {
+    return 0;
+  }
+  if (hit != nullptr) {
+    hit->access = static_cast<emugb_access>(trap_hit->access);
+    hit->addr = trap_hit->addr;
+    hit->value = trap_hit->value;
+  }
+  return 1;
+}
+
+emugb_status emugb_add_cheat(emugb *gb, const char *code) {
+  if (gb == nullptr || code == nullptr) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  try {
+    if (!gb->cheats.add(code)) {
+      return EMUGB_ERROR_INVALID_ARGUMENT;
+    }
+    gb->gameboy.set_cheats(gb->cheats);
+  } catch (const std::bad_alloc &) {
+    return EMUGB_ERROR_OUT_OF_MEMORY;
+  }
+  return EMUGB_OK;
+}
+
+emugb_status emugb_clear_cheats(emugb *gb) {
+  if (gb == nullptr) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  gb->cheats = {};
+  gb->gameboy.set_cheats(gb->cheats);
+  return EMUGB_OK;
+}
+
+emugb_status emugb_batch_create(const uint8_t *rom, size_t size,
+                                size_t instance_count, size_t thread_count,
+                                int screen, const uint16_t *ram_addresses,
+                                size_t ram_address_count, emugb_batch **out) {
+  if ((rom == nullptr && size != 0) ||
+      (ram_addresses == nullptr && ram_address_count != 0) || out == nullptr) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  *out = nullptr;
+  try {
+    LoadResult cartridge =
+        load_from_memory(std::vector<uint8_t>(rom, rom + size));
+    if (!cartridge) {
+      return to_status(cartridge.error());
+    }
+    ObservationSpec spec{
+        .screen = screen != 0,
+        .ram_addresses = std::vector<uint16_t>(
+            ram_addresses, ram_addresses + ram_address_count),
+    };
+    *out = new emugb_batch{VecEnv((*cartridge)->get_rom(), instance_count,
+                                  std::move(spec),
+                                  std::min(thread_count, instance_count))};
+    return EMUGB_OK;
+  } catch (const std::bad_alloc &) {
+    return EMUGB_ERROR_OUT_OF_MEMORY;
+  } catch (const std::length_error &) {
+    return EMUGB_ERROR_OUT_OF_MEMORY;
+  } catch (const std::system_error &) {
+    return EMUGB_ERROR_THREAD_FAILED;
+  }
+}
+
+void emugb_batch_destroy(emugb_batch *batch) { delete batch; }
+
+size_t emugb_batch_observation_size(const emugb_batch *batch) {
+  return batch->env.get_observation_size();
+}
+
+emugb_status emugb_batch_step(emugb_batch *batch, const uint8_t *actions,
+                              uint32_t frames, uint8_t *observations,
+                              size_t size) {
+  if (batch == nullptr || actions == nullptr || observations == nullptr ||
+      size < batch->env.get_instance_count() *
+                 batch->env.get_observation_size()) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  batch->env.step(actions, frames, observations);
+  return EMUGB_OK;
+}
+
+emugb_status emugb_batch_reset(emugb_batch *batch, size_t instance) {
+  if (batch == nullptr || instance >= batch->env.get_instance_count()) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  batch->env.reset(instance);
+  return EMUGB_OK;
+}
+
+emugb_status emugb_batch_set_start_state(emugb_batch *batch,
+                                         size_t instance) {
+  if (batch == nullptr || instance >= batch->env.get_instance_count()) {
+    return EMUGB_ERROR_INVALID_ARGUMENT;
+  }
+  batch->env.set_start_state(instance);
+  return EMUGB_OK;
+}
+
+} // extern "C"
@@ -0,0 +1,626 @@
+#include "cartridge.hpp"
+#include "control_flow.hpp"
+#include "disassembler.hpp"
+#include "opcodes.hpp"
+#include "thread_pool.hpp"
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+// Turns the code that ControlFlowGraph finds in a ROM into C++ (see aot.hpp
+// for how GameBoy runs it).
+//
+// Every translated instruction does exactly what its case in
+// CPU::execute() does, in the same order, through the same RegFile, MMU and
+// CPU::alu_* calls; only decoding and immediate reads are done here instead
+// of at run time. Opcodes the interpreter does not implement, and HALT and
+// STOP, are left to CPU::execute().
+
+static void print_usage(const char *program) {
+  std::println(stderr, "Usage: {} <rom_path> <output_cpp> [--threads <count>]",
+               program);
+}
+
+namespace {
+
+std::string block_name(CodeAddress addr) {
+  return std::format("block_{}_{:04X}", addr.bank, addr.addr);
+}
+
+std::string_view register_name(Operand operand) {
+  switch (operand) {
+  case Operand::B:
+    return "r.b";
+  case Operand::C:
+    return "r.c";
+  case Operand::D:
+    return "r.d";
+  case Operand::E:
+    return "r.e";
+  case Operand::H:
+    return "r.h";
+  case Operand::L:
+    return "r.l";
+  default:
+    return "r.a";
+  }
+}
+
+std::string_view pair_suffix(Operand operand) {
+  switch (operand) {
+  case Operand::BC:
+    return "bc";
+  case Operand::DE:
+    return "de";
+  case Operand::HL:
+    return "hl";
+  default:
+    return "af";
+  }
+}
+
+std::string_view condition_code(Operand operand) {
+  switch (operand) {
+  case Operand::CondNz:
+    return "!r.get_flag(Flag::Z)";
+  case Operand::CondZ:
+    return "r.get_flag(Flag::Z)";
+  case Operand::CondNc:
+    return "!r.get_flag(Flag::C)";
+  default:
+    return "r.get_flag(Flag::C)";
+  }
+}
+
+// The value of an 8-bit register, (HL) or immediate operand.
+std::string read_operand(Operand operand, const InstructionBytes &bytes) {
+  if (operand == Operand::HlIndirect) {
+    return "m.get_byte(r.get_hl())";
+  }
+  if (operand == Operand::Imm8) {
+    return std::format("0x{:02X}", bytes[1]);
+  }
+  return std::string(register_name(operand));
+}
+
+// Opcodes with a case in CPU::execute() that is translated here.
+bool is_translated(uint8_t opcode) {
+  switch (opcode) {
+  case 0x10: // STOP
+  case 0x76: // HALT
+  case 0xCE: // ADC A, n
+  case 0xDE: // SBC A, n
+  case 0xEE: // XOR A, n
+  case 0xFE: // CP A, n
+    return false;
+  default:
+    break;
+  }
+  const OpcodeInfo &info = get_opcode_info(opcode);
+  const std::string_view mnemonic = info.mnemonic;
+  if (opcode < 0x40) {
+    // Everything in the first quarter but the accumulator rotates and flag
+    // operations (x7/xF).
+    return (opcode & 0x07) != 0x07;
+  }
+  if (opcode < 0xC0) {
+    return true;
+  }
+  return mnemonic == "RET" || mnemonic == "RETI" || mnemonic == "POP" ||
+         mnemonic == "PUSH" || mnemonic == "JP" || mnemonic == "CALL" ||
+         mnemonic == "RST" || mnemonic == "DI" || mnemonic == "EI" ||
+         mnemonic == "LDH" ||
+         (mnemonic == "LD" && info.operands[0] != Operand::SP &&
+          info.operands[0] != Operand::HL) ||
+         (mnemonic == "ADD" && info.operands[0] == Operand::A) ||
+         mnemonic == "SUB" || mnemonic == "AND" || mnemonic == "OR";
+}
+
+// Whether the instruction may write to 0x0000-0x7FFF, i.e. switch banks.
+bool may_write_rom(const OpcodeInfo &info, const InstructionBytes &bytes) {
+  const std::string_view mnemonic = info.mnemonic;
+  if (mnemonic == "PUSH" || mnemonic == "CALL" || mnemonic == "RST") {
+    return true;
+  }
+  switch (info.operands[0]) {
+  // LD (HL), r/n and INC/DEC (HL); no other translated opcode has it first.
+  case Operand::HlIndirect:
+  case Operand::BcIndirect:
+  case Operand::DeIndirect:
+  case Operand::HlIncrement:
+  case Operand::HlDecrement:
+    return true;
+  case Operand::Address16:
+    return (bytes[1] | bytes[2] << 8) < 0x8000;
+  default:
+    return false;
+  }
+}
+
+// Whether the instruction may do more than use up cycles to end the run: a
+// write may reschedule events or raise interrupts, and DI, EI and RETI
+// change IME.
+bool may_stop_run(const OpcodeInfo &info, const InstructionBytes &bytes) {
+  const std::string_view mnemonic = info.mnemonic;
+  if (mnemonic == "PUSH" || mnemonic == "CALL" || mnemonic == "RST" ||
+      mnemonic == "DI" || mnemonic == "EI" || mnemonic == "RETI") {
+    return true;
+  }
+  const uint16_t word = static_cast<uint16_t>(bytes[1] | bytes[2] << 8);
+  switch (info.operands[0]) {
+  case Operand::HlIndirect:
+  case Operand::BcIndirect:
+  case Operand::DeIndirect:
+  case Operand::HlIncrement:
+  case Operand::HlDecrement:
+  case Operand::HighC:
+    return true;
+  case Operand::Address16:
+    // VRAM and WRAM hold no registers; LD (a16), SP writes two bytes.
+    return word < 0x8000 || word >= 0xFDFF;
+  case Operand::HighAddress8:
+    // HRAM, but not IE.
+    return bytes[1] < 0x80 || bytes[1] == 0xFF;
+  default:
+    return false;
+  }
+}
+
+struct Instruction {
+  uint16_t addr;
+  InstructionBytes bytes;
+  const OpcodeInfo *info;
+};
+
+class Generator {
+public:
+  Generator(const std::vector<uint8_t> &rom, const ControlFlowGraph &graph)
+      : rom(rom), graph(graph) {}
+
+  std::string generate(std::string_view rom_name);
+
+private:
+  const std::vector<uint8_t> &rom;
+  const ControlFlowGraph &graph;
+  std::string out;
+  // Every address a block function can be entered at, with its block.
+  std::vector<std::pair<CodeAddress, CodeAddress>> entries;
+
+  template <typename... Args>
+  void line(std::format_string<Args...> fmt, Args &&...args) {
+    std::format_to(std::back_inserter(out), fmt, std::forward<Args>(args)...);
+    out += '\n';
+  }
+
+  InstructionBytes read(CodeAddress addr) const;
+  // The block reached at `target` from code in `bank`, if it is certain
+  // when generating.
+  std::optional<CodeAddress> chain_target(uint16_t bank,
+                                          uint16_t target) const;
+  void emit_block(const BasicBlock &block);
+  bool emit_instruction(const BasicBlock &block, const Instruction &insn,
+                        bool last);
+  void emit_body(const Instruction &insn);
+  void emit_chain(std::string_view indent, const std::string &condition,
+                  std::optional<CodeAddress> target);
+};
+
+InstructionBytes Generator::read(CodeAddress addr) const {
+  InstructionBytes bytes{};
+  const size_t offset = addr.get_rom_offset();
+  for (size_t i = 0; i < bytes.size() && offset + i < rom.size(); ++i) {
+    bytes[i] = rom[offset + i];
+  }
+  return bytes;
+}
+
+std::optional<CodeAddress> Generator::chain_target(uint16_t bank,
+                                                   uint16_t target) const {
+  CodeAddress addr{0, target};
+  if (target >= 0x4000) {
+    // From bank 0 the bank is not known; other banks stay put, since
+    // blocks return when their bank is switched away.
+    if (target >= 0x8000 || bank == 0) {
+      return std::nullopt;
+    }
+    addr.bank = bank;
+  }
+  if (graph.find_block(addr) == nullptr) {
+    return std::nullopt;
+  }
+  return addr;
+}
+
+std::string Generator::generate(std::string_view rom_name) {
+  line("// Generated by emugb-aot from {}. Do not edit.", rom_name);
+  line("");
+  line("#include \"aot.hpp\"");
+  line("#include \"cpu.hpp\"");
+  line("#include \"machine_state.hpp\"");
+  line("#include \"mmu.hpp\"");
+  line("#include \"register.hpp\"");
+  line("#include <algorithm>");
+  line("#include <cstdint>");
+  line("");
+  line("namespace {{");
+  line("");
+  for (const BasicBlock &block : graph.get_blocks()) {
+    line("AotNext {}(CPU &cpu, MachineState &state, uint64_t end);",
+         block_name(block.start));
+  }
+  for (const BasicBlock &block : graph.get_blocks()) {
+    line("");
+    emit_block(block);
+  }
+  line("");
+  line("constexpr AotBlock blocks[] = {{");
+  for (const auto &[entry, block] : entries) {
+    line("    {{{}, 0x{:04X}, {}}},", entry.bank, entry.addr,
+         block_name(block));
+  }
+  line("}};");
+  line("");
+  line("}} // namespace");
+  line("");
+  line("const AotProgram aot_program = {{0x{:016x}, blocks, {}}};",
+       graph.get_rom_hash(), entries.size());
+  return std::move(out);
+}
+
+void Generator::emit_block(const BasicBlock &block) {
+  line("AotNext {}(CPU &cpu, MachineState &state, uint64_t end) {{",
+       block_name(block.start));
+  line("  [[maybe_unused]] RegFile &r = cpu.regFile;");
+  line("  [[maybe_unused]] MMU &m = cpu.memory;");
+  line("  [[maybe_unused]] uint64_t limit = std::min(end, state.scheduler.next);");
+  // The block ends early at an instruction handed to the interpreter.
+  std::vector<Instruction> instructions;
+  uint16_t addr = block.start.addr;
+  for (uint16_t i = 0; i < block.instruction_count; ++i) {
+    const InstructionBytes bytes = read({block.start.bank, addr});
+    instructions.push_back({addr, bytes, &decode(bytes)});
+    if (!is_translated(bytes[0])) {
+      break;
+    }
+    addr = static_cast<uint16_t>(addr + instructions.back().info->length);
+  }
+
+  // Blocks are also entered at the instruction where an earlier run of them
+  // stopped.
+  if (instructions.size() > 1) {
+    line("  switch (r.pc) {{");
+    for (size_t i = 1; i < instructions.size(); ++i) {
+      line("  case 0x{:04X}:", instructions[i].addr);
+      line("    goto at_{:04X};", instructions[i].addr);
+    }
+    line("  }}");
+  }
+  for (size_t i = 0; i < instructions.size(); ++i) {
+    const Instruction &insn = instructions[i];
+    entries.emplace_back(CodeAddress{block.start.bank, insn.addr},
+                         block.start);
+    if (i != 0) {
+      line("at_{:04X}:", insn.addr);
+    }
+    if (!emit_instruction(block, insn, i + 1 == block.instruction_count)) {
+      break;
+    }
+  }
+  line("}}");
+}
+
+// Returns false if the block ends with this instruction.
+bool Generator::emit_instruction(const BasicBlock &block,
+                                 const Instruction &insn, bool last) {
+  const OpcodeInfo &info = *insn.info;
+  line("  // {:04X}: {}", insn.addr, disassemble(insn.addr, insn.bytes));
+  if (!is_translated(insn.bytes[0])) {
+    line("  r.pc = 0x{:04X};", insn.addr);
+    line("  cpu.execute();");
+    line("  return {{}};");
+    return false;
+  }
+
+  // Most instructions can only end the run by using up cycles; the others
+  // need the full check, and in a switchable bank also the bank compared.
+  const uint16_t next = static_cast<uint16_t>(insn.addr + info.length);
+  const bool full_check = may_stop_run(info, insn.bytes);
+  std::string condition = "state.cycles < limit";
+  if (full_check) {
+    condition = "aot_can_continue(state, end)";
+    if (block.start.bank != 0 && may_write_rom(info, insn.bytes)) {
+      condition += std::format(" &&\n      m.get_cartridge().get_rom_bank() == {}",
+                               block.start.bank);
+    }
+  }
+  line("  state.cycles += {};", info.cycles);
+  line("  cpu.instruction_count += 1;");
+
+  const Operand first = info.operands[0];
+  const bool conditional = first >= Operand::CondNz && first <= Operand::CondC;
+  const std::string_view mnemonic = info.mnemonic;
+  const bool branch = mnemonic == "JP" || mnemonic == "JR" ||
+                      mnemonic == "CALL" || mnemonic == "RET" ||
+                      mnemonic == "RETI" || mnemonic == "RST";
+  if (!branch) {
+    emit_body(insn);
+    if (last) {
+      line("  r.pc = 0x{:04X};", next);
+      emit_chain("  ", condition, chain_target(block.start.bank, next));
+      return false;
+    }
+    line("  if (!({})) {{", condition);
+    line("    r.pc = 0x{:04X};", next);
+    line("    return {{}};");
+    line("  }}");
+    if (full_check) {
+      line("  limit = std::min(end, state.scheduler.next);");
+    }
+    return true;
+  }
+
+  // Branches end the block.
+  const uint16_t word =
+      static_cast<uint16_t>(insn.bytes[1] | insn.bytes[2] << 8);
+  std::vector<std::string> action;
+  std::optional<uint16_t> target;
+  if (mnemonic == "JP" && info.operands[0] == Operand::HL) {
+    action = {"r.pc = r.get_hl();"};
+  } else if (mnemonic == "JP") {
+    target = word;
+    action = {std::format("r.pc = 0x{:04X};", word)};
+  } else if (mnemonic == "JR") {
+    target = static_cast<uint16_t>(next + static_cast<int8_t>(insn.bytes[1]));
+    action = {std::format("r.pc = 0x{:04X};", *target)};
+  } else if (mnemonic == "CALL" || mnemonic == "RST") {
+    // The return address is pushed from PC.
+    target = mnemonic == "CALL" ? word : info.value;
+    action = {std::format("r.pc = 0x{:04X};", next),
+              std::format("cpu.alu_call(0x{:04X});", *target)};
+  } else if (mnemonic == "RETI") {
+    action = {"cpu.alu_ret();", "state.ime = true;"};
+  } else {
+    action = {"cpu.alu_ret();"};
+  }
+  const std::optional<CodeAddress> taken =
+      target ? chain_target(block.start.bank, *target) : std::nullopt;
+
+  if (!conditional) {
+    for (const std::string &statement : action) {
+      line("  {}", statement);
+    }
+    emit_chain("  ", condition, taken);
+    return false;
+  }
+  line("  if ({}) {{", condition_code(first));
+  for (const std::string &statement : action) {
+    line("    {}", statement);
+  }
+  line("    state.cycles += {};", info.branch_cycles - info.cycles);
+  emit_chain("    ", condition, taken);
+  line("  }}");
+  line("  r.pc = 0x{:04X};", next);
+  emit_chain("  ", condition, chain_target(block.start.bank, next));
+  return false;
+}
+
+void Generator::emit_chain(std::string_view indent,
+                           const std::string &condition,
+                           std::optional<CodeAddress> target) {
+  if (!target) {
+    line("{}return {{}};", indent);
+    return;
+  }
+  line("{}return {} ? AotNext{{{}}} : AotNext{{}};", indent, condition,
+       block_name(*target));
+}
+
+// The instruction's effect, as in CPU::execute().
+void Generator::emit_body(const Instruction &insn) {
+  const OpcodeInfo &info = *insn.info;
+  const std::string_view mnemonic = info.mnemonic;
+  const Operand first = info.operands[0];
+  const Operand second = info.operands[1];
+  const InstructionBytes &bytes = insn.bytes;
+  const uint16_t word = static_cast<uint16_t>(bytes[1] | bytes[2] << 8);
+
+  if (mnemonic == "NOP") {
+    return;
+  }
+  if (mnemonic == "DI") {
+    line("  state.ime = false;");
+    line("  state.ime_pending = false;");
+    return;
+  }
+  if (mnemonic == "EI") {
+    line("  state.ime_pending = true;");
+    return;
+  }
+  if (mnemonic == "PUSH") {
+    line("  cpu.alu_push(r.get_{}());", pair_suffix(first));
+    return;
+  }
+  if (mnemonic == "POP") {
+    if (first == Operand::AF) {
+      // The low nibble of F always reads as zero.
+      line("  r.set_af(cpu.alu_pop() & 0xFFF0);");
+    } else {
+      line("  r.set_{}(cpu.alu_pop());", pair_suffix(first));
+    }
+    return;
+  }
+  if (mnemonic == "INC" || mnemonic == "DEC") {
+    const char sign = mnemonic == "INC" ? '+' : '-';
+    if (first == Operand::SP) {
+      line("  r.sp {}= 1;", sign);
+    } else if (first >= Operand::BC && first <= Operand::HL) {
+      line("  r.set_{0}(r.get_{0}() {1} 1);", pair_suffix(first), sign);
+    } else if (first == Operand::HlIndirect) {
+      line("  {{");
+      line("    const uint16_t addr = r.get_hl();");
+      line("    m.set_byte(addr, cpu.alu_{}(m.get_byte(addr)));",
+           mnemonic == "INC" ? "inc" : "dec");
+      line("  }}");
+    } else {
+      line("  {0} = cpu.alu_{1}({0});", register_name(first),
+           mnemonic == "INC" ? "inc" : "dec");
+    }
+    return;
+  }
+  if (mnemonic == "ADD" && first == Operand::HL) {
+    line("  cpu.alu_add_hl({});", second == Operand::SP
+                                     ? std::string("r.sp")
+                                     : std::format("r.get_{}()",
+                                                   pair_suffix(second)));
+    return;
+  }
+  if (first == Operand::A &&
+      (mnemonic == "ADD" || mnemonic == "ADC" || mnemonic == "SUB" ||
+       mnemonic == "SBC" || mnemonic == "AND" || mnemonic == "XOR" ||
+       mnemonic == "OR" || mnemonic == "CP")) {
+    std::string name(mnemonic);
+    for (char &c : name) {
+      c = static_cast<char>(c - 'A' + 'a');
+    }
+    const std::string value = read_operand(second, bytes);
+    if (mnemonic == "CP") {
+      line("  cpu.alu_cp({});", value);
+    } else {
+      line("  r.a = cpu.alu_{}({});", name, value);
+    }
+    return;
+  }
+  if (mnemonic == "LDH") {
+    const std::string addr =
+        first == Operand::HighC || second == Operand::HighC
+            ? std::string("0xFF00 + r.c")
+            : std::format("0xFF{:02X}", bytes[1]);
+    if (first == Operand::A) {
+      line("  r.a = m.get_byte({});", addr);
+    } else {
+      line("  m.set_byte({}, r.a);", addr);
+    }
+    return;
+  }
+
+  // LD in all its forms.
+  switch (first) {
+  case Operand::BC:
+  case Operand::DE:
+  case Operand::HL:
+    line("  r.set_{}(0x{:04X});", pair_suffix(first), word);
+    return;
+  case Operand::SP:
+    line("  r.sp = 0x{:04X};", word);
+    return;
+  case Operand::Address16:
+    if (second == Operand::SP) {
+      line("  m.set_word(0x{:04X}, r.sp);", word);
+    } else {
+      line("  m.set_byte(0x{:04X}, r.a);", word);
+    }
+    return;
+  case Operand::BcIndirect:
+  case Operand::DeIndirect:
+    line("  m.set_byte(r.get_{}(), r.a);",
+         first == Operand::BcIndirect ? "bc" : "de");
+    return;
+  case Operand::HlIncrement:
+  case Operand::HlDecrement:
+    line("  {{");
+    line("    const uint16_t addr = r.get_hl();");
+    line("    m.set_byte(addr, r.a);");
+    line("    r.set_hl(addr {} 1);", first == Operand::HlIncrement ? '+' : '-');
+    line("  }}");
+    return;
+  case Operand::HlIndirect:
+    line("  m.set_byte(r.get_hl(), {});", read_operand(second, bytes));
+    return;
+  default:
+    break;
+  }
+  // LD r, ...
+  switch (second) {
+  case Operand::Address16:
+    line("  r.a = m.get_byte(0x{:04X});", word);
+    return;
+  case Operand::BcIndirect:
+  case Operand::DeIndirect:
+    line("  r.a = m.get_byte(r.get_{}());",
+         second == Operand::BcIndirect ? "bc" : "de");
+    return;
+  case Operand::HlIncrement:
+  case Operand::HlDecrement:
+    line("  {{");
+    line("    const uint16_t addr = r.get_hl();");
+    line("    r.a = m.get_byte(addr);");
+    line("    r.set_hl(addr {} 1);", second == Operand::HlIncrement ? '+' : '-');
+    line("  }}");
+    return;
+  default:
+    line("  {} = {};", register_name(first), read_operand(second, bytes));
+    return;
+  }
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  size_t threads = 0;
+  for (int i = 3; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      const std::string_view count = argv[++i];
+      const std::from_chars_result result =
+          std::from_chars(count.data(), count.data() + count.size(), threads);
+      if (result.ec != std::errc{} ||
+          result.ptr != count.data() + count.size()) {
+        print_usage(argv[0]);
+        return 1;
+      }
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
+  const std::string rom_path = argv[1];
+  const std::string output_path = argv[2];
+  LoadResult loaded = load_from_path(rom_path);
+  if (!loaded) {
+    std::println(stderr, "Error: {}: {}", to_string(loaded.error()), rom_path);
+    return 1;
+  }
+  const std::vector<uint8_t> &rom = (*loaded)->get_rom();
+
+  ThreadPool pool(threads);
+  const ControlFlowGraph graph = ControlFlowGraph::load_or_analyze(
+      rom, get_cfg_cache_path(rom_path), pool);
+  const std::string code = Generator(rom, graph).generate(
+      std::filesystem::path(rom_path).filename().string());
+
+  std::ofstream file(output_path, std::ios::binary);
+  file << code;
+  if (!file) {
+    std::println(stderr, "Error: Could not write file {}", output_path);
+    return 1;
+  }
+  std::println("{}: {} blocks, {} instructions", output_path,
+               graph.get_blocks().size(), graph.get_instruction_count());
+  return 0;
+}
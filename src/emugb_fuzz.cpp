@@ -0,0 +1,139 @@
+#include "cartridge.hpp"
+#include "fuzz_harness.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <print>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Fuzz target for FuzzHarness. Built against libFuzzer (EMUGB_LIBFUZZER=ON)
+// it is a regular libFuzzer binary; otherwise main() below replays input
+// files or benchmarks random inputs. libFuzzer owns the command line, so the
+// harness is configured through the environment:
+//
+//   EMUGB_FUZZ_ROM          ROM to run (default: an idle loop, which suits
+//                           instruction streams)
+//   EMUGB_FUZZ_BOOT_FRAMES  frames to run before taking the snapshot
+//   EMUGB_FUZZ_DETERMINISM  1 to run every input twice and compare
+
+namespace {
+
+std::unique_ptr<FuzzHarness> harness;
+
+std::unique_ptr<FuzzHarness> make_harness() {
+  FuzzOptions options;
+  if (const char *frames = std::getenv("EMUGB_FUZZ_BOOT_FRAMES")) {
+    options.boot_frames =
+        static_cast<uint32_t>(std::strtoul(frames, nullptr, 10));
+  }
+  if (const char *check = std::getenv("EMUGB_FUZZ_DETERMINISM")) {
+    options.check_determinism = std::string_view(check) == "1";
+  }
+
+  std::unique_ptr<Cartridge> cartridge;
+  if (const char *rom_path = std::getenv("EMUGB_FUZZ_ROM")) {
+    LoadResult loaded = load_from_path(rom_path);
+    if (!loaded) {
+      std::println(stderr, "Error: {}: {}", to_string(loaded.error()),
+                   rom_path);
+      std::exit(1);
+    }
+    cartridge = std::move(*loaded);
+  } else {
+    cartridge = make_idle_cartridge();
+  }
+  return std::make_unique<FuzzHarness>(std::move(cartridge), options);
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerInitialize(int *, char ***) {
+  harness = make_harness();
+  return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (std::optional<std::string> violation = harness->run(data, size)) {
+    std::println(stderr, "Invariant violated: {}", *violation);
+    std::abort();
+  }
+  return 0;
+}
+
+#ifndef EMUGB_LIBFUZZER
+
+namespace {
+
+void print_usage(const char *program) {
+  std::println(stderr, "Usage: {} <input_path>...", program);
+  std::println(stderr, "       {} --bench <count> [--max-len <bytes>]",
+               program);
+}
+
+// Runs `count` random inputs of up to `max_len` bytes, half of them joypad
+// inputs and half instruction streams.
+void run_bench(uint64_t count, size_t max_len) {
+  std::mt19937_64 random(0);
+  std::vector<uint8_t> input(max_len);
+  const auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < count; ++i) {
+    const size_t size = 1 + random() % max_len;
+    for (size_t j = 0; j < size; ++j) {
+      input[j] = static_cast<uint8_t>(random());
+    }
+    LLVMFuzzerTestOneInput(input.data(), size);
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  std::println("{} inputs in {:.3f} s ({:.0f} exec/s)", count, elapsed.count(),
+               static_cast<double>(count) / elapsed.count());
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  LLVMFuzzerInitialize(&argc, &argv);
+
+  if (std::string_view(argv[1]) == "--bench") {
+    if (argc != 3 && !(argc == 5 && std::string_view(argv[3]) == "--max-len")) {
+      print_usage(argv[0]);
+      return 1;
+    }
+    const uint64_t count = std::strtoull(argv[2], nullptr, 10);
+    const size_t max_len = argc == 5 ? std::strtoul(argv[4], nullptr, 10) : 64;
+    if (max_len == 0) {
+      print_usage(argv[0]);
+      return 1;
+    }
+    run_bench(count, max_len);
+    return 0;
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream file(argv[i], std::ios::binary);
+    if (!file) {
+      std::println(stderr, "Error: cannot open {}", argv[i]);
+      return 1;
+    }
+    const std::vector<uint8_t> input{std::istreambuf_iterator<char>(file),
+                                     std::istreambuf_iterator<char>()};
+    std::println("{}: {} bytes", argv[i], input.size());
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+  return 0;
+}
+
+#endif // EMUGB_LIBFUZZER
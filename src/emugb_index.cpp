@@ -0,0 +1,130 @@
+#include "rom_catalog.hpp"
+#include "rom_header.hpp"
+#include "thread_pool.hpp"
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+static void print_usage(const char *program) {
+  std::println(stderr,
+               "Usage: {} <catalog> scan <directory>... [--threads <count>]\n"
+               "       {} <catalog> list\n"
+               "       {} <catalog> find <title>\n"
+               "       {} <catalog> hash <hex_hash>",
+               program, program, program, program);
+}
+
+// Parses all of `text` as a number in `base`; false if it is not one or
+// does not fit.
+static bool parse_number(std::string_view text, uint64_t &value,
+                         int base = 10) {
+  const std::from_chars_result result =
+      std::from_chars(text.data(), text.data() + text.size(), value, base);
+  return result.ec == std::errc{} && result.ptr == text.data() + text.size();
+}
+
+static void print_entry(const CatalogEntry &entry) {
+  const RomHeader &header = entry.header;
+  std::println("{:016x}  {:<16}  {:<3}  {:<22}  {:>5} KiB  {:>3} KiB  {}{}  {}",
+               entry.hash, header.title,
+               header.cgb_flag == 0xC0 ? "CGB"
+               : header.is_cgb()       ? "C+D"
+                                       : "DMG",
+               cartridge_type_name(header.cartridge_type),
+               header.rom_size / 1024, header.ram_size / 1024,
+               header.header_checksum_ok ? 'h' : '-',
+               header.global_checksum_ok ? 'g' : '-', entry.path);
+}
+
+static int run_scan(RomCatalog &catalog, const std::string &catalog_path,
+                    const std::vector<std::filesystem::path> &roots,
+                    size_t threads) {
+  ThreadPool pool(threads);
+  const auto start = std::chrono::steady_clock::now();
+  const RomCatalog::ScanStats stats = catalog.scan(roots, pool);
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::println("files: {}, hashed: {}, failed: {}, removed: {}", stats.files,
+               stats.hashed, stats.failed, stats.removed);
+  std::println("catalog: {} ROMs, scanned in {:.3f} s on {} threads",
+               catalog.get_entries().size(), elapsed.count(),
+               pool.get_thread_count());
+  return catalog.save(catalog_path) ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  const std::string catalog_path = argv[1];
+  const std::string_view command = argv[2];
+  std::optional<RomCatalog> catalog = RomCatalog::load(catalog_path);
+  if (!catalog) {
+    return 1;
+  }
+
+  if (command == "scan") {
+    std::vector<std::filesystem::path> roots;
+    uint64_t threads = 0;
+    for (int i = 3; i < argc; ++i) {
+      const std::string_view arg = argv[i];
+      if (arg == "--threads" && i + 1 < argc) {
+        if (!parse_number(argv[++i], threads)) {
+          print_usage(argv[0]);
+          return 1;
+        }
+      } else {
+        roots.emplace_back(arg);
+      }
+    }
+    if (roots.empty()) {
+      print_usage(argv[0]);
+      return 1;
+    }
+    return run_scan(*catalog, catalog_path, roots, threads);
+  }
+
+  if (command == "list" && argc == 3) {
+    for (const CatalogEntry &entry : catalog->get_entries()) {
+      print_entry(entry);
+    }
+    return 0;
+  }
+
+  if (command == "find" && argc == 4) {
+    const std::vector<const CatalogEntry *> found =
+        catalog->find_by_title(argv[3]);
+    for (const CatalogEntry *entry : found) {
+      print_entry(*entry);
+    }
+    return found.empty() ? 1 : 0;
+  }
+
+  if (command == "hash" && argc == 4) {
+    uint64_t hash;
+    if (!parse_number(argv[3], hash, 16)) {
+      print_usage(argv[0]);
+      return 1;
+    }
+    const CatalogEntry *entry = catalog->find_by_hash(hash);
+    if (entry == nullptr) {
+      return 1;
+    }
+    print_entry(*entry);
+    return 0;
+  }
+
+  print_usage(argv[0]);
+  return 1;
+}
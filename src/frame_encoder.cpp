@@ -0,0 +1,217 @@
+#include "frame_encoder.hpp"
+
+#include "ppu.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <print>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+// Grey level of each shade, white to black.
+constexpr std::array<uint8_t, 4> grey_levels = {0xFF, 0xAA, 0x55, 0x00};
+
+void put_be32(std::vector<uint8_t> &out, uint32_t value) {
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    out.push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+void put_png_chunk(std::vector<uint8_t> &out, std::string_view type,
+                   const uint8_t *data, size_t size) {
+  put_be32(out, static_cast<uint32_t>(size));
+  const size_t start = out.size();
+  out.insert(out.end(), type.begin(), type.end());
+  out.insert(out.end(), data, data + size);
+  put_be32(out, static_cast<uint32_t>(
+                    crc32(0, out.data() + start,
+                          static_cast<uInt>(out.size() - start))));
+}
+
+bool write_file(const std::filesystem::path &path,
+                const std::vector<uint8_t> &data) {
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char *>(data.data()),
+             static_cast<std::streamsize>(data.size()));
+  return static_cast<bool>(file);
+}
+
+std::vector<uint8_t> encode_ppm(const FrameEncoder::Pixels &pixels) {
+  const std::string header =
+      std::format("P6\n{} {}\n255\n", PPU::width, PPU::height);
+  std::vector<uint8_t> data(header.begin(), header.end());
+  data.reserve(data.size() + pixels.size() * 3);
+  for (const uint8_t shade : pixels) {
+    data.insert(data.end(), 3, grey_levels[shade & 0x03]);
+  }
+  return data;
+}
+
+std::vector<uint8_t> encode_png(const FrameEncoder::Pixels &pixels) {
+  // Every row starts with filter type 0 (none).
+  std::vector<uint8_t> raw;
+  raw.reserve(PPU::height * (PPU::width + 1));
+  for (size_t y = 0; y < PPU::height; ++y) {
+    raw.push_back(0);
+    for (size_t x = 0; x < PPU::width; ++x) {
+      raw.push_back(grey_levels[pixels[y * PPU::width + x] & 0x03]);
+    }
+  }
+  uLongf compressed_size = compressBound(static_cast<uLong>(raw.size()));
+  std::vector<uint8_t> compressed(compressed_size);
+  compress2(compressed.data(), &compressed_size, raw.data(),
+            static_cast<uLong>(raw.size()), Z_BEST_SPEED);
+
+  std::vector<uint8_t> data = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  std::vector<uint8_t> header;
+  put_be32(header, PPU::width);
+  put_be32(header, PPU::height);
+  // 8-bit greyscale, deflate, no interlacing.
+  header.insert(header.end(), {8, 0, 0, 0, 0});
+  put_png_chunk(data, "IHDR", header.data(), header.size());
+  put_png_chunk(data, "IDAT", compressed.data(), compressed_size);
+  put_png_chunk(data, "IEND", nullptr, 0);
+  return data;
+}
+
+} // namespace
+
+std::unique_ptr<FrameEncoder> FrameEncoder::open(const std::string &path) {
+  const std::string extension =
+      std::filesystem::path(path).extension().string();
+  FrameFormat format;
+  if (extension == ".ppm") {
+    format = FrameFormat::Ppm;
+  } else if (extension == ".png") {
+    format = FrameFormat::Png;
+  } else if (extension == ".y4m") {
+    format = FrameFormat::Y4m;
+  } else {
+    std::println(stderr, "Error: Unknown video format: {}", path);
+    return nullptr;
+  }
+
+  std::unique_ptr<FrameEncoder> encoder(new FrameEncoder(format, path));
+  if (format == FrameFormat::Y4m) {
+    encoder->stream.open(path, std::ios::binary);
+    // Luma only, at the DMG refresh rate of 4194304 / 70224 Hz.
+    encoder->stream << "YUV4MPEG2 W" << PPU::width << " H" << PPU::height
+                    << " F4194304:70224 Ip A1:1 Cmono XCOLORRANGE=FULL\n";
+    if (!encoder->stream) {
+      std::println(stderr, "Error: Could not open file {}", path);
+      return nullptr;
+    }
+  }
+  encoder->thread = std::thread(&FrameEncoder::run, encoder.get());
+  return encoder;
+}
+
+FrameEncoder::FrameEncoder(FrameFormat format,
+                           const std::filesystem::path &path)
+    : format(format), path(path) {
+  // Before the first frame the screen is white.
+  last_luma.fill(grey_levels[0]);
+}
+
+FrameEncoder::~FrameEncoder() { finish(); }
+
+void FrameEncoder::finish() {
+  frames.close();
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+void FrameEncoder::submit(uint64_t frame, const Pixels &pixels) {
+  Slot &slot = frames.get_back();
+  slot.frame = frame;
+  slot.sequence = submitted.fetch_add(1, std::memory_order_relaxed) + 1;
+  slot.repeats = pending_repeats;
+  slot.pixels = pixels;
+  pending_repeats = 0;
+  if (!frames.publish()) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void FrameEncoder::repeat() {
+  submitted.fetch_add(1, std::memory_order_relaxed);
+  repeated.fetch_add(1, std::memory_order_relaxed);
+  pending_repeats += 1;
+}
+
+FrameEncoder::Stats FrameEncoder::get_stats() const {
+  Stats stats;
+  stats.encoded = encoded.load(std::memory_order_relaxed);
+  stats.dropped = dropped.load(std::memory_order_relaxed);
+  stats.repeated = repeated.load(std::memory_order_relaxed);
+  stats.submitted = submitted.load(std::memory_order_relaxed);
+  stats.backlog =
+      stats.submitted - stats.dropped - stats.encoded - stats.repeated;
+  return stats;
+}
+
+void FrameEncoder::run() {
+  while (const Slot *slot = frames.take()) {
+    if (ok.load(std::memory_order_relaxed) && !write(*slot)) {
+      std::println(stderr, "Error: Could not write frame {} to {}",
+                   slot->frame, path.string());
+      ok.store(false, std::memory_order_relaxed);
+    }
+    encoded.fetch_add(1, std::memory_order_relaxed);
+  }
+  // Repeats after the last submitted frame.
+  if (format == FrameFormat::Y4m && ok.load(std::memory_order_relaxed)) {
+    const uint64_t trailing =
+        submitted.load(std::memory_order_relaxed) - last_sequence;
+    if (!write_y4m_frames(last_luma, trailing)) {
+      std::println(stderr, "Error: Could not write to {}", path.string());
+      ok.store(false, std::memory_order_relaxed);
+    }
+  }
+  stream.close();
+}
+
+bool FrameEncoder::write(const Slot &slot) {
+  if (format == FrameFormat::Y4m) {
+    Pixels luma;
+    for (size_t i = 0; i < luma.size(); ++i) {
+      luma[i] = grey_levels[slot.pixels[i] & 0x03];
+    }
+    // If the gap before this frame only holds repeats of the last frame
+    // written, it is filled with that frame. A gap left by dropped frames is
+    // filled with this one.
+    const uint64_t gap = slot.sequence - last_sequence - 1;
+    const uint64_t held = gap == slot.repeats ? gap : 0;
+    last_sequence = slot.sequence;
+    const bool written = write_y4m_frames(last_luma, held) &&
+                         write_y4m_frames(luma, gap - held + 1);
+    last_luma = luma;
+    return written;
+  }
+
+  std::filesystem::path file = path;
+  file.replace_filename(std::format("{}-{:06}{}", path.stem().string(),
+                                    slot.frame, path.extension().string()));
+  return write_file(file, format == FrameFormat::Ppm ? encode_ppm(slot.pixels)
+                                                     : encode_png(slot.pixels));
+}
+
+bool FrameEncoder::write_y4m_frames(const Pixels &luma, uint64_t count) {
+  for (uint64_t i = 0; i < count; ++i) {
+    stream << "FRAME\n";
+    stream.write(reinterpret_cast<const char *>(luma.data()),
+                 static_cast<std::streamsize>(luma.size()));
+  }
+  return static_cast<bool>(stream);
+}
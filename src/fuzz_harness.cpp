@@ -0,0 +1,163 @@
+#include "fuzz_harness.hpp"
+
+#include "cartridge.hpp"
+#include "gameboy.hpp"
+#include "machine_state.hpp"
+#include "ppu.hpp"
+#include "scheduler.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// How far a run may go past its end: the longest instruction plus interrupt
+// dispatch, a general-purpose DMA of 128 blocks, and a HALT skipping to the
+// next PPU event.
+constexpr uint64_t max_overshoot = 24 + 20 + 128 * 32 + PPU::cycles_per_line;
+
+bool points_into(const void *pointer, const void *begin, size_t size) {
+  const auto addr = reinterpret_cast<uintptr_t>(pointer);
+  const auto start = reinterpret_cast<uintptr_t>(begin);
+  return addr >= start && addr < start + size;
+}
+
+} // namespace
+
+FuzzHarness::FuzzHarness(std::unique_ptr<Cartridge> cartridge,
+                         FuzzOptions options)
+    : options(options), gameboy(std::move(cartridge)) {
+  gameboy.cpu.report_unknown_opcodes = false;
+  gameboy.set_fast_forward({.enabled = true});
+  for (uint32_t frame = 0; frame < options.boot_frames; ++frame) {
+    gameboy.run_frame();
+  }
+  // run_cycles() leaves drawing as it is.
+  gameboy.ppu.set_render_enabled(false);
+  gameboy.mmu.save_state(snapshot);
+}
+
+std::optional<std::string> FuzzHarness::run(const uint8_t *data, size_t size) {
+  const uint64_t end = run_input(data, size);
+  if (std::optional<std::string> violation = check_invariants(end)) {
+    return violation;
+  }
+  if (!options.check_determinism) {
+    return std::nullopt;
+  }
+
+  const uint64_t first = gameboy.hash_state();
+  run_input(data, size);
+  const uint64_t second = gameboy.hash_state();
+  if (first != second) {
+    return std::format("same input ended in states {:016x} and {:016x}", first,
+                       second);
+  }
+  return std::nullopt;
+}
+
+uint64_t FuzzHarness::run_input(const uint8_t *data, size_t size) {
+  gameboy.mmu.load_state(snapshot);
+  MachineState &state = gameboy.mmu.get_state();
+  const uint64_t start = state.cycles;
+  if (size == 0) {
+    return start;
+  }
+
+  if ((data[0] & 0x01) == 0) {
+    // Deadlines are absolute, so overshooting one step shortens the next.
+    uint64_t end = start;
+    for (size_t i = 1; i < size; ++i) {
+      gameboy.set_buttons(data[i]);
+      end += options.joypad_step_cycles;
+      if (state.cycles < end) {
+        gameboy.run_cycles(end - state.cycles);
+      }
+    }
+    return end;
+  }
+
+  // Leave room for the loop that catches the end of the stream.
+  const size_t length = std::min(size - 1, state.wram.size() - 2);
+  std::memcpy(state.wram.data(), data + 1, length);
+  state.wram[length] = 0x18; // JR -2
+  state.wram[length + 1] = 0xFE;
+  state.regs.pc = stream_addr;
+  gameboy.run_cycles(options.stream_cycles);
+  return start + options.stream_cycles;
+}
+
+std::optional<std::string> FuzzHarness::check_invariants(uint64_t end) const {
+  const MachineState &state = gameboy.mmu.get_state();
+  if (state.cycles < end) {
+    return std::format("run stopped at cycle {} before its end {}",
+                       state.cycles, end);
+  }
+  if (state.cycles - end > max_overshoot) {
+    return std::format("run overshot its end {} by {} cycles", end,
+                       state.cycles - end);
+  }
+
+  const Scheduler &scheduler = state.scheduler;
+  const uint64_t earliest = *std::ranges::min_element(scheduler.deadlines);
+  if (scheduler.next != earliest) {
+    return std::format("scheduler.next is {} but the earliest deadline is {}",
+                       scheduler.next, earliest);
+  }
+  if (scheduler.next <= state.cycles) {
+    return std::format("event due at {} was not handled by cycle {}",
+                       scheduler.next, state.cycles);
+  }
+  const uint64_t ppu_deadline = scheduler.get_deadline(Event::Ppu);
+  if (ppu_deadline > state.cycles + PPU::cycles_per_line) {
+    return std::format("next PPU event at {} is more than a line after {}",
+                       ppu_deadline, state.cycles);
+  }
+  const bool oam_dma_scheduled =
+      scheduler.get_deadline(Event::OamDma) != Scheduler::never;
+  if (state.oam_dma_active != oam_dma_scheduled) {
+    return std::format("OAM DMA active is {} but its event scheduled is {}",
+                       state.oam_dma_active, oam_dma_scheduled);
+  }
+  if (state.hdma_active && (!state.cgb_mode || state.hdma_blocks == 0)) {
+    return std::format("HBlank DMA active with {} blocks left (CGB mode: {})",
+                       state.hdma_blocks, state.cgb_mode);
+  }
+
+  const uint8_t ly = state.io[0x44];
+  const uint8_t mode = state.io[0x41] & 0x03;
+  if (ly >= PPU::lines_per_frame) {
+    return std::format("LY is {}", ly);
+  }
+  if (!state.lcd_on && (ly != 0 || mode != 0)) {
+    return std::format("LCD off at LY {} in mode {}", ly, mode);
+  }
+
+  const std::vector<uint8_t> &rom = gameboy.mmu.get_cartridge().get_rom();
+  for (size_t page = 0; page < MachineState::page_count; ++page) {
+    const uint8_t *read = state.read_pages[page];
+    const uint8_t *write = state.write_pages[page];
+    if (read != nullptr && !points_into(read, &state, sizeof(state)) &&
+        !points_into(read, rom.data(), rom.size())) {
+      return std::format("page {:X} reads from outside the machine", page);
+    }
+    if (write != nullptr && !points_into(write, &state, sizeof(state))) {
+      return std::format("page {:X} writes to outside the machine", page);
+    }
+  }
+  return std::nullopt;
+}
+
+std::unique_ptr<Cartridge> make_idle_cartridge() {
+  std::vector<uint8_t> rom(0x8000);
+  rom[0x100] = 0x18; // JR -2
+  rom[0x101] = 0xFE;
+  return std::move(*load_from_memory(std::move(rom)));
+}
@@ -0,0 +1,233 @@
+#include "gameboy.hpp"
+
+#include "aot.hpp"
+#include "cartridge.hpp"
+#include "cheats.hpp"
+#include "control_flow.hpp"
+#include "hash.hpp"
+#include "machine_state.hpp"
+#include "profiler.hpp"
+#include "scheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+GameBoy::GameBoy(std::unique_ptr<Cartridge> cartridge)
+    : mmu(std::move(cartridge)), cpu(mmu), ppu(mmu.get_state()) {
+  cpu.log_instructions = false;
+  cpu.regFile.reset_post_boot();
+
+  // I/O registers as left by the boot ROM.
+  MachineState &state = mmu.get_state();
+  state.io[0x02] = 0x7E; // SC
+  state.io[0x0F] = 0x01; // IF
+  state.io[0x40] = 0x91; // LCDC
+  state.io[0x47] = 0xFC; // BGP
+  state.io[0x55] = 0xFF; // HDMA5: no transfer running
+
+  // Only CGB-only cartridges run in CGB mode; dual-mode ones see a DMG.
+  state.cgb_mode = mmu.get_cartridge().get_rom()[0x143] == 0xC0;
+
+  state.scheduler.clear();
+  ppu.reset();
+}
+
+bool GameBoy::run_frame() {
+  const uint64_t frame = get_frame();
+  const bool draw = !fast_forward.enabled ||
+                    (fast_forward.display_interval != 0 &&
+                     frame % fast_forward.display_interval == 0);
+  if (run_ahead_frames != 0 && !mmu.has_traps()) {
+    run_frame_ahead(draw);
+    changed_lines = ppu.take_changed_lines();
+    return true;
+  }
+
+  ppu.set_render_enabled(draw);
+  if (!run_until((frame + 1) * cycles_per_frame)) {
+    return false;
+  }
+  changed_lines = ppu.take_changed_lines();
+  return true;
+}
+
+void GameBoy::set_run_ahead(uint32_t frames) {
+  run_ahead_frames = frames;
+  if (frames != 0 && run_ahead_state == nullptr) {
+    run_ahead_state = std::make_unique<MachineState>();
+  }
+}
+
+void GameBoy::run_frame_ahead(bool draw) {
+  using Clock = std::chrono::steady_clock;
+  const auto elapsed_ns = [](Clock::time_point from, Clock::time_point to) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(to - from)
+            .count());
+  };
+
+  // The real frame is never shown.
+  const Clock::time_point start = Clock::now();
+  ppu.set_render_enabled(false);
+  run_until((get_frame() + 1) * cycles_per_frame);
+  const Clock::time_point ran = Clock::now();
+  mmu.save_state(*run_ahead_state);
+  const Clock::time_point saved = Clock::now();
+  for (uint32_t i = 0; i < run_ahead_frames; ++i) {
+    ppu.set_render_enabled(draw && i + 1 == run_ahead_frames);
+    run_until((get_frame() + 1) * cycles_per_frame);
+  }
+  const Clock::time_point ahead = Clock::now();
+  // The framebuffer is not part of the state and keeps the last frame.
+  mmu.load_state(*run_ahead_state);
+  const Clock::time_point restored = Clock::now();
+
+  RunAheadStats &stats = run_ahead_stats;
+  stats.frames += 1;
+  stats.frame_ns += elapsed_ns(start, ran);
+  stats.save_ns += elapsed_ns(ran, saved);
+  stats.ahead_ns += elapsed_ns(saved, ahead);
+  stats.restore_ns += elapsed_ns(ahead, restored);
+  stats.max_total_ns =
+      std::max(stats.max_total_ns, elapsed_ns(start, restored));
+}
+
+void GameBoy::set_cheats(const Cheats &cheats) {
+  mmu.set_rom_patches(cheats.rom_patches);
+  ram_cheats = cheats.ram_cheats;
+}
+
+bool GameBoy::run_cycles(uint64_t cycles) {
+  return run_until(mmu.get_state().cycles + cycles);
+}
+
+bool GameBoy::run_until(uint64_t end) {
+  const MachineState &state = mmu.get_state();
+  run_end = end;
+  if (!aot_blocks.empty()) {
+    while (state.cycles < run_end) {
+      step_aot();
+    }
+  } else {
+    while (state.cycles < run_end) {
+      step();
+    }
+  }
+  return state.cycles >= end;
+}
+
+bool GameBoy::set_aot_program(const AotProgram *program) {
+  aot_blocks.clear();
+  if (program == nullptr) {
+    return true;
+  }
+  const std::vector<uint8_t> &rom = mmu.get_cartridge().get_rom();
+  if (program->rom_hash != hash64(rom.data(), rom.size())) {
+    return false;
+  }
+  aot_blocks.resize(rom.size());
+  for (size_t i = 0; i < program->block_count; ++i) {
+    const AotBlock &block = program->blocks[i];
+    const size_t offset = CodeAddress{block.bank, block.addr}.get_rom_offset();
+    if (offset < aot_blocks.size()) {
+      aot_blocks[offset] = block.run;
+    }
+  }
+  return true;
+}
+
+void GameBoy::set_profiler(Profiler *profiler) {
+  this->profiler = profiler;
+  Scheduler &scheduler = mmu.get_state().scheduler;
+  if (profiler == nullptr) {
+    scheduler.cancel(Event::Profile);
+  } else {
+    scheduler.schedule(Event::Profile,
+                       mmu.get_state().cycles + profiler->get_interval());
+  }
+}
+
+PerfCounters GameBoy::get_counters() const {
+  return {
+      .instructions = cpu.instruction_count,
+      .cycles = mmu.get_state().cycles,
+      .frames = get_frame(),
+      .halted_cycles = cpu.halted_cycles,
+      .block_lookups = aot_lookups,
+      .block_hits = aot_hits,
+      .dma_bytes = mmu.get_dma_bytes(),
+  };
+}
+
+// Runs the compiled block at PC and the blocks it leads to, or a single
+// instruction in the interpreter if there is none or it may not run.
+void GameBoy::step_aot() {
+  MachineState &state = mmu.get_state();
+  const uint16_t pc = cpu.regFile.pc;
+  AotBlockFunction block = nullptr;
+  if (pc < 0x8000 && cpu.trace == nullptr && !mmu.has_traps() &&
+      !mmu.has_rom_patches() && aot_can_continue(state, run_end)) {
+    const uint16_t bank = pc < 0x4000 ? 0 : mmu.get_cartridge().get_rom_bank();
+    const size_t offset = CodeAddress{bank, pc}.get_rom_offset();
+    if (offset < aot_blocks.size()) {
+      block = aot_blocks[offset];
+    }
+  }
+  aot_lookups += 1;
+  if (block == nullptr) {
+    step();
+    return;
+  }
+  aot_hits += 1;
+  while (block != nullptr) {
+    block = block(cpu, state, run_end).block;
+  }
+  if (state.cycles >= state.scheduler.next) {
+    dispatch_events();
+  }
+}
+
+void GameBoy::dispatch_events() {
+  MachineState &state = mmu.get_state();
+  Event event;
+  uint64_t deadline;
+  while (state.scheduler.pop_due(state.cycles, event, deadline)) {
+    switch (event) {
+    case Event::Ppu:
+      if (ppu.update(deadline) && !ram_cheats.empty()) [[unlikely]] {
+        for (const RamCheat &cheat : ram_cheats) {
+          mmu.poke(cheat.addr, cheat.value);
+        }
+      }
+      break;
+    case Event::OamDma:
+      mmu.finish_oam_dma();
+      break;
+    case Event::Hdma:
+      mmu.run_hdma_block();
+      break;
+    case Event::Serial:
+      mmu.complete_serial_transfer(0xFF);
+      break;
+    case Event::Link:
+      mmu.sync_link();
+      break;
+    case Event::Debug:
+      run_end = 0;
+      break;
+    case Event::Profile:
+      if (profiler != nullptr) {
+        profiler->sample(mmu);
+        state.scheduler.schedule(Event::Profile,
+                                 deadline + profiler->get_interval());
+      }
+      break;
+    case Event::Count:
+      std::unreachable();
+    }
+  }
+}
@@ -0,0 +1,130 @@
+#include "hash.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t prime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+uint64_t read64(const uint8_t *p) {
+  uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  if constexpr (std::endian::native == std::endian::big) {
+    value = std::byteswap(value);
+  }
+  return value;
+}
+
+uint32_t read32(const uint8_t *p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  if constexpr (std::endian::native == std::endian::big) {
+    value = std::byteswap(value);
+  }
+  return value;
+}
+
+uint64_t round(uint64_t acc, uint64_t input) {
+  acc += input * prime2;
+  acc = std::rotl(acc, 31);
+  return acc * prime1;
+}
+
+uint64_t merge_round(uint64_t acc, uint64_t value) {
+  acc ^= round(0, value);
+  return acc * prime1 + prime4;
+}
+
+} // namespace
+
+Hasher64::Hasher64(uint64_t seed)
+    : acc{seed + prime1 + prime2, seed + prime2, seed, seed - prime1},
+      buffer{}, seed(seed) {}
+
+void Hasher64::update(const void *data, size_t size) {
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  total += size;
+
+  if (buffered + size < buffer.size()) {
+    std::memcpy(buffer.data() + buffered, p, size);
+    buffered += size;
+    return;
+  }
+
+  if (buffered > 0) {
+    const size_t fill = buffer.size() - buffered;
+    std::memcpy(buffer.data() + buffered, p, fill);
+    for (size_t lane = 0; lane < 4; ++lane) {
+      acc[lane] = round(acc[lane], read64(buffer.data() + lane * 8));
+    }
+    p += fill;
+    size -= fill;
+    buffered = 0;
+  }
+
+  while (size >= 32) {
+    for (size_t lane = 0; lane < 4; ++lane) {
+      acc[lane] = round(acc[lane], read64(p + lane * 8));
+    }
+    p += 32;
+    size -= 32;
+  }
+
+  std::memcpy(buffer.data(), p, size);
+  buffered = size;
+}
+
+uint64_t Hasher64::digest() const {
+  uint64_t h;
+  if (total >= 32) {
+    h = std::rotl(acc[0], 1) + std::rotl(acc[1], 7) + std::rotl(acc[2], 12) +
+        std::rotl(acc[3], 18);
+    for (size_t lane = 0; lane < 4; ++lane) {
+      h = merge_round(h, acc[lane]);
+    }
+  } else {
+    h = seed + prime5;
+  }
+  h += total;
+
+  const uint8_t *p = buffer.data();
+  size_t size = buffered;
+  while (size >= 8) {
+    h ^= round(0, read64(p));
+    h = std::rotl(h, 27) * prime1 + prime4;
+    p += 8;
+    size -= 8;
+  }
+  if (size >= 4) {
+    h ^= static_cast<uint64_t>(read32(p)) * prime1;
+    h = std::rotl(h, 23) * prime2 + prime3;
+    p += 4;
+    size -= 4;
+  }
+  while (size > 0) {
+    h ^= (*p) * prime5;
+    h = std::rotl(h, 11) * prime1;
+    p += 1;
+    size -= 1;
+  }
+
+  h ^= h >> 33;
+  h *= prime2;
+  h ^= h >> 29;
+  h *= prime3;
+  h ^= h >> 32;
+  return h;
+}
+
+uint64_t hash64(const void *data, size_t size, uint64_t seed) {
+  Hasher64 hasher(seed);
+  hasher.update(data, size);
+  return hasher.digest();
+}
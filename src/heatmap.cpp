@@ -0,0 +1,112 @@
+#include "heatmap.hpp"
+
+#include "memory.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <print>
+#include <string>
+
+namespace {
+
+constexpr Access kinds[] = {Access::Read, Access::Write, Access::Execute};
+
+struct Row {
+  uint32_t addr;
+  uint64_t reads;
+  uint64_t writes;
+  uint64_t executes;
+
+  bool empty() const { return reads == 0 && writes == 0 && executes == 0; }
+};
+
+// Calls `emit(row, is_page)` for every accessed page, then every accessed
+// address.
+template <typename Emit>
+void for_each_row(const Heatmap &heatmap, Emit emit) {
+  for (uint32_t page = 0; page < 0x10000; page += Heatmap::page_size) {
+    Row row{page, 0, 0, 0};
+    for (uint32_t addr = page; addr < page + Heatmap::page_size; ++addr) {
+      row.reads += heatmap.get_count(kinds[0], static_cast<uint16_t>(addr));
+      row.writes += heatmap.get_count(kinds[1], static_cast<uint16_t>(addr));
+      row.executes += heatmap.get_count(kinds[2], static_cast<uint16_t>(addr));
+    }
+    if (!row.empty()) {
+      emit(row, true);
+    }
+  }
+  for (uint32_t addr = 0; addr < 0x10000; ++addr) {
+    const Row row{addr, heatmap.get_count(kinds[0], static_cast<uint16_t>(addr)),
+                  heatmap.get_count(kinds[1], static_cast<uint16_t>(addr)),
+                  heatmap.get_count(kinds[2], static_cast<uint16_t>(addr))};
+    if (!row.empty()) {
+      emit(row, false);
+    }
+  }
+}
+
+} // namespace
+
+Heatmap::Heatmap(uint32_t sample_interval)
+    : sample_interval(std::max<uint32_t>(sample_interval, 1)),
+      countdown(this->sample_interval) {
+  clear();
+}
+
+void Heatmap::clear() {
+  for (auto &kind : counts) {
+    kind.fill(0);
+  }
+}
+
+bool Heatmap::write(const std::string &path, uint64_t first_frame,
+                    uint64_t last_frame) const {
+  const bool json = path.ends_with(".json");
+  const std::string text = json ? to_json(first_frame, last_frame)
+                                : to_csv(first_frame, last_frame);
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    std::println(stderr, "Error: Could not open file {}", path);
+    return false;
+  }
+  file.write(text.data(), static_cast<std::streamsize>(text.size()));
+  return static_cast<bool>(file);
+}
+
+std::string Heatmap::to_csv(uint64_t first_frame, uint64_t last_frame) const {
+  std::string text =
+      "first_frame,last_frame,granularity,addr,reads,writes,executes\n";
+  for_each_row(*this, [&](const Row &row, bool is_page) {
+    std::format_to(std::back_inserter(text), "{},{},{},0x{:04X},{},{},{}\n",
+                   first_frame, last_frame, is_page ? "page" : "address",
+                   row.addr, row.reads, row.writes, row.executes);
+  });
+  return text;
+}
+
+std::string Heatmap::to_json(uint64_t first_frame, uint64_t last_frame) const {
+  std::string pages;
+  std::string addresses;
+  for_each_row(*this, [&](const Row &row, bool is_page) {
+    std::string &list = is_page ? pages : addresses;
+    std::format_to(std::back_inserter(list),
+                   "{}\n    {{\"addr\": {}, \"reads\": {}, \"writes\": {}, "
+                   "\"executes\": {}}}",
+                   list.empty() ? "" : ",", row.addr, row.reads, row.writes,
+                   row.executes);
+  });
+  return std::format("{{\n"
+                     "  \"first_frame\": {},\n"
+                     "  \"last_frame\": {},\n"
+                     "  \"sample_interval\": {},\n"
+                     "  \"page_size\": {},\n"
+                     "  \"pages\": [{}\n  ],\n"
+                     "  \"addresses\": [{}\n  ]\n"
+                     "}}\n",
+                     first_frame, last_frame, sample_interval, page_size, pages,
+                     addresses);
+}
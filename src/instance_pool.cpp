@@ -0,0 +1,71 @@
+#include "instance_pool.hpp"
+
+#include "cartridge.hpp"
+#include "gameboy.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <sys/mman.h>
+#include <utility>
+
+InstancePool::InstancePool(size_t capacity, bool huge_pages)
+    : capacity(capacity) {
+  block_size = (capacity * slot_size + huge_page_size - 1) &
+               ~(huge_page_size - 1);
+  if (block_size != 0) {
+    // Over-map by a huge page and trim both ends to get the alignment;
+    // mmap() itself only guarantees 4 KiB.
+    const size_t mapped_size = block_size + huge_page_size;
+    void *mapped = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    const auto start = reinterpret_cast<uintptr_t>(mapped);
+    const uintptr_t aligned =
+        (start + huge_page_size - 1) & ~(huge_page_size - 1);
+    if (aligned != start) {
+      munmap(mapped, aligned - start);
+    }
+    const uintptr_t end = aligned + block_size;
+    if (end != start + mapped_size) {
+      munmap(reinterpret_cast<void *>(end), start + mapped_size - end);
+    }
+    block = reinterpret_cast<std::byte *>(aligned);
+#ifdef MADV_HUGEPAGE
+    this->huge_pages =
+        huge_pages && madvise(block, block_size, MADV_HUGEPAGE) == 0;
+#endif
+  }
+
+  free_slots.reserve(capacity);
+  for (size_t slot = capacity; slot-- > 0;) {
+    free_slots.push_back(static_cast<uint32_t>(slot));
+  }
+}
+
+InstancePool::~InstancePool() {
+  if (block != nullptr) {
+    munmap(block, block_size);
+  }
+}
+
+InstancePool::Pointer
+InstancePool::acquire(std::unique_ptr<Cartridge> cartridge) {
+  if (free_slots.empty()) {
+    return Pointer(nullptr, {this});
+  }
+  const uint32_t slot = free_slots.back();
+  auto *gameboy = new (block + size_t{slot} * slot_size)
+      GameBoy(std::move(cartridge));
+  free_slots.pop_back();
+  return Pointer(gameboy, {this});
+}
+
+void InstancePool::release(GameBoy *gameboy) {
+  const size_t offset =
+      static_cast<size_t>(reinterpret_cast<std::byte *>(gameboy) - block);
+  gameboy->~GameBoy();
+  free_slots.push_back(static_cast<uint32_t>(offset / slot_size));
+}
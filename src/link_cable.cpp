@@ -0,0 +1,150 @@
+#include "link_cable.hpp"
+
+#include "gameboy.hpp"
+#include "machine_state.hpp"
+#include "mmu.hpp"
+#include "scheduler.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+
+static_assert(GameBoy::cycles_per_frame % LinkPort::quantum == 0);
+
+namespace {
+
+// Epochs from the start of a transfer until the other end answers it, and
+// until it completes.
+constexpr uint64_t answer_epochs = 2;
+constexpr uint64_t transfer_epochs = 4;
+
+} // namespace
+
+LinkPort::LinkPort(MMU &mmu) : mmu(mmu) {
+  MachineState &state = mmu.get_state();
+  origin = state.cycles / GameBoy::cycles_per_frame * GameBoy::cycles_per_frame;
+  epoch = (state.cycles - origin) / quantum;
+  published_epoch.store(epoch, std::memory_order_relaxed);
+  state.scheduler.schedule(Event::Link, origin + (epoch + 1) * quantum);
+}
+
+void LinkPort::start_transfer() {
+  if (sent_epoch) {
+    return;
+  }
+  sent_epoch = epoch;
+  send({Message::Kind::Start, mmu.get_state().io[0x01], epoch});
+}
+
+void LinkPort::sync() {
+  MachineState &state = mmu.get_state();
+  epoch += 1;
+  published_epoch.store(epoch, std::memory_order_release);
+  state.scheduler.schedule(Event::Link, origin + (epoch + 1) * quantum);
+
+  if ((state.io[0x02] & 0x81) == 0x80) {
+    // Waiting on the external clock: a transfer due now must be in, i.e.
+    // the other end must have sent everything up to epoch - 2.
+    wait_until([&] {
+      return partner->published_epoch.load(std::memory_order_acquire) + 1 >=
+             epoch;
+    });
+  }
+  poll();
+
+  if (sent_epoch && *sent_epoch + transfer_epochs == epoch) {
+    wait_until([&] { return answer.has_value(); });
+    mmu.complete_serial_transfer(*answer);
+    answer.reset();
+    sent_epoch.reset();
+  }
+}
+
+void LinkPort::send(const Message &message) {
+  // At most one transfer and one answer per direction are in flight.
+  while (!partner->inbox.try_push(message)) {
+    std::this_thread::yield();
+  }
+}
+
+void LinkPort::poll() {
+  Message message;
+  while (inbox.try_pop(message)) {
+    if (message.kind == Message::Kind::Answer) {
+      answer = message.value;
+    } else {
+      received = message;
+    }
+  }
+  answer_received();
+}
+
+void LinkPort::answer_received() {
+  if (!received || received->epoch + answer_epochs > epoch) {
+    return;
+  }
+  // Had we been waiting on the external clock at an earlier epoch, we would
+  // have waited for this transfer then; so only one due now can be taken.
+  MachineState &state = mmu.get_state();
+  uint8_t value = 0xFF;
+  if (received->epoch + answer_epochs == epoch &&
+      (state.io[0x02] & 0x81) == 0x80) {
+    value = state.io[0x01];
+    mmu.complete_serial_transfer(received->value);
+  }
+  send({Message::Kind::Answer, value, epoch});
+  received.reset();
+}
+
+template <typename Done> void LinkPort::wait_until(Done done) {
+  while (!done()) {
+    // Keep answering; the other end may be waiting for us in turn.
+    poll();
+    std::this_thread::yield();
+  }
+}
+
+void LinkPort::finish_run() {
+  const uint64_t runs = finished_runs.load(std::memory_order_relaxed) + 1;
+  finished_runs.store(runs, std::memory_order_release);
+  wait_until([&] {
+    return partner->finished_runs.load(std::memory_order_acquire) >= runs;
+  });
+}
+
+LinkCable::LinkCable(GameBoy &first, GameBoy &second)
+    : gameboys{&first, &second} {
+  for (size_t side = 0; side < 2; ++side) {
+    ports[side] = std::make_unique<LinkPort>(gameboys[side]->mmu);
+  }
+  ports[0]->partner = ports[1].get();
+  ports[1]->partner = ports[0].get();
+  for (size_t side = 0; side < 2; ++side) {
+    gameboys[side]->mmu.set_link(ports[side].get());
+  }
+}
+
+LinkCable::~LinkCable() {
+  for (GameBoy *gameboy : gameboys) {
+    gameboy->mmu.set_link(nullptr);
+  }
+}
+
+void LinkCable::run_frames(uint32_t frames) {
+  std::thread second([&] { run_side(1, frames); });
+  run_side(0, frames);
+  second.join();
+}
+
+void LinkCable::run_side(size_t side, uint32_t frames) {
+  GameBoy &gameboy = *gameboys[side];
+  for (uint32_t frame = 0; frame < frames; ++frame) {
+    // A breakpoint stops only this end; finish the frame regardless.
+    while (!gameboy.run_frame()) {
+    }
+  }
+  // The other end may still need answers from us to finish its run.
+  ports[side]->finish_run();
+}
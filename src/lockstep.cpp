@@ -0,0 +1,450 @@
+#include "lockstep.hpp"
+
+#include "cartridge.hpp"
+#include "gameboy.hpp"
+#include "machine_state.hpp"
+#include "opcodes.hpp"
+#include "register.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace {
+
+constexpr size_t reg_b = 0;
+constexpr size_t reg_c = 1;
+constexpr size_t reg_d = 2;
+constexpr size_t reg_e = 3;
+constexpr size_t reg_h = 4;
+constexpr size_t reg_l = 5;
+constexpr size_t reg_hl_indirect = 6;
+constexpr size_t reg_a = 7;
+
+constexpr uint8_t flag_z = static_cast<uint8_t>(Flag::Z);
+constexpr uint8_t flag_n = static_cast<uint8_t>(Flag::N);
+constexpr uint8_t flag_h = static_cast<uint8_t>(Flag::H);
+constexpr uint8_t flag_c = static_cast<uint8_t>(Flag::C);
+
+// Lane masks hold 0x00 or 0xFF per lane. Blending with bitwise operations
+// instead of branching keeps every per-lane loop vectorizable.
+inline uint8_t blend(uint8_t mask, uint8_t value, uint8_t old) {
+  return (value & mask) | (old & ~mask);
+}
+
+inline uint16_t blend(uint8_t mask, uint16_t value, uint16_t old) {
+  const uint16_t wide = static_cast<uint16_t>(static_cast<int8_t>(mask));
+  return (value & wide) | (old & ~wide);
+}
+
+// Only GameBoy::step() changes any of these, so they hold until the lane
+// next goes through it.
+bool is_plain(const GameBoy &gameboy) {
+  const MachineState &state = gameboy.mmu.get_state();
+  return (state.ie & state.io[0x0F] & 0x1F) == 0 && !state.halted &&
+         !state.ime_pending && !gameboy.mmu.has_traps() &&
+         !gameboy.mmu.has_rom_patches() && gameboy.cpu.trace == nullptr &&
+         !gameboy.cpu.log_instructions;
+}
+
+} // namespace
+
+LockstepBatch::LockstepBatch(const std::vector<uint8_t> &rom)
+    : r8{}, f{}, sp{}, pc{}, cycles{}, deadlines{}, instructions{}, ready{} {
+  const RomImage image = intern_rom(std::vector<uint8_t>(rom));
+  lanes.reserve(lane_count);
+  for (size_t lane = 0; lane < lane_count; ++lane) {
+    lanes.push_back(
+        std::make_unique<GameBoy>(std::make_unique<RomOnly>(image)));
+  }
+}
+
+void LockstepBatch::load_lane(size_t lane) {
+  const GameBoy &gameboy = *lanes[lane];
+  const MachineState &state = gameboy.mmu.get_state();
+  const RegFile &regFile = state.regs;
+  r8[reg_a][lane] = regFile.a;
+  f[lane] = regFile.f;
+  r8[reg_b][lane] = regFile.b;
+  r8[reg_c][lane] = regFile.c;
+  r8[reg_d][lane] = regFile.d;
+  r8[reg_e][lane] = regFile.e;
+  r8[reg_h][lane] = regFile.h;
+  r8[reg_l][lane] = regFile.l;
+  sp[lane] = regFile.sp;
+  pc[lane] = regFile.pc;
+  cycles[lane] = state.cycles;
+  deadlines[lane] = state.scheduler.next;
+  instructions[lane] = gameboy.cpu.instruction_count;
+  ready[lane] = is_plain(gameboy) ? 0xFF : 0x00;
+}
+
+void LockstepBatch::store_lane(size_t lane) {
+  GameBoy &gameboy = *lanes[lane];
+  MachineState &state = gameboy.mmu.get_state();
+  RegFile &regFile = state.regs;
+  regFile.a = r8[reg_a][lane];
+  regFile.f = f[lane];
+  regFile.b = r8[reg_b][lane];
+  regFile.c = r8[reg_c][lane];
+  regFile.d = r8[reg_d][lane];
+  regFile.e = r8[reg_e][lane];
+  regFile.h = r8[reg_h][lane];
+  regFile.l = r8[reg_l][lane];
+  regFile.sp = sp[lane];
+  regFile.pc = pc[lane];
+  state.cycles = cycles[lane];
+  gameboy.cpu.instruction_count = instructions[lane];
+}
+
+void LockstepBatch::run(uint64_t steps) {
+  for (size_t i = 0; i < lane_count; ++i) {
+    load_lane(i);
+  }
+  LaneArray<uint64_t> remaining;
+  remaining.fill(steps);
+
+  for (;;) {
+    // Always advance the lanes with the lowest PC. Lanes that fell behind
+    // on a divergent branch then catch up with the others at the next
+    // common instruction instead of staying out of phase forever.
+    uint32_t group_pc = 0x10000;
+    for (size_t i = 0; i < lane_count; ++i) {
+      const uint32_t lane_pc = remaining[i] != 0 ? pc[i] : 0x10000;
+      group_pc = lane_pc < group_pc ? lane_pc : group_pc;
+    }
+    if (group_pc == 0x10000) {
+      break;
+    }
+
+    LaneMask mask;
+    for (size_t i = 0; i < lane_count; ++i) {
+      mask[i] = (pc[i] == group_pc && remaining[i] != 0) ? 0xFF : 0x00;
+    }
+    for (size_t i = 0; i < lane_count; ++i) {
+      remaining[i] -= mask[i] & 1;
+    }
+
+    // Every lane maps the same ROM image, so one fetch from the cartridge
+    // serves the whole group. Lanes with ROM patches see different bytes
+    // and are never ready; code in RAM may differ between lanes and always
+    // runs scalar.
+    LaneMask vector_mask{};
+    if (group_pc < 0x8000) {
+      const Cartridge &rom = lanes[0]->mmu.get_cartridge();
+      const uint8_t opcode = rom.get_byte(group_pc);
+      const uint8_t imm8 = rom.get_byte(group_pc + 1);
+      const uint16_t imm16 =
+          static_cast<uint16_t>(rom.get_byte(group_pc + 2) << 8 | imm8);
+      // Lanes whose next event could come due during the instruction need
+      // GameBoy::step() to dispatch it afterwards.
+      const uint8_t max_cycles = get_opcode_info(opcode).branch_cycles;
+      size_t vector_size = 0;
+      for (size_t i = 0; i < lane_count; ++i) {
+        const bool before_event = cycles[i] + max_cycles < deadlines[i];
+        vector_mask[i] = mask[i] & ready[i] & (before_event ? 0xFF : 0x00);
+        vector_size += vector_mask[i] & 1;
+      }
+      bool vectorized = false;
+      if (vector_size > 1 && !scalar_opcodes[opcode]) {
+        vectorized = execute_vector(vector_mask, group_pc, opcode, imm8, imm16);
+        // execute_vector() turns opcodes down by the opcode alone.
+        scalar_opcodes[opcode] = !vectorized;
+      }
+      if (vectorized) {
+        for (size_t i = 0; i < lane_count; ++i) {
+          instructions[i] += vector_mask[i] & 1;
+        }
+        vector_steps += vector_size;
+      } else {
+        vector_mask.fill(0);
+      }
+    }
+
+    for (size_t i = 0; i < lane_count; ++i) {
+      if (mask[i] != 0 && vector_mask[i] == 0) {
+        execute_scalar(i, remaining[i]);
+      }
+    }
+  }
+
+  for (size_t i = 0; i < lane_count; ++i) {
+    store_lane(i);
+  }
+}
+
+bool LockstepBatch::stays_scalar(const GameBoy &gameboy) const {
+  const uint16_t lane_pc = gameboy.mmu.get_state().regs.pc;
+  return !is_plain(gameboy) || lane_pc >= 0x8000 ||
+         scalar_opcodes[gameboy.mmu.get_cartridge().get_byte(lane_pc)];
+}
+
+void LockstepBatch::execute_scalar(size_t lane, uint64_t &remaining) {
+  store_lane(lane);
+  GameBoy &gameboy = *lanes[lane];
+  gameboy.step();
+  scalar_steps += 1;
+  // A lane that cannot join the vector path gains nothing from waiting for
+  // the others, so it keeps going until it could.
+  while (remaining != 0 && stays_scalar(gameboy)) {
+    gameboy.step();
+    --remaining;
+    scalar_steps += 1;
+  }
+  load_lane(lane);
+}
+
+bool LockstepBatch::execute_vector(const LaneMask &mask, uint16_t group_pc,
+                                   uint8_t opcode, uint8_t imm8,
+                                   uint16_t imm16) {
+  const size_t dst = (opcode >> 3) & 0x07;
+  const size_t src = opcode & 0x07;
+
+  // NOP
+  if (opcode == 0x00) {
+    advance(mask, opcode, 1);
+    return true;
+  }
+
+  // LD r8, imm8
+  if ((opcode & 0xC7) == 0x06 && dst != reg_hl_indirect) {
+    LaneArray<uint8_t> &r = r8[dst];
+    for (size_t i = 0; i < lane_count; ++i) {
+      r[i] = blend(mask[i], imm8, r[i]);
+    }
+    advance(mask, opcode, 2);
+    return true;
+  }
+
+  // LD r8, r8
+  if (0x40 <= opcode && opcode <= 0x7F && dst != reg_hl_indirect &&
+      src != reg_hl_indirect) {
+    LaneArray<uint8_t> &r = r8[dst];
+    const LaneArray<uint8_t> &s = r8[src];
+    for (size_t i = 0; i < lane_count; ++i) {
+      r[i] = blend(mask[i], s[i], r[i]);
+    }
+    advance(mask, opcode, 1);
+    return true;
+  }
+
+  // INC r8
+  if ((opcode & 0xC7) == 0x04 && dst != reg_hl_indirect) {
+    LaneArray<uint8_t> &r = r8[dst];
+    for (size_t i = 0; i < lane_count; ++i) {
+      const uint8_t result = r[i] + 1;
+      const uint8_t flags =
+          (f[i] & ~(flag_z | flag_n | flag_h)) | (result == 0 ? flag_z : 0) |
+          ((r[i] & 0x0F) == 0x0F ? flag_h : 0);
+      r[i] = blend(mask[i], result, r[i]);
+      f[i] = blend(mask[i], flags, f[i]);
+    }
+    advance(mask, opcode, 1);
+    return true;
+  }
+
+  // DEC r8
+  if ((opcode & 0xC7) == 0x05 && dst != reg_hl_indirect) {
+    LaneArray<uint8_t> &r = r8[dst];
+    for (size_t i = 0; i < lane_count; ++i) {
+      const uint8_t result = r[i] - 1;
+      const uint8_t flags = (f[i] & ~(flag_z | flag_n | flag_h)) | flag_n |
+                            (result == 0 ? flag_z : 0) |
+                            ((r[i] & 0x0F) == 0 ? flag_h : 0);
+      r[i] = blend(mask[i], result, r[i]);
+      f[i] = blend(mask[i], flags, f[i]);
+    }
+    advance(mask, opcode, 1);
+    return true;
+  }
+
+  // ALU A, r8
+  if (0x80 <= opcode && opcode <= 0xBF && src != reg_hl_indirect) {
+    alu(mask, dst, r8[src]);
+    advance(mask, opcode, 1);
+    return true;
+  }
+
+  switch (opcode) {
+  // ADD/SUB/AND/OR A, imm8
+  case 0xC6:
+  case 0xD6:
+  case 0xE6:
+  case 0xF6: {
+    LaneArray<uint8_t> operand;
+    operand.fill(imm8);
+    alu(mask, dst, operand);
+    advance(mask, opcode, 2);
+    return true;
+  }
+
+  // LD r16, imm16
+  case 0x01:
+    set_r16(mask, reg_b, reg_c, imm16);
+    advance(mask, opcode, 3);
+    return true;
+  case 0x11:
+    set_r16(mask, reg_d, reg_e, imm16);
+    advance(mask, opcode, 3);
+    return true;
+  case 0x21:
+    set_r16(mask, reg_h, reg_l, imm16);
+    advance(mask, opcode, 3);
+    return true;
+  case 0x31:
+    for (size_t i = 0; i < lane_count; ++i) {
+      sp[i] = blend(mask[i], imm16, sp[i]);
+    }
+    advance(mask, opcode, 3);
+    return true;
+
+  // INC r16 / DEC r16
+  case 0x03:
+  case 0x0B:
+    add_r16(mask, reg_b, reg_c, opcode == 0x03 ? 1 : 0xFFFF);
+    advance(mask, opcode, 1);
+    return true;
+  case 0x13:
+  case 0x1B:
+    add_r16(mask, reg_d, reg_e, opcode == 0x13 ? 1 : 0xFFFF);
+    advance(mask, opcode, 1);
+    return true;
+  case 0x23:
+  case 0x2B:
+    add_r16(mask, reg_h, reg_l, opcode == 0x23 ? 1 : 0xFFFF);
+    advance(mask, opcode, 1);
+    return true;
+  case 0x33:
+  case 0x3B: {
+    const uint16_t delta = opcode == 0x33 ? 1 : 0xFFFF;
+    for (size_t i = 0; i < lane_count; ++i) {
+      sp[i] = blend(mask[i], static_cast<uint16_t>(sp[i] + delta), sp[i]);
+    }
+    advance(mask, opcode, 1);
+    return true;
+  }
+
+  // JR imm8 / JR cond, imm8
+  case 0x18:
+  case 0x20:
+  case 0x28:
+  case 0x30:
+  case 0x38: {
+    const uint16_t next = group_pc + 2;
+    const uint16_t target =
+        static_cast<uint16_t>(next + static_cast<int8_t>(imm8));
+    if (opcode == 0x18) {
+      jump_if(mask, opcode, 0xFF, target, next);
+    } else {
+      jump_if(mask, opcode, (opcode >> 3) & 0x03, target, next);
+    }
+    return true;
+  }
+
+  // JP imm16 / JP cond, imm16
+  case 0xC3:
+    jump_if(mask, opcode, 0xFF, imm16, group_pc + 3);
+    return true;
+  case 0xC2:
+  case 0xCA:
+  case 0xD2:
+  case 0xDA:
+    jump_if(mask, opcode, (opcode >> 3) & 0x03, imm16, group_pc + 3);
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+void LockstepBatch::advance(const LaneMask &mask, uint8_t opcode,
+                            uint16_t length) {
+  const uint64_t cost = get_opcode_info(opcode).cycles;
+  for (size_t i = 0; i < lane_count; ++i) {
+    pc[i] = blend(mask[i], static_cast<uint16_t>(pc[i] + length), pc[i]);
+    cycles[i] += cost & static_cast<uint64_t>(static_cast<int8_t>(mask[i]));
+  }
+}
+
+void LockstepBatch::set_r16(const LaneMask &mask, size_t hi, size_t lo,
+                            uint16_t value) {
+  for (size_t i = 0; i < lane_count; ++i) {
+    r8[hi][i] = blend(mask[i], static_cast<uint8_t>(value >> 8), r8[hi][i]);
+    r8[lo][i] = blend(mask[i], static_cast<uint8_t>(value & 0xFF), r8[lo][i]);
+  }
+}
+
+void LockstepBatch::add_r16(const LaneMask &mask, size_t hi, size_t lo,
+                            uint16_t delta) {
+  for (size_t i = 0; i < lane_count; ++i) {
+    const uint16_t value =
+        ((static_cast<uint16_t>(r8[hi][i]) << 8) | r8[lo][i]) + delta;
+    r8[hi][i] = blend(mask[i], static_cast<uint8_t>(value >> 8), r8[hi][i]);
+    r8[lo][i] = blend(mask[i], static_cast<uint8_t>(value & 0xFF), r8[lo][i]);
+  }
+}
+
+// `op` is bits 3-5 of the opcode: ADD, ADC, SUB, SBC, AND, XOR, OR, CP.
+// Each case is a separate loop so that every loop body is branch-free.
+void LockstepBatch::alu(const LaneMask &mask, uint8_t op,
+                        const LaneArray<uint8_t> &src) {
+  LaneArray<uint8_t> &a = r8[reg_a];
+  switch (op) {
+  case 0: // ADD
+  case 1: // ADC
+    for (size_t i = 0; i < lane_count; ++i) {
+      const uint16_t carry = op == 1 ? (f[i] & flag_c) >> 4 : 0;
+      const uint16_t result = a[i] + src[i] + carry;
+      const uint8_t flags =
+          (f[i] & 0x0F) | ((result & 0xFF) == 0 ? flag_z : 0) |
+          ((a[i] & 0x0F) + (src[i] & 0x0F) + carry > 0x0F ? flag_h : 0) |
+          (result > 0xFF ? flag_c : 0);
+      a[i] = blend(mask[i], static_cast<uint8_t>(result), a[i]);
+      f[i] = blend(mask[i], flags, f[i]);
+    }
+    break;
+  case 2: // SUB
+  case 3: // SBC
+  case 7: // CP
+    for (size_t i = 0; i < lane_count; ++i) {
+      const uint16_t carry = op == 3 ? (f[i] & flag_c) >> 4 : 0;
+      const uint16_t result = a[i] - src[i] - carry;
+      const uint8_t flags =
+          (f[i] & 0x0F) | flag_n | ((result & 0xFF) == 0 ? flag_z : 0) |
+          ((a[i] & 0x0F) < (src[i] & 0x0F) + carry ? flag_h : 0) |
+          (result > 0xFF ? flag_c : 0);
+      a[i] = blend(op != 7 ? mask[i] : 0, static_cast<uint8_t>(result), a[i]);
+      f[i] = blend(mask[i], flags, f[i]);
+    }
+    break;
+  case 4: // AND
+  case 5: // XOR
+  case 6: // OR
+    for (size_t i = 0; i < lane_count; ++i) {
+      const uint8_t result = op == 4   ? a[i] & src[i]
+                             : op == 5 ? a[i] ^ src[i]
+                                       : a[i] | src[i];
+      const uint8_t flags = (f[i] & 0x0F) | (result == 0 ? flag_z : 0) |
+                            (op == 4 ? flag_h : 0);
+      a[i] = blend(mask[i], result, a[i]);
+      f[i] = blend(mask[i], flags, f[i]);
+    }
+    break;
+  }
+}
+
+// `condition` is the cc field of the opcode (NZ, Z, NC, C), or 0xFF for an
+// unconditional jump.
+void LockstepBatch::jump_if(const LaneMask &mask, uint8_t opcode,
+                            uint8_t condition, uint16_t taken,
+                            uint16_t not_taken) {
+  const OpcodeInfo &info = get_opcode_info(opcode);
+  const uint8_t flag = (condition & 0x02) != 0 ? flag_c : flag_z;
+  const uint8_t expected = (condition & 0x01) != 0 ? flag : 0;
+  for (size_t i = 0; i < lane_count; ++i) {
+    const bool take = condition == 0xFF || (f[i] & flag) == expected;
+    const uint64_t cost = take ? info.branch_cycles : info.cycles;
+    pc[i] = blend(mask[i], (take ? taken : not_taken), pc[i]);
+    cycles[i] += cost & static_cast<uint64_t>(static_cast<int8_t>(mask[i]));
+  }
+}
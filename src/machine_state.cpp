@@ -0,0 +1,79 @@
+#include "machine_state.hpp"
+
+#include "hash.hpp"
+#include "register.hpp"
+#include "scheduler.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace {
+
+void update_u64(Hasher64 &hasher, uint64_t value) {
+  std::array<uint8_t, 8> bytes;
+  for (size_t i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+  hasher.update(bytes.data(), bytes.size());
+}
+
+} // namespace
+
+uint64_t hash_state(const MachineState &state) {
+  Hasher64 hasher;
+
+  const RegFile &regs = state.regs;
+  const std::array<uint8_t, 12> reg_bytes = {
+      regs.a,
+      regs.f,
+      regs.b,
+      regs.c,
+      regs.d,
+      regs.e,
+      regs.h,
+      regs.l,
+      static_cast<uint8_t>(regs.sp & 0xFF),
+      static_cast<uint8_t>(regs.sp >> 8),
+      static_cast<uint8_t>(regs.pc & 0xFF),
+      static_cast<uint8_t>(regs.pc >> 8),
+  };
+  hasher.update(reg_bytes.data(), reg_bytes.size());
+
+  const std::array<uint8_t, 3> cpu_flags = {state.ime, state.ime_pending,
+                                            state.halted};
+  hasher.update(cpu_flags.data(), cpu_flags.size());
+
+  update_u64(hasher, state.cycles);
+  for (size_t event = 0; event < Scheduler::event_count; ++event) {
+    // Breakpoints, link cable synchronisation and profiling are not guest
+    // state.
+    if (event != static_cast<size_t>(Event::Debug) &&
+        event != static_cast<size_t>(Event::Link) &&
+        event != static_cast<size_t>(Event::Profile)) {
+      update_u64(hasher, state.scheduler.deadlines[event]);
+    }
+  }
+
+  hasher.update(state.wram.data(), state.wram.size());
+  hasher.update(state.io.data(), state.io.size());
+  hasher.update(state.hram.data(), state.hram.size());
+  hasher.update(&state.ie, 1);
+  hasher.update(&state.buttons, 1);
+  const std::array<uint8_t, 3> ppu_state = {state.lcd_on, state.window_line,
+                                            state.stat_line};
+  hasher.update(ppu_state.data(), ppu_state.size());
+  const std::array<uint8_t, 8> dma_state = {
+      state.cgb_mode,
+      state.oam_dma_active,
+      state.hdma_active,
+      state.hdma_blocks,
+      static_cast<uint8_t>(state.hdma_source & 0xFF),
+      static_cast<uint8_t>(state.hdma_source >> 8),
+      static_cast<uint8_t>(state.hdma_dest & 0xFF),
+      static_cast<uint8_t>(state.hdma_dest >> 8),
+  };
+  hasher.update(dma_state.data(), dma_state.size());
+  hasher.update(state.vram.data(), state.vram.size());
+  hasher.update(state.oam.data(), state.oam.size());
+  return hasher.digest();
+}
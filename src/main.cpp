@@ -1,22 +1,725 @@
 #include "cartridge.hpp"
+#include "cheats.hpp"
+#include "control_flow.hpp"
 #include "cpu.hpp"
+#include "disassembler.hpp"
+#include "frame_encoder.hpp"
+#include "gameboy.hpp"
+#include "hash.hpp"
+#include "heatmap.hpp"
+#include "joypad.hpp"
+#include "link_cable.hpp"
+#include "lockstep.hpp"
+#include "metrics.hpp"
 #include "mmu.hpp"
+#include "movie.hpp"
+#include "profiler.hpp"
+#include "symbols.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include "vec_env.hpp"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <print>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+static void print_usage(const char *program) {
+  std::println(stderr,
+               "Usage: {} <rom_path> [--doctor] [--compare <log_path>] "
+               "[--steps <count>]\n"
+               "       {} <rom_path> --disassemble <hex_addr> "
+               "[--steps <count>]\n"
+               "       {} <rom_path> --analyze [--threads <count>]\n"
+               "       {} <rom_path> --play <movie_path> [--fast-forward] "
+               "[--video <path>] [--run-ahead <frames>] [--cheat <code>]... "
+               "[--trace <count>] [<heatmap options>] [<profile options>] "
+               "[<metrics options>]\n"
+               "       {} <rom_path> --record <movie_path> --frames <count> "
+               "[--press <frame>:<buttons>]... [--fast-forward] "
+               "[--video <path>] [--run-ahead <frames>] [--cheat <code>]... "
+               "[--trace <count>] [<heatmap options>] [<profile options>] "
+               "[<metrics options>]\n"
+               "       {} <rom_path> --batch <instances> --frames <count> "
+               "[--threads <count>]\n"
+               "       {} <rom_path> --link <rom_path> --frames <count> "
+               "[--fast-forward]\n"
+               "       {} <rom_path> --lockstep --steps <count>\n"
+               "Heatmap options: --heatmap <csv_or_json_path> "
+               "[--heatmap-frames <count>] [--heatmap-sample <interval>]\n"
+               "Profile options: --profile <report_path> "
+               "[--profile-interval <cycles>] [--sym <sym_path>]\n"
+               "Metrics options: --metrics <jsonl_path_or_-> "
+               "[--metrics-interval <ms>]",
+               program, program, program, program, program, program,
+               program, program);
+}
+
+using FrameHook = std::function<void(uint32_t frame)>;
+
+#ifdef EMUGB_HEATMAP
+// Writes a heatmap file per range of `frame_interval` frames, named
+// "<stem>-<first>-<last><extension>", or a single file at `path` for the
+// whole run if `frame_interval` is 0.
+class HeatmapExport {
+public:
+  HeatmapExport(const std::string &path, uint32_t frame_interval,
+                uint32_t sample_interval)
+      : path(path), frame_interval(frame_interval),
+        heatmap(std::make_unique<Heatmap>(sample_interval)) {}
+
+  Heatmap *get_heatmap() { return heatmap.get(); }
+
+  void after_frame(uint32_t frame) {
+    if (frame_interval != 0 && frame + 1 - first_frame == frame_interval) {
+      flush(frame);
+    }
+  }
+
+  void finish(uint32_t frames) {
+    if (frames > first_frame) {
+      flush(frames - 1);
+    }
+  }
+
+private:
+  std::filesystem::path path;
+  uint32_t frame_interval;
+  std::unique_ptr<Heatmap> heatmap;
+  uint32_t first_frame = 0;
+
+  void flush(uint32_t last_frame) {
+    std::filesystem::path file = path;
+    if (frame_interval != 0) {
+      file.replace_filename(std::format("{}-{}-{}{}", path.stem().string(),
+                                        first_frame, last_frame,
+                                        path.extension().string()));
+    }
+    heatmap->write(file.string(), first_frame, last_frame);
+    heatmap->clear();
+    first_frame = last_frame + 1;
+  }
+};
+#endif
+
+// Parses all of `text` as a number, in hex with an optional "0x" prefix for
+// base 16. Returns false, leaving `value` alone, if it is not a number or
+// does not fit.
+template <typename T>
+static bool parse_number(std::string_view text, T &value, int base = 10) {
+  if (base == 16 && (text.starts_with("0x") || text.starts_with("0X"))) {
+    text.remove_prefix(2);
+  }
+  T parsed;
+  const std::from_chars_result result =
+      std::from_chars(text.data(), text.data() + text.size(), parsed, base);
+  if (result.ec != std::errc{} || result.ptr != text.data() + text.size()) {
+    return false;
+  }
+  value = parsed;
+  return true;
+}
+
+// Parses "<frame>:<button>+<button>..." where an empty button list releases
+// every button, e.g. "120:start" or "300:a+right" or "310:".
+static std::optional<MovieInput> parse_press(std::string_view text) {
+  const size_t colon = text.find(':');
+  if (colon == std::string_view::npos) {
+    return std::nullopt;
+  }
+
+  MovieInput input{0, 0};
+  if (!parse_number(text.substr(0, colon), input.frame)) {
+    return std::nullopt;
+  }
+  std::string_view names = text.substr(colon + 1);
+  while (!names.empty()) {
+    const size_t plus = names.find('+');
+    const std::string_view name = names.substr(0, plus);
+    names = plus == std::string_view::npos ? std::string_view()
+                                           : names.substr(plus + 1);
+
+    constexpr std::pair<std::string_view, Button> buttons[] = {
+        {"right", Button::Right}, {"left", Button::Left},
+        {"up", Button::Up},       {"down", Button::Down},
+        {"a", Button::A},         {"b", Button::B},
+        {"select", Button::Select}, {"start", Button::Start},
+    };
+    bool found = false;
+    for (const auto &[button_name, button] : buttons) {
+      if (name == button_name) {
+        input.buttons |= static_cast<uint8_t>(button);
+        found = true;
+      }
+    }
+    if (!found) {
+      return std::nullopt;
+    }
+  }
+  return input;
+}
+
+static int run_play(GameBoy &gameboy, uint64_t rom_hash,
+                    const std::string &movie_path,
+                    const FrameHook &after_frame) {
+  const std::optional<Movie> movie = Movie::load(movie_path);
+  if (!movie) {
+    return 1;
+  }
+  if (movie->rom_hash != rom_hash) {
+    std::println(stderr, "Warning: movie was recorded with a different ROM");
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const uint64_t state_hash = play_movie(gameboy, *movie, after_frame);
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::println("frames: {}", movie->frame_count);
+  std::println("time: {:.3f} s ({:.1f} fps)", elapsed.count(),
+               movie->frame_count / elapsed.count());
+  std::println("state hash: {:016x}", state_hash);
+  if (state_hash != movie->final_state_hash) {
+    std::println(stderr, "state hash mismatch: movie expects {:016x}",
+                 movie->final_state_hash);
+    return 1;
+  }
+  return 0;
+}
+
+static int run_record(GameBoy &gameboy, uint64_t rom_hash,
+                      const std::string &movie_path, uint32_t frames,
+                      const std::vector<MovieInput> &presses,
+                      const FrameHook &after_frame) {
+  MovieRecorder recorder(rom_hash);
+  uint8_t buttons = 0;
+  size_t next = 0;
+  for (uint32_t frame = 0; frame < frames; ++frame) {
+    while (next < presses.size() && presses[next].frame <= frame) {
+      buttons = presses[next].buttons;
+      ++next;
+    }
+    recorder.record(frame, buttons);
+    gameboy.set_buttons(buttons);
+    gameboy.run_frame();
+    if (after_frame) {
+      after_frame(frame);
+    }
+  }
+
+  const uint64_t state_hash = gameboy.hash_state();
+  if (!recorder.finish(frames, state_hash).save(movie_path)) {
+    return 1;
+  }
+  std::println("state hash: {:016x}", state_hash);
+  return 0;
+}
+
+// Reports the average host cost per frame of running `frames` ahead, which
+// has to stay within a frame (16.7 ms) for interactive use.
+static void print_run_ahead_stats(const RunAheadStats &stats,
+                                  uint32_t frames) {
+  if (stats.frames == 0) {
+    return;
+  }
+  const auto per_frame_us = [&](uint64_t ns) {
+    return static_cast<double>(ns) / static_cast<double>(stats.frames) / 1e3;
+  };
+  const uint64_t total_ns =
+      stats.frame_ns + stats.save_ns + stats.ahead_ns + stats.restore_ns;
+  std::println("run-ahead {}: {:.1f} us per frame (frame {:.1f}, save {:.2f}, "
+               "ahead {:.1f}, restore {:.2f}), worst {:.1f} us",
+               frames, per_frame_us(total_ns), per_frame_us(stats.frame_ns),
+               per_frame_us(stats.save_ns), per_frame_us(stats.ahead_ns),
+               per_frame_us(stats.restore_ns),
+               static_cast<double>(stats.max_total_ns) / 1e3);
+}
+
+// Steps `instance_count` instances one frame at a time with no input and
+// reports the combined throughput.
+static int run_batch(const std::vector<uint8_t> &rom, size_t instance_count,
+                     uint32_t frames, size_t thread_count) {
+  VecEnv env(rom, instance_count, {}, thread_count);
+  const std::vector<uint8_t> actions(instance_count, 0);
+  std::vector<uint8_t> observations(instance_count *
+                                    env.get_observation_size());
+
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t frame = 0; frame < frames; ++frame) {
+    env.step(actions.data(), 1, observations.data());
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  const double total_frames = static_cast<double>(frames) * instance_count;
+  std::println("instances: {}, frames: {}", instance_count, frames);
+  std::println("time: {:.3f} s ({:.1f} fps total)", elapsed.count(),
+               total_frames / elapsed.count());
+  return 0;
+}
+
+// Steps a LockstepBatch and as many plain GameBoy instances `steps` times,
+// each lane holding different buttons, and reports both times and whether
+// every lane ended in the same state as its GameBoy.
+static int run_lockstep(const std::vector<uint8_t> &rom, uint64_t steps) {
+  constexpr size_t lane_count = LockstepBatch::lane_count;
+  LockstepBatch batch(rom);
+  const RomImage image = intern_rom(std::vector<uint8_t>(rom));
+  std::vector<std::unique_ptr<GameBoy>> gameboys;
+  for (size_t lane = 0; lane < lane_count; ++lane) {
+    const auto buttons = static_cast<uint8_t>(lane);
+    batch.get_lane(lane).set_buttons(buttons);
+    gameboys.push_back(
+        std::make_unique<GameBoy>(std::make_unique<RomOnly>(image)));
+    gameboys.back()->set_buttons(buttons);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  batch.run(steps);
+  const std::chrono::duration<double> lockstep_time =
+      std::chrono::steady_clock::now() - start;
+  start = std::chrono::steady_clock::now();
+  for (const std::unique_ptr<GameBoy> &gameboy : gameboys) {
+    for (uint64_t step = 0; step < steps; ++step) {
+      gameboy->step();
+    }
+  }
+  const std::chrono::duration<double> scalar_time =
+      std::chrono::steady_clock::now() - start;
+
+  size_t mismatches = 0;
+  for (size_t lane = 0; lane < lane_count; ++lane) {
+    if (batch.get_lane(lane).hash_state() != gameboys[lane]->hash_state()) {
+      std::println(stderr, "lane {}: state hash mismatch", lane);
+      mismatches += 1;
+    }
+  }
+  const uint64_t vector_steps = batch.get_vector_steps();
+  const uint64_t total_steps = vector_steps + batch.get_scalar_steps();
+  std::println("lanes: {}, steps: {}", lane_count, steps);
+  std::println("lockstep: {:.3f} s, scalar: {:.3f} s ({:.2f}x)",
+               lockstep_time.count(), scalar_time.count(),
+               scalar_time.count() / lockstep_time.count());
+  std::println("vector steps: {} of {} ({:.1f}%)", vector_steps, total_steps,
+               total_steps != 0 ? 100.0 * static_cast<double>(vector_steps) /
+                                      static_cast<double>(total_steps)
+                                : 0.0);
+  std::println("state hashes: {}", mismatches == 0 ? "match" : "differ");
+  return mismatches == 0 ? 0 : 1;
+}
+
+// Runs two instances connected by a link cable, each on its own thread, and
+// reports their throughput and final states.
+static int run_link(std::unique_ptr<Cartridge> first,
+                    std::unique_ptr<Cartridge> second, uint32_t frames,
+                    bool fast_forward) {
+  GameBoy gameboys[] = {GameBoy(std::move(first)), GameBoy(std::move(second))};
+  for (GameBoy &gameboy : gameboys) {
+    gameboy.set_fast_forward({.enabled = fast_forward});
+  }
+  LinkCable cable(gameboys[0], gameboys[1]);
+
+  const auto start = std::chrono::steady_clock::now();
+  cable.run_frames(frames);
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  std::println("frames: {}", frames);
+  std::println("time: {:.3f} s ({:.1f} fps per instance)", elapsed.count(),
+               frames / elapsed.count());
+  for (const GameBoy &gameboy : gameboys) {
+    std::println("state hash: {:016x}", gameboy.hash_state());
+  }
+  return 0;
+}
+
+// Prints `count` instructions starting at `addr` as the ROM maps them at
+// power-on, one "<addr>: <bytes> <disassembly>" line each.
+static int run_disassemble(const MMU &mmu, uint16_t addr, uint64_t count) {
+  for (uint64_t i = 0; i < count; ++i) {
+    const InstructionBytes bytes = read_instruction(mmu, addr);
+    const uint8_t length = decode(bytes).length;
+    std::string hex;
+    for (uint8_t j = 0; j < length; ++j) {
+      std::format_to(std::back_inserter(hex), "{:02X} ", bytes[j]);
+    }
+    std::println("{:04X}: {:<9} {}", addr, hex, disassemble(addr, bytes));
+    addr = static_cast<uint16_t>(addr + length);
+  }
+  return 0;
+}
+
+// Builds the control-flow graph of the ROM, or takes it from the cache next
+// to the ROM, and reports its size.
+static int run_analyze(const std::vector<uint8_t> &rom,
+                       const std::string &rom_path, size_t thread_count) {
+  ThreadPool pool(thread_count);
+  const std::string cache_path = get_cfg_cache_path(rom_path);
+  bool cache_hit = false;
+  const auto start = std::chrono::steady_clock::now();
+  const ControlFlowGraph graph =
+      ControlFlowGraph::load_or_analyze(rom, cache_path, pool, &cache_hit);
+  const std::chrono::duration<double, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  size_t banks = 0;
+  uint16_t last_bank = 0;
+  for (const BasicBlock &block : graph.get_blocks()) {
+    if (banks == 0 || block.start.bank != last_bank) {
+      banks += 1;
+      last_bank = block.start.bank;
+    }
+  }
+  std::println("blocks: {}, instructions: {}, banks with code: {}",
+               graph.get_blocks().size(), graph.get_instruction_count(), banks);
+  std::println("time: {:.3f} ms ({} {})", elapsed.count(),
+               cache_hit ? "loaded from" : "saved to", cache_path);
+  return 0;
+}
+
+static int run_doctor(CPU &cpu, uint64_t steps,
+                      const std::optional<std::string> &compare_path) {
+  cpu.log_instructions = false;
+  cpu.regFile.reset_post_boot();
+  // Gameboy Doctor logs are taken with LY stubbed to 0x90 (VBlank); the
+  // doctor run has no PPU to change it.
+  cpu.memory.get_state().io[0x44] = 0x90;
+
+  std::optional<TraceComparator> comparator;
+  if (compare_path) {
+    comparator.emplace(*compare_path);
+    if (!comparator->is_open()) {
+      return 1;
+    }
+  }
+
+  std::string line;
+  for (uint64_t i = 0; i < steps; ++i) {
+    line.clear();
+    append_doctor_line(line, cpu.regFile, cpu.memory);
+    if (comparator) {
+      if (comparator->stopped()) {
+        break;
+      }
+      comparator->submit(line);
+    } else {
+      std::fputs(line.c_str(), stdout);
+    }
+    cpu.execute();
+  }
+
+  if (!comparator) {
+    return 0;
+  }
+
+  const TraceMismatch *mismatch = comparator->finish();
+  if (mismatch == nullptr) {
+    std::println("trace matches reference");
+    return 0;
+  }
+
+  std::println(stderr, "trace mismatch at line {}", mismatch->line);
+  for (const std::string &context : mismatch->context) {
+    std::println(stderr, "  {}", context);
+  }
+  std::println(stderr, "expected: {}", mismatch->expected);
+  std::println(stderr, "actual:   {}", mismatch->actual);
+  return 1;
+}
 
 int main(int argc, char *argv[]) {
   if (argc < 2) {
-    std::println(stderr, "Usage: {} <rom_path>", argv[0]);
+    print_usage(argv[0]);
     return 1;
   }
 
+  bool doctor = false;
+  std::optional<std::string> compare_path;
+  std::optional<uint64_t> steps;
+  std::optional<std::string> play_path;
+  std::optional<std::string> record_path;
+  uint32_t frames = 0;
+  std::vector<MovieInput> presses;
+  Cheats cheats;
+  bool fast_forward = false;
+  std::optional<size_t> batch;
+  std::optional<std::string> link_path;
+  bool lockstep = false;
+  size_t threads = 0;
+  std::optional<std::string> video_path;
+  std::optional<uint16_t> disassemble_addr;
+  bool analyze = false;
+  size_t trace_count = 0;
+  std::optional<std::string> heatmap_path;
+  // Parsed in every build so that --heatmap gets its error message below.
+  [[maybe_unused]] uint32_t heatmap_frames = 0;
+  [[maybe_unused]] uint32_t heatmap_sample = 1;
+  std::optional<std::string> profile_path;
+  uint64_t profile_interval = 1024;
+  std::optional<std::string> sym_path;
+  std::optional<std::string> metrics_path;
+  uint64_t metrics_interval = 1000;
+  uint32_t run_ahead = 0;
+  for (int i = 2; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    // Cleared by options whose value is not a valid number.
+    bool valid = true;
+    if (arg == "--doctor") {
+      doctor = true;
+    } else if (arg == "--compare" && i + 1 < argc) {
+      doctor = true;
+      compare_path = argv[++i];
+    } else if (arg == "--steps" && i + 1 < argc) {
+      valid = parse_number(argv[++i], steps.emplace());
+    } else if (arg == "--play" && i + 1 < argc) {
+      play_path = argv[++i];
+    } else if (arg == "--record" && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (arg == "--frames" && i + 1 < argc) {
+      valid = parse_number(argv[++i], frames);
+    } else if (arg == "--press" && i + 1 < argc) {
+      const std::optional<MovieInput> press = parse_press(argv[++i]);
+      if (!press) {
+        print_usage(argv[0]);
+        return 1;
+      }
+      presses.push_back(*press);
+    } else if (arg == "--cheat" && i + 1 < argc) {
+      if (!cheats.add(argv[++i])) {
+        std::println(stderr, "Error: Invalid cheat code {}", argv[i]);
+        return 1;
+      }
+    } else if (arg == "--fast-forward") {
+      fast_forward = true;
+    } else if (arg == "--batch" && i + 1 < argc) {
+      valid = parse_number(argv[++i], batch.emplace());
+    } else if (arg == "--link" && i + 1 < argc) {
+      link_path = argv[++i];
+    } else if (arg == "--lockstep") {
+      lockstep = true;
+    } else if (arg == "--threads" && i + 1 < argc) {
+      valid = parse_number(argv[++i], threads);
+    } else if (arg == "--video" && i + 1 < argc) {
+      video_path = argv[++i];
+    } else if (arg == "--run-ahead" && i + 1 < argc) {
+      valid = parse_number(argv[++i], run_ahead);
+    } else if (arg == "--disassemble" && i + 1 < argc) {
+      valid = parse_number(argv[++i], disassemble_addr.emplace(), 16);
+    } else if (arg == "--analyze") {
+      analyze = true;
+    } else if (arg == "--trace" && i + 1 < argc) {
+      valid = parse_number(argv[++i], trace_count);
+    } else if (arg == "--heatmap" && i + 1 < argc) {
+      heatmap_path = argv[++i];
+    } else if (arg == "--heatmap-frames" && i + 1 < argc) {
+      valid = parse_number(argv[++i], heatmap_frames);
+    } else if (arg == "--heatmap-sample" && i + 1 < argc) {
+      valid = parse_number(argv[++i], heatmap_sample);
+    } else if (arg == "--profile" && i + 1 < argc) {
+      profile_path = argv[++i];
+    } else if (arg == "--profile-interval" && i + 1 < argc) {
+      valid = parse_number(argv[++i], profile_interval);
+    } else if (arg == "--sym" && i + 1 < argc) {
+      sym_path = argv[++i];
+    } else if (arg == "--metrics" && i + 1 < argc) {
+      metrics_path = argv[++i];
+    } else if (arg == "--metrics-interval" && i + 1 < argc) {
+      valid = parse_number(argv[++i], metrics_interval);
+    } else {
+      valid = false;
+    }
+    if (!valid) {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+
   const char *rom_path = argv[1];
-  std::unique_ptr<Cartridge> cartridge = load_from_path(rom_path);
+  LoadResult loaded = load_from_path(rom_path);
+  if (!loaded) {
+    std::println(stderr, "Error: {}: {}", to_string(loaded.error()), rom_path);
+    return 1;
+  }
+  std::unique_ptr<Cartridge> cartridge = std::move(*loaded);
+  if (analyze) {
+    return run_analyze(cartridge->get_rom(), rom_path, threads);
+  }
+  if (batch) {
+    return run_batch(cartridge->get_rom(), *batch, frames, threads);
+  }
+  if (lockstep) {
+    return run_lockstep(cartridge->get_rom(), steps.value_or(1'000'000));
+  }
+  if (link_path) {
+    LoadResult other = load_from_path(*link_path);
+    if (!other) {
+      std::println(stderr, "Error: {}: {}", to_string(other.error()),
+                   *link_path);
+      return 1;
+    }
+    return run_link(std::move(cartridge), std::move(*other), frames,
+                    fast_forward);
+  }
+  if (play_path || record_path) {
+    const std::vector<uint8_t> &rom = cartridge->get_rom();
+    const uint64_t rom_hash = hash64(rom.data(), rom.size());
+    GameBoy gameboy(std::move(cartridge));
+    gameboy.set_fast_forward({.enabled = fast_forward});
+    gameboy.set_run_ahead(run_ahead);
+    gameboy.set_cheats(cheats);
+
+    std::unique_ptr<FrameEncoder> video;
+    if (video_path) {
+      if (fast_forward) {
+        std::println(stderr, "Error: --video needs every frame drawn");
+        return 1;
+      }
+      video = FrameEncoder::open(*video_path);
+      if (!video) {
+        return 1;
+      }
+    }
+
+#ifdef EMUGB_HEATMAP
+    std::optional<HeatmapExport> heatmap;
+    if (heatmap_path) {
+      heatmap.emplace(*heatmap_path, heatmap_frames, heatmap_sample);
+      gameboy.mmu.set_heatmap(heatmap->get_heatmap());
+    }
+#else
+    if (heatmap_path) {
+      std::println(stderr, "Error: built without EMUGB_HEATMAP");
+      return 1;
+    }
+#endif
+
+    // Keeps the last instructions for printing at the end of the run.
+    std::optional<InstructionTrace> trace;
+    if (trace_count != 0) {
+      trace.emplace(trace_count);
+      gameboy.cpu.trace = &*trace;
+    }
+
+    // Symbols are only needed for the report, but a missing file is better
+    // reported before the run.
+    std::optional<Profiler> profiler;
+    std::optional<SymbolTable> symbols;
+    if (profile_path) {
+      symbols = SymbolTable::load(sym_path.value_or(get_sym_path(rom_path)));
+      if (!symbols && sym_path) {
+        std::println(stderr, "Error: Could not read symbols from {}",
+                     *sym_path);
+        return 1;
+      }
+      if (!symbols) {
+        symbols.emplace();
+      }
+      profiler.emplace(profile_interval);
+      gameboy.set_profiler(&*profiler);
+    }
+
+    std::unique_ptr<MetricsExporter> metrics;
+    if (metrics_path) {
+      metrics = MetricsExporter::open(
+          *metrics_path, std::chrono::milliseconds(metrics_interval));
+      if (!metrics) {
+        return 1;
+      }
+    }
+
+    FrameHook after_frame;
+    if (video || heatmap_path || metrics) {
+      after_frame = [&](uint32_t frame) {
+        if (video && gameboy.is_screen_unchanged()) {
+          video->repeat();
+        } else if (video) {
+          video->submit(frame, gameboy.ppu.get_framebuffer());
+        }
+        if (metrics) {
+          metrics->publish(gameboy.get_counters());
+        }
+#ifdef EMUGB_HEATMAP
+        if (heatmap) {
+          heatmap->after_frame(frame);
+        }
+#endif
+      };
+    }
+
+    int result;
+    if (play_path) {
+      result = run_play(gameboy, rom_hash, *play_path, after_frame);
+    } else {
+      std::ranges::stable_sort(presses, {}, &MovieInput::frame);
+      result = run_record(gameboy, rom_hash, *record_path, frames, presses,
+                          after_frame);
+    }
+#ifdef EMUGB_HEATMAP
+    if (heatmap) {
+      heatmap->finish(static_cast<uint32_t>(gameboy.get_frame()));
+    }
+#endif
+    if (metrics) {
+      metrics->publish(gameboy.get_counters());
+      metrics->finish();
+    }
+    if (run_ahead != 0) {
+      print_run_ahead_stats(gameboy.get_run_ahead_stats(), run_ahead);
+    }
+    if (profiler) {
+      std::println("profile: {} samples, {} symbols",
+                   profiler->get_sample_count(), symbols->size());
+      if (!profiler->write(*profile_path, *symbols)) {
+        result = 1;
+      }
+    }
+    if (trace) {
+      std::println("last {} of {} instructions:",
+                   trace->get_entries().size(), trace->get_recorded());
+      std::fputs(trace->format().c_str(), stdout);
+    }
+    if (video) {
+      video->finish();
+      const FrameEncoder::Stats stats = video->get_stats();
+      std::println("video: {} frames encoded, {} repeated, {} dropped",
+                   stats.encoded, stats.repeated, stats.dropped);
+      if (!video->is_ok()) {
+        result = 1;
+      }
+    }
+    return result;
+  }
+
+  if (disassemble_addr) {
+    const MMU mmu(std::move(cartridge));
+    return run_disassemble(mmu, *disassemble_addr, steps.value_or(10));
+  }
+
+  if (doctor) {
+    MMU mmu(std::move(cartridge));
+    CPU cpu(mmu);
+    return run_doctor(cpu, steps.value_or(std::numeric_limits<uint64_t>::max()),
+                      compare_path);
+  }
+
   std::println("title: {}", cartridge->get_title());
   MMU mmu(std::move(cartridge));
   CPU cpu(mmu);
   cpu.regFile.pc = 0x150;
-  for (size_t i = 0; i < 10; ++i) {
+  for (size_t i = 0; i < steps.value_or(10); ++i) {
     cpu.execute();
   }
   return 0;
@@ -0,0 +1,127 @@
+#include "metrics.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <print>
+#include <string>
+#include <thread>
+
+namespace {
+
+constexpr double cycles_per_second = 4194304.0;
+
+uint64_t since(uint64_t now, uint64_t before) {
+  // Counters taken from the machine state go back when a snapshot is loaded.
+  return now > before ? now - before : 0;
+}
+
+double ratio(double numerator, double denominator) {
+  return denominator > 0 ? numerator / denominator : 0.0;
+}
+
+} // namespace
+
+std::unique_ptr<MetricsExporter>
+MetricsExporter::open(const std::string &path,
+                      std::chrono::milliseconds interval) {
+  std::FILE *file = stdout;
+  if (path != "-") {
+    file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+      std::println(stderr, "Error: Could not open file {}", path);
+      return nullptr;
+    }
+  }
+  std::unique_ptr<MetricsExporter> exporter(
+      new MetricsExporter(file, path != "-", interval));
+  exporter->thread = std::thread(&MetricsExporter::run, exporter.get());
+  return exporter;
+}
+
+MetricsExporter::MetricsExporter(std::FILE *file, bool owns_file,
+                                 std::chrono::milliseconds interval)
+    : file(file), owns_file(owns_file), interval(interval),
+      start(std::chrono::steady_clock::now()) {}
+
+MetricsExporter::~MetricsExporter() { finish(); }
+
+void MetricsExporter::finish() {
+  {
+    const std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  cv.notify_one();
+  if (thread.joinable()) {
+    thread.join();
+    if (owns_file) {
+      std::fclose(file);
+    } else {
+      std::fflush(file);
+    }
+  }
+}
+
+void MetricsExporter::publish(const PerfCounters &counters) {
+  Sample &sample = samples.get_back();
+  sample.host_ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+  sample.counters = counters;
+  samples.publish();
+}
+
+void MetricsExporter::run() {
+  std::unique_lock lock(mutex);
+  for (;;) {
+    const bool stop = cv.wait_for(lock, interval, [&] { return stopping; });
+    lock.unlock();
+    write_line();
+    lock.lock();
+    if (stop) {
+      return;
+    }
+  }
+}
+
+void MetricsExporter::write_line() {
+  if (const Sample *sample = samples.try_take()) {
+    latest = *sample;
+  }
+  const PerfCounters &now = latest.counters;
+  const PerfCounters &before = previous.counters;
+  const double host_ns = static_cast<double>(latest.host_ns - previous.host_ns);
+  const double instructions =
+      static_cast<double>(since(now.instructions, before.instructions));
+  const double cycles = static_cast<double>(since(now.cycles, before.cycles));
+  const double frames = static_cast<double>(since(now.frames, before.frames));
+  const double halted =
+      static_cast<double>(since(now.halted_cycles, before.halted_cycles));
+  const double lookups =
+      static_cast<double>(since(now.block_lookups, before.block_lookups));
+  const double hits =
+      static_cast<double>(since(now.block_hits, before.block_hits));
+  previous = latest;
+
+  const double time = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+  const std::string line = std::format(
+      "{{\"time\":{:.3f},\"instructions\":{},\"cycles\":{},\"frames\":{},"
+      "\"halted_cycles\":{},\"block_lookups\":{},\"block_hits\":{},"
+      "\"dma_bytes\":{},\"mips\":{:.3f},\"fps\":{:.1f},"
+      "\"cycles_per_ns\":{:.4f},\"speed\":{:.3f},\"halted_share\":{:.4f},"
+      "\"block_hit_rate\":{:.4f}}}\n",
+      time, now.instructions, now.cycles, now.frames, now.halted_cycles,
+      now.block_lookups, now.block_hits, now.dma_bytes,
+      ratio(instructions * 1e3, host_ns), ratio(frames * 1e9, host_ns),
+      ratio(cycles, host_ns),
+      ratio(cycles * 1e9 / cycles_per_second, host_ns), ratio(halted, cycles),
+      ratio(hits, lookups));
+  std::fputs(line.c_str(), file);
+  std::fflush(file);
+}
@@ -1,59 +1,424 @@
 #include "mmu.hpp"
 
 #include "cartridge.hpp"
+#include "cheats.hpp"
+#include "joypad.hpp"
+#include "link_cable.hpp"
+#include "machine_state.hpp"
 #include "memory.hpp"
+#include "scheduler.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <utility>
 
-uint8_t MMU::get_byte(uint16_t addr) const {
+namespace {
+
+constexpr size_t oam_size = 0xA0;
+// OAM DMA copies one byte per M-cycle.
+constexpr uint64_t oam_dma_cycles = oam_size * 4;
+constexpr size_t hdma_block_size = 0x10;
+// The CPU is stalled for 8 M-cycles per block (single speed).
+constexpr uint64_t hdma_block_cycles = 32;
+// 8 bits at 8192 Hz.
+constexpr uint64_t serial_transfer_cycles = 4096;
+
+} // namespace
+
+MMU::MMU(std::unique_ptr<Cartridge> cartridge)
+    : state{}, cartridge(std::move(cartridge)) {
+  // No joypad group selected.
+  state.io[0x00] = 0x30;
+  map_pages();
+}
+
+void MMU::set_buttons(uint8_t buttons) {
+  const uint8_t before = read_joypad(state.io[0x00], state.buttons);
+  state.buttons = buttons;
+  const uint8_t after = read_joypad(state.io[0x00], state.buttons);
+  // A selected line going from high to low requests the joypad interrupt.
+  if ((before & ~after & 0x0F) != 0) {
+    state.io[0x0F] |= 0x10;
+  }
+}
+
+void MMU::load_state(const MachineState &snapshot) {
+  state = snapshot;
+  // The snapshot may come from another MMU; point the page table back at
+  // this instance's memory.
+  map_pages();
+}
+
+void MMU::load_state(const void *snapshot) {
+  std::memcpy(&state, snapshot, sizeof(state));
+  map_pages();
+}
+
+void MMU::add_trap(Access access, uint16_t addr) {
+  if (traps == nullptr) {
+    traps = std::make_unique<Traps>(state);
+  }
+  const uint8_t before = traps->flags[addr];
+  const uint8_t after = before | static_cast<uint8_t>(access);
+  const size_t page = addr >> MachineState::page_shift;
+  constexpr uint8_t read_bits = static_cast<uint8_t>(Access::Read) |
+                                static_cast<uint8_t>(Access::Execute);
+  constexpr uint8_t write_bits = static_cast<uint8_t>(Access::Write);
+  traps->read_counts[page] +=
+      (after & read_bits) != 0 && (before & read_bits) == 0;
+  traps->write_counts[page] +=
+      (after & write_bits) != 0 && (before & write_bits) == 0;
+  traps->flags[addr] = after;
+  map_pages();
+}
+
+void MMU::remove_trap(Access access, uint16_t addr) {
+  if (traps == nullptr) {
+    return;
+  }
+  const uint8_t before = traps->flags[addr];
+  const uint8_t after = before & ~static_cast<uint8_t>(access);
+  const size_t page = addr >> MachineState::page_shift;
+  constexpr uint8_t read_bits = static_cast<uint8_t>(Access::Read) |
+                                static_cast<uint8_t>(Access::Execute);
+  constexpr uint8_t write_bits = static_cast<uint8_t>(Access::Write);
+  traps->read_counts[page] -=
+      (before & read_bits) != 0 && (after & read_bits) == 0;
+  traps->write_counts[page] -=
+      (before & write_bits) != 0 && (after & write_bits) == 0;
+  traps->flags[addr] = after;
+  map_pages();
+}
+
+void MMU::clear_traps() {
+  traps.reset();
+  map_pages();
+}
+
+void MMU::set_rom_patches(std::span<const RomPatch> patches) {
+  patched_rom.reset();
+  for (const RomPatch &patch : patches) {
+    // Compare against the ROM itself, not an earlier patch.
+    if (patch.compare && cartridge->get_byte(patch.addr) != *patch.compare) {
+      continue;
+    }
+    if (patched_rom == nullptr) {
+      patched_rom = std::make_unique<RomPages>();
+    }
+    const size_t index = patch.addr >> MachineState::page_shift;
+    std::unique_ptr<uint8_t[]> &page = (*patched_rom)[index];
+    if (page == nullptr) {
+      page = std::make_unique<uint8_t[]>(MachineState::page_size);
+      const uint16_t start =
+          static_cast<uint16_t>(index << MachineState::page_shift);
+      for (size_t i = 0; i < MachineState::page_size; ++i) {
+        page[i] = cartridge->get_byte(static_cast<uint16_t>(start + i));
+      }
+    }
+    page[patch.addr & (MachineState::page_size - 1)] = patch.value;
+  }
+  map_pages();
+}
+
+std::optional<TrapHit> MMU::take_trap_hit() {
+  if (traps == nullptr) {
+    return std::nullopt;
+  }
+  return std::exchange(traps->hit, std::nullopt);
+}
+
+void MMU::Traps::record(Access access, uint16_t addr, uint8_t value) {
+  if (!hit) {
+    hit = TrapHit{access, addr, value};
+  }
+  state.scheduler.schedule(Event::Debug, state.cycles);
+}
+
+// Builds the page table. Pages whose accesses have side effects or depend on
+// the cartridge controller stay nullptr and are served by the slow path.
+void MMU::map_pages() {
+  state.read_pages.fill(nullptr);
+  state.write_pages.fill(nullptr);
+
+  for (uint16_t addr = 0x0000; addr < 0x8000;
+       addr += MachineState::page_size) {
+    // ROM; writes go to the cartridge controller.
+    state.read_pages[addr >> MachineState::page_shift] =
+        cartridge->get_rom_page(addr);
+  }
+  if (patched_rom != nullptr) {
+    for (size_t page = 0; page < rom_page_count; ++page) {
+      if ((*patched_rom)[page] != nullptr) {
+        state.read_pages[page] = (*patched_rom)[page].get();
+      }
+    }
+  }
+
+  // VRAM
+  state.read_pages[0x8] = state.vram.data();
+  state.write_pages[0x8] = state.vram.data();
+  state.read_pages[0x9] = state.vram.data() + 0x1000;
+  state.write_pages[0x9] = state.vram.data() + 0x1000;
+
+  // WRAM, and the first page of its echo at 0xE000
+  state.read_pages[0xC] = state.wram.data();
+  state.write_pages[0xC] = state.wram.data();
+  state.read_pages[0xD] = state.wram.data() + 0x1000;
+  state.write_pages[0xD] = state.wram.data() + 0x1000;
+  state.read_pages[0xE] = state.wram.data();
+  state.write_pages[0xE] = state.wram.data();
+
+  if (traps != nullptr) {
+    for (size_t page = 0; page < MachineState::page_count; ++page) {
+      if (traps->read_counts[page] != 0) {
+        state.read_pages[page] = nullptr;
+      }
+      if (traps->write_counts[page] != 0) {
+        state.write_pages[page] = nullptr;
+      }
+    }
+  }
+}
+
+// Copies `size` bytes starting at `src`, which must not cross a page. DMA
+// reads neither trip breakpoints nor reach cartridge registers, so plain
+// pages are copied in bulk straight from the page table.
+void MMU::copy_block(uint16_t src, uint8_t *dst, size_t size) const {
+  const uint8_t *page = state.read_pages[src >> MachineState::page_shift];
+  if (page != nullptr) {
+    std::memcpy(dst, page + (src & (MachineState::page_size - 1)), size);
+    return;
+  }
+  for (size_t i = 0; i < size; ++i) {
+    dst[i] = read_unmapped(static_cast<uint16_t>(src + i));
+  }
+}
+
+void MMU::start_oam_dma(uint8_t value) {
+  state.io[0x46] = value;
+  // Sources from 0xE000 up read the echo of WRAM.
+  const uint8_t source = value >= 0xE0 ? value - 0x20 : value;
+  copy_block(static_cast<uint16_t>(source << 8), state.oam.data(), oam_size);
+  dma_bytes += oam_size;
+  state.oam_dma_active = true;
+  state.scheduler.schedule(Event::OamDma, state.cycles + oam_dma_cycles);
+}
+
+void MMU::start_hdma(uint8_t value) {
+  const uint8_t blocks = (value & 0x7F) + 1;
+  if (state.hdma_active) {
+    // Writing with bit 7 clear stops a running HBlank DMA.
+    if ((value & 0x80) == 0) {
+      state.hdma_active = false;
+      state.io[0x55] = 0x80 | (state.hdma_blocks - 1);
+      state.scheduler.cancel(Event::Hdma);
+    }
+    return;
+  }
+
+  state.hdma_source = ((state.io[0x51] << 8) | state.io[0x52]) & 0xFFF0;
+  state.hdma_dest = ((state.io[0x53] << 8) | state.io[0x54]) & 0x1FF0;
+  state.hdma_blocks = blocks;
+  if ((value & 0x80) != 0) {
+    state.hdma_active = true;
+    state.io[0x55] = value & 0x7F;
+    // Started during HBlank, the first block goes right away.
+    if ((state.io[0x41] & 0x03) == 0 && state.lcd_on) {
+      state.scheduler.schedule(Event::Hdma, state.cycles);
+    }
+    return;
+  }
+
+  // General-purpose DMA: everything now, with the CPU stalled meanwhile.
+  while (state.hdma_blocks != 0) {
+    copy_block(state.hdma_source, state.vram.data() + state.hdma_dest,
+               hdma_block_size);
+    state.hdma_source += hdma_block_size;
+    state.hdma_dest = (state.hdma_dest + hdma_block_size) & 0x1FF0;
+    state.hdma_blocks -= 1;
+  }
+  state.cycles += blocks * hdma_block_cycles;
+  dma_bytes += blocks * hdma_block_size;
+  state.io[0x55] = 0xFF;
+}
+
+void MMU::run_hdma_block() {
+  if (!state.hdma_active) {
+    return;
+  }
+  copy_block(state.hdma_source, state.vram.data() + state.hdma_dest,
+             hdma_block_size);
+  state.hdma_source += hdma_block_size;
+  state.hdma_dest = (state.hdma_dest + hdma_block_size) & 0x1FF0;
+  state.hdma_blocks -= 1;
+  state.cycles += hdma_block_cycles;
+  dma_bytes += hdma_block_size;
+  state.hdma_active = state.hdma_blocks != 0;
+  state.io[0x55] = state.hdma_active ? state.hdma_blocks - 1 : 0xFF;
+}
+
+void MMU::write_serial_control(uint8_t value) {
+  const bool running = (state.io[0x02] & 0x81) == 0x81;
+  // The unused bits read as 1.
+  state.io[0x02] = value | 0x7E;
+  if ((value & 0x81) != 0x81 || running) {
+    return;
+  }
+  if (link != nullptr) {
+    link->start_transfer();
+  } else {
+    state.scheduler.schedule(Event::Serial,
+                             state.cycles + serial_transfer_cycles);
+  }
+}
+
+void MMU::set_link(LinkPort *port) {
+  link = port;
+  if (port != nullptr) {
+    return;
+  }
+  state.scheduler.cancel(Event::Link);
+  // A transfer left on the cable completes as if nothing were connected.
+  if ((state.io[0x02] & 0x81) == 0x81 &&
+      state.scheduler.get_deadline(Event::Serial) == Scheduler::never) {
+    state.scheduler.schedule(Event::Serial, state.cycles);
+  }
+}
+
+void MMU::sync_link() { link->sync(); }
+
+void MMU::complete_serial_transfer(uint8_t received) {
+  state.io[0x01] = received;
+  state.io[0x02] &= 0x7F;
+  state.io[0x0F] |= 0x08;
+}
+
+uint8_t MMU::get_byte_slow(uint16_t addr) const {
+  const uint8_t value = read_unmapped(addr);
+  if (traps != nullptr && traps->has(Access::Read, addr)) [[unlikely]] {
+    traps->record(Access::Read, addr, value);
+  }
+  return value;
+}
+
+bool MMU::fetch_opcode_slow(uint16_t addr, uint8_t &opcode) {
+  if (traps != nullptr && traps->has(Access::Execute, addr)) [[unlikely]] {
+    if (traps->resume_addr != addr) {
+      traps->resume_addr = addr;
+      traps->record(Access::Execute, addr, read_unmapped(addr));
+      return false;
+    }
+    traps->resume_addr.reset();
+  }
+  opcode = get_byte_slow(addr);
+  return true;
+}
+
+uint8_t MMU::read_unmapped(uint16_t addr) const {
   if (0x0000 <= addr && addr <= 0x7fff) {
     // ROM
+    if (patched_rom != nullptr) [[unlikely]] {
+      const uint8_t *page =
+          (*patched_rom)[addr >> MachineState::page_shift].get();
+      if (page != nullptr) {
+        return page[addr & (MachineState::page_size - 1)];
+      }
+    }
     return cartridge->get_byte(addr);
   } else if (0x8000 <= addr && addr <= 0x9fff) {
-    // VRAM (not implemented)
-    return 0;
+    // VRAM
+    return state.vram[addr - 0x8000];
   } else if (0xa000 <= addr && addr <= 0xbfff) {
     // External RAM
     return cartridge->get_byte(addr);
   } else if (0xc000 <= addr && addr <= 0xdfff) {
-    // WRAM (not implemented)
-    return 0;
+    // WRAM
+    return state.wram[addr - 0xc000];
   } else if (0xe000 <= addr && addr <= 0xfdff) {
-    // Echo RAM (not implemented)
-    return 0;
+    // Echo RAM
+    return state.wram[addr - 0xe000];
   } else if (0xfe00 <= addr && addr <= 0xfe9f) {
-    // OAM (not implemented)
+    // OAM; the bus is taken while OAM DMA runs.
+    return state.oam_dma_active ? 0xff : state.oam[addr - 0xfe00];
+  } else if (0xfea0 <= addr && addr <= 0xfeff) {
+    // Not usable
     return 0;
+  } else if (addr == 0xff00) {
+    // Joypad
+    return read_joypad(state.io[0x00], state.buttons);
+  } else if (addr == 0xff0f) {
+    // Interrupt Flag; the upper bits are unused and read as 1.
+    return state.io[0x0f] | 0xe0;
   } else if (0xff00 <= addr && addr <= 0xff7f) {
-    // I/O Registers (not implemented)
-    return 0;
+    // I/O Registers
+    return state.io[addr - 0xff00];
   } else if (0xff80 <= addr && addr <= 0xfffe) {
-    // HRAM (not implemented)
-    return 0;
+    // HRAM
+    return state.hram[addr - 0xff80];
   } else if (addr == 0xffff) {
-    // Interrupt Enable Register (not implemented)
-    return 0;
+    // Interrupt Enable Register
+    return state.ie;
   }
   std::unreachable();
 }
 
-void MMU::set_byte(uint16_t addr, uint8_t value) {
+void MMU::set_byte_slow(uint16_t addr, uint8_t value) {
+  if (traps != nullptr && traps->has(Access::Write, addr)) [[unlikely]] {
+    traps->record(Access::Write, addr, value);
+  }
+  write_unmapped(addr, value);
+}
+
+void MMU::write_unmapped(uint16_t addr, uint8_t value) {
   if (0x0000 <= addr && addr <= 0x7fff) {
     // ROM
     cartridge->set_byte(addr, value);
   } else if (0x8000 <= addr && addr <= 0x9fff) {
-    // VRAM (not implemented)
+    // VRAM
+    state.vram[addr - 0x8000] = value;
   } else if (0xa000 <= addr && addr <= 0xbfff) {
     cartridge->set_byte(addr, value);
   } else if (0xc000 <= addr && addr <= 0xdfff) {
-    // WRAM (not implemented)
+    // WRAM
+    state.wram[addr - 0xc000] = value;
   } else if (0xe000 <= addr && addr <= 0xfdff) {
-    // Echo RAM (not implemented)
+    // Echo RAM
+    state.wram[addr - 0xe000] = value;
   } else if (0xfe00 <= addr && addr <= 0xfe9f) {
-    // OAM (not implemented)
+    // OAM
+    if (!state.oam_dma_active) {
+      state.oam[addr - 0xfe00] = value;
+    }
+  } else if (0xfea0 <= addr && addr <= 0xfeff) {
+    // Not usable
+  } else if (addr == 0xff00) {
+    // Joypad; only the group select bits are writable.
+    state.io[0x00] = value & 0x30;
+  } else if (addr == 0xff02) {
+    // SC
+    write_serial_control(value);
+  } else if (addr == 0xff41) {
+    // STAT; the mode and coincidence bits belong to the PPU.
+    state.io[0x41] = (state.io[0x41] & 0x07) | (value & 0x78);
+  } else if (addr == 0xff44) {
+    // LY is read-only.
+  } else if (addr == 0xff46) {
+    // OAM DMA
+    start_oam_dma(value);
+  } else if (addr == 0xff55 && state.cgb_mode) {
+    // HDMA5: start or stop a VRAM DMA.
+    start_hdma(value);
   } else if (0xff00 <= addr && addr <= 0xff7f) {
-    // I/O Registers (not implemented)
+    // I/O Registers
+    state.io[addr - 0xff00] = value;
   } else if (0xff80 <= addr && addr <= 0xfffe) {
-    // HRAM (not implemented)
+    // HRAM
+    state.hram[addr - 0xff80] = value;
   } else if (addr == 0xffff) {
-    // Interrupt Enable Register (not implemented)
+    // Interrupt Enable Register
+    state.ie = value;
   }
 }
@@ -0,0 +1,167 @@
+#include "movie.hpp"
+
+#include "gameboy.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr std::string_view magic = "EMUGBMOV";
+
+void put_le(std::vector<uint8_t> &out, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; ++i) {
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+void put_varint(std::vector<uint8_t> &out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+class Reader {
+public:
+  Reader(const std::vector<uint8_t> &data) : data(data) {}
+
+  bool get_le(uint64_t &value, size_t bytes) {
+    if (data.size() - pos < bytes) {
+      return false;
+    }
+    value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+      value |= static_cast<uint64_t>(data[pos++]) << (8 * i);
+    }
+    return true;
+  }
+
+  bool get_varint(uint32_t &value) {
+    value = 0;
+    for (size_t shift = 0; shift < 32; shift += 7) {
+      if (pos >= data.size()) {
+        return false;
+      }
+      const uint8_t byte = data[pos++];
+      value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  const std::vector<uint8_t> &data;
+  size_t pos = magic.size();
+};
+
+} // namespace
+
+std::optional<Movie> Movie::load(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    std::println(stderr, "Error: Could not open file {}", path);
+    return std::nullopt;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+
+  if (data.size() < magic.size() ||
+      std::string_view(reinterpret_cast<const char *>(data.data()),
+                       magic.size()) != magic) {
+    std::println(stderr, "Error: {} is not a movie file", path);
+    return std::nullopt;
+  }
+
+  Movie movie;
+  Reader reader(data);
+  uint64_t file_version, frame_count, input_count;
+  if (!reader.get_le(file_version, 2) || file_version != version ||
+      !reader.get_le(frame_count, 4) || !reader.get_le(movie.rom_hash, 8) ||
+      !reader.get_le(movie.final_state_hash, 8) ||
+      !reader.get_le(input_count, 4)) {
+    std::println(stderr, "Error: Unsupported or truncated movie header in {}",
+                 path);
+    return std::nullopt;
+  }
+  movie.frame_count = static_cast<uint32_t>(frame_count);
+
+  uint32_t frame = 0;
+  for (uint64_t i = 0; i < input_count; ++i) {
+    uint32_t delta;
+    uint64_t buttons;
+    if (!reader.get_varint(delta) || !reader.get_le(buttons, 1)) {
+      std::println(stderr, "Error: Truncated movie input list in {}", path);
+      return std::nullopt;
+    }
+    frame += delta;
+    movie.inputs.push_back({frame, static_cast<uint8_t>(buttons)});
+  }
+  return movie;
+}
+
+bool Movie::save(const std::string &path) const {
+  std::vector<uint8_t> data(magic.begin(), magic.end());
+  put_le(data, version, 2);
+  put_le(data, frame_count, 4);
+  put_le(data, rom_hash, 8);
+  put_le(data, final_state_hash, 8);
+  put_le(data, inputs.size(), 4);
+
+  uint32_t frame = 0;
+  for (const MovieInput &input : inputs) {
+    put_varint(data, input.frame - frame);
+    data.push_back(input.buttons);
+    frame = input.frame;
+  }
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    std::println(stderr, "Error: Could not open file {}", path);
+    return false;
+  }
+  file.write(reinterpret_cast<const char *>(data.data()),
+             static_cast<std::streamsize>(data.size()));
+  return static_cast<bool>(file);
+}
+
+MovieRecorder::MovieRecorder(uint64_t rom_hash) { movie.rom_hash = rom_hash; }
+
+void MovieRecorder::record(uint32_t frame, uint8_t buttons) {
+  if (buttons != last_buttons) {
+    movie.inputs.push_back({frame, buttons});
+    last_buttons = buttons;
+  }
+}
+
+Movie MovieRecorder::finish(uint32_t frame_count, uint64_t final_state_hash) {
+  movie.frame_count = frame_count;
+  movie.final_state_hash = final_state_hash;
+  return movie;
+}
+
+uint64_t play_movie(GameBoy &gameboy, const Movie &movie,
+                    const std::function<void(uint32_t frame)> &after_frame) {
+  size_t next = 0;
+  for (uint32_t frame = 0; frame < movie.frame_count; ++frame) {
+    while (next < movie.inputs.size() && movie.inputs[next].frame <= frame) {
+      gameboy.set_buttons(movie.inputs[next].buttons);
+      ++next;
+    }
+    gameboy.run_frame();
+    if (after_frame) {
+      after_frame(frame);
+    }
+  }
+  return gameboy.hash_state();
+}
@@ -0,0 +1,277 @@
+#include "ppu.hpp"
+
+#include "hash.hpp"
+#include "machine_state.hpp"
+#include "scheduler.hpp"
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace {
+
+// Offsets of the PPU registers in MachineState::io.
+constexpr size_t reg_if = 0x0F;
+constexpr size_t reg_lcdc = 0x40;
+constexpr size_t reg_stat = 0x41;
+constexpr size_t reg_scy = 0x42;
+constexpr size_t reg_scx = 0x43;
+constexpr size_t reg_ly = 0x44;
+constexpr size_t reg_lyc = 0x45;
+constexpr size_t reg_bgp = 0x47;
+constexpr size_t reg_obp0 = 0x48;
+constexpr size_t reg_obp1 = 0x49;
+constexpr size_t reg_wy = 0x4A;
+constexpr size_t reg_wx = 0x4B;
+
+constexpr uint8_t mode_hblank = 0;
+constexpr uint8_t mode_vblank = 1;
+constexpr uint8_t mode_oam_scan = 2;
+constexpr uint8_t mode_drawing = 3;
+
+constexpr uint64_t oam_scan_cycles = 80;
+constexpr uint64_t drawing_cycles = 172;
+constexpr uint64_t hblank_cycles =
+    PPU::cycles_per_line - oam_scan_cycles - drawing_cycles;
+
+constexpr size_t max_sprites_per_line = 10;
+
+// Color index (0-3) of one pixel of the tile starting at `tile_addr` (an
+// offset into VRAM).
+uint8_t tile_pixel(const std::array<uint8_t, 0x2000> &vram, size_t tile_addr,
+                   size_t row, size_t column) {
+  const uint8_t lo = vram[tile_addr + row * 2];
+  const uint8_t hi = vram[tile_addr + row * 2 + 1];
+  const size_t bit = 7 - column;
+  return static_cast<uint8_t>((((hi >> bit) & 1) << 1) | ((lo >> bit) & 1));
+}
+
+uint8_t apply_palette(uint8_t palette, uint8_t index) {
+  return (palette >> (index * 2)) & 0x03;
+}
+
+} // namespace
+
+PPU::PPU(MachineState &state) : state(state), framebuffer{} {
+  line_hashes.fill(hash64(framebuffer.data(), width));
+}
+
+void PPU::reset() {
+  state.lcd_on = (state.io[reg_lcdc] & 0x80) != 0;
+  state.window_line = 0;
+  start_line(0);
+  state.scheduler.schedule(Event::Ppu, state.cycles + oam_scan_cycles);
+}
+
+bool PPU::update(uint64_t deadline) {
+  const bool lcd_on = (state.io[reg_lcdc] & 0x80) != 0;
+  if (!lcd_on) {
+    // While the LCD is off LY stays 0 and the PPU idles in HBlank. Poll once
+    // per line so that switching it back on starts a new frame.
+    state.lcd_on = false;
+    state.io[reg_ly] = 0;
+    set_mode(mode_hblank);
+    state.scheduler.schedule(Event::Ppu, deadline + cycles_per_line);
+    return false;
+  }
+  if (!state.lcd_on) {
+    state.lcd_on = true;
+    state.window_line = 0;
+    start_line(0);
+    state.scheduler.schedule(Event::Ppu, deadline + oam_scan_cycles);
+    return false;
+  }
+
+  const uint8_t ly = state.io[reg_ly];
+  uint64_t next;
+  bool vblank = false;
+  switch (state.io[reg_stat] & 0x03) {
+  case mode_oam_scan:
+    set_mode(mode_drawing);
+    next = deadline + drawing_cycles;
+    break;
+
+  case mode_drawing: {
+    if (render_enabled) {
+      render_line(ly);
+      const uint64_t hash =
+          hash64(framebuffer.data() + static_cast<size_t>(ly) * width, width);
+      if (hash != line_hashes[ly]) {
+        line_hashes[ly] = hash;
+        changed_lines.set(ly);
+      }
+    }
+    const uint8_t lcdc = state.io[reg_lcdc];
+    if ((lcdc & 0x20) != 0 && ly >= state.io[reg_wy] &&
+        state.io[reg_wx] <= 166) {
+      state.window_line += 1;
+    }
+    set_mode(mode_hblank);
+    if (state.hdma_active) {
+      state.scheduler.schedule(Event::Hdma, deadline);
+    }
+    next = deadline + hblank_cycles;
+    break;
+  }
+
+  case mode_hblank:
+  case mode_vblank: {
+    const uint8_t next_ly = ly + 1 == lines_per_frame ? 0 : ly + 1;
+    if (next_ly == 0) {
+      state.window_line = 0;
+    }
+    start_line(next_ly);
+    next = deadline +
+           (next_ly < height ? oam_scan_cycles : cycles_per_line);
+    vblank = next_ly == height;
+    break;
+  }
+
+  default:
+    std::unreachable();
+  }
+  state.scheduler.schedule(Event::Ppu, next);
+  return vblank;
+}
+
+uint64_t PPU::get_frame_hash() const {
+  return hash64(line_hashes.data(), sizeof(line_hashes));
+}
+
+std::bitset<PPU::height> PPU::take_changed_lines() {
+  const std::bitset<height> lines = changed_lines;
+  changed_lines.reset();
+  return lines;
+}
+
+void PPU::set_mode(uint8_t mode) {
+  state.io[reg_stat] = (state.io[reg_stat] & ~0x03) | mode;
+  update_stat_line();
+}
+
+void PPU::start_line(uint8_t ly) {
+  state.io[reg_ly] = ly;
+  if (ly == state.io[reg_lyc]) {
+    state.io[reg_stat] |= 0x04;
+  } else {
+    state.io[reg_stat] &= ~0x04;
+  }
+
+  if (ly < height) {
+    set_mode(mode_oam_scan);
+  } else {
+    if (ly == height) {
+      state.io[reg_if] |= 0x01;
+    }
+    set_mode(mode_vblank);
+  }
+}
+
+void PPU::update_stat_line() {
+  const uint8_t stat = state.io[reg_stat];
+  const uint8_t mode = stat & 0x03;
+  const bool line = ((stat & 0x40) != 0 && (stat & 0x04) != 0) ||
+                    ((stat & 0x08) != 0 && mode == mode_hblank) ||
+                    ((stat & 0x10) != 0 && mode == mode_vblank) ||
+                    ((stat & 0x20) != 0 && mode == mode_oam_scan);
+  if (line && !state.stat_line) {
+    state.io[reg_if] |= 0x02;
+  }
+  state.stat_line = line;
+}
+
+void PPU::render_line(uint8_t ly) {
+  const std::array<uint8_t, 0x2000> &vram = state.vram;
+  const uint8_t lcdc = state.io[reg_lcdc];
+  uint8_t *row = framebuffer.data() + static_cast<size_t>(ly) * width;
+
+  // Background and window color indices, needed for sprite priority.
+  std::array<uint8_t, width> bg_index{};
+  if ((lcdc & 0x01) != 0) {
+    const bool unsigned_tiles = (lcdc & 0x10) != 0;
+    auto tile_addr = [unsigned_tiles](uint8_t tile) -> size_t {
+      return unsigned_tiles
+                 ? static_cast<size_t>(tile) * 16
+                 : static_cast<size_t>(0x1000 + static_cast<int8_t>(tile) * 16);
+    };
+
+    const size_t bg_map = (lcdc & 0x08) != 0 ? 0x1C00 : 0x1800;
+    const uint8_t y = state.io[reg_scy] + ly;
+    for (size_t x = 0; x < width; ++x) {
+      const uint8_t px = static_cast<uint8_t>(state.io[reg_scx] + x);
+      const uint8_t tile = vram[bg_map + (y / 8) * 32 + px / 8];
+      bg_index[x] = tile_pixel(vram, tile_addr(tile), y % 8, px % 8);
+    }
+
+    const uint8_t wx = state.io[reg_wx];
+    if ((lcdc & 0x20) != 0 && ly >= state.io[reg_wy] && wx <= 166) {
+      const size_t window_map = (lcdc & 0x40) != 0 ? 0x1C00 : 0x1800;
+      const uint8_t wy = state.window_line;
+      const size_t start = wx < 7 ? 0 : wx - 7;
+      for (size_t x = start; x < width; ++x) {
+        const size_t px = x + 7 - wx;
+        const uint8_t tile = vram[window_map + (wy / 8) * 32 + px / 8];
+        bg_index[x] = tile_pixel(vram, tile_addr(tile), wy % 8, px % 8);
+      }
+    }
+  }
+
+  const uint8_t bgp = state.io[reg_bgp];
+  for (size_t x = 0; x < width; ++x) {
+    row[x] = apply_palette(bgp, bg_index[x]);
+  }
+
+  if ((lcdc & 0x02) == 0) {
+    return;
+  }
+
+  // OAM scan: the first ten sprites overlapping this line.
+  const int sprite_height = (lcdc & 0x04) != 0 ? 16 : 8;
+  std::array<size_t, max_sprites_per_line> sprites;
+  size_t sprite_count = 0;
+  for (size_t i = 0; i < 40 && sprite_count < max_sprites_per_line; ++i) {
+    const int top = state.oam[i * 4] - 16;
+    if (top <= ly && ly < top + sprite_height) {
+      sprites[sprite_count++] = i;
+    }
+  }
+
+  // Smaller X wins, then lower OAM index; draw the winners last.
+  std::stable_sort(sprites.begin(), sprites.begin() + sprite_count,
+                   [this](size_t lhs, size_t rhs) {
+                     return state.oam[lhs * 4 + 1] < state.oam[rhs * 4 + 1];
+                   });
+  for (size_t n = sprite_count; n-- > 0;) {
+    const uint8_t *sprite = state.oam.data() + sprites[n] * 4;
+    const int top = sprite[0] - 16;
+    const int left = sprite[1] - 8;
+    const uint8_t flags = sprite[3];
+    uint8_t tile = sprite[2];
+    if (sprite_height == 16) {
+      tile &= 0xFE;
+    }
+
+    int line = ly - top;
+    if ((flags & 0x40) != 0) {
+      line = sprite_height - 1 - line;
+    }
+    const uint8_t palette = state.io[(flags & 0x10) != 0 ? reg_obp1 : reg_obp0];
+
+    for (int column = 0; column < 8; ++column) {
+      const int x = left + column;
+      if (x < 0 || x >= static_cast<int>(width)) {
+        continue;
+      }
+      const int source_column = (flags & 0x20) != 0 ? 7 - column : column;
+      const uint8_t index =
+          tile_pixel(vram, static_cast<size_t>(tile) * 16,
+                     static_cast<size_t>(line), source_column);
+      if (index == 0 || ((flags & 0x80) != 0 && bg_index[x] != 0)) {
+        continue;
+      }
+      row[x] = apply_palette(palette, index);
+    }
+  }
+}
@@ -0,0 +1,209 @@
+#include "profiler.hpp"
+
+#include "control_flow.hpp"
+#include "machine_state.hpp"
+#include "mmu.hpp"
+#include "symbols.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <print>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Call tree nodes below this share of all samples are left out.
+constexpr double min_tree_share = 0.001;
+
+// Pseudo-routine for samples taken while the CPU is halted; it appears as a
+// callee of the routine that executed HALT.
+constexpr const char *halted_name = "(halted)";
+
+CodeAddress locate(const MMU &mmu, uint16_t addr) {
+  if (addr >= 0x4000 && addr < 0x8000) {
+    return {mmu.get_cartridge().get_rom_bank(), addr};
+  }
+  // WRAMX is always bank 1 on a DMG.
+  return {static_cast<uint16_t>(addr >= 0xD000 && addr < 0xE000), addr};
+}
+
+// The CALL or RST that `value` would be the return address of, if any.
+std::optional<uint16_t> find_call(const MMU &mmu, uint16_t value) {
+  if (value >= 0x8000) {
+    return std::nullopt;
+  }
+  if (value >= 3) {
+    const uint8_t opcode = mmu.peek(static_cast<uint16_t>(value - 3));
+    // CALL, CALL NZ/Z/NC/C
+    if (opcode == 0xCD || opcode == 0xC4 || opcode == 0xCC ||
+        opcode == 0xD4 || opcode == 0xDC) {
+      return static_cast<uint16_t>(value - 3);
+    }
+  }
+  if (value >= 1) {
+    const uint8_t opcode = mmu.peek(static_cast<uint16_t>(value - 1));
+    // RST 0x38 is 0xFF, the most common filler byte.
+    if ((opcode & 0xC7) == 0xC7 && opcode != 0xFF) {
+      return static_cast<uint16_t>(value - 1);
+    }
+  }
+  return std::nullopt;
+}
+
+struct Node {
+  uint64_t total = 0;
+  uint64_t self = 0;
+  std::map<std::string, Node> children;
+};
+
+double percent(uint64_t samples, uint64_t total) {
+  return 100.0 * static_cast<double>(samples) / static_cast<double>(total);
+}
+
+void format_tree(std::string &out, const Node &node, size_t depth,
+                 uint64_t total) {
+  std::vector<std::pair<const std::string *, const Node *>> children;
+  for (const auto &[name, child] : node.children) {
+    if (static_cast<double>(child.total) >=
+        min_tree_share * static_cast<double>(total)) {
+      children.emplace_back(&name, &child);
+    }
+  }
+  std::ranges::stable_sort(children, [](const auto &a, const auto &b) {
+    return a.second->total > b.second->total;
+  });
+  for (const auto &[name, child] : children) {
+    std::format_to(std::back_inserter(out), "{:7.2f} {:7.2f}  {}{}\n",
+                   percent(child->total, total), percent(child->self, total),
+                   std::string(depth * 2, ' '), *name);
+    format_tree(out, *child, depth + 1, total);
+  }
+}
+
+} // namespace
+
+Profiler::Profiler(uint64_t interval)
+    : interval(std::max<uint64_t>((interval + 3) & ~uint64_t{3}, 4)) {
+  frames.reserve(max_depth);
+}
+
+void Profiler::sample(const MMU &mmu) {
+  const MachineState &state = mmu.get_state();
+  frames.clear();
+  frames.push_back(locate(mmu, state.regs.pc));
+  uint16_t sp = state.regs.sp;
+  for (size_t i = 0; i < max_scan_words && frames.size() < max_depth &&
+                     sp < 0xFFFE;
+       ++i, sp += 2) {
+    const uint16_t value = static_cast<uint16_t>(
+        mmu.peek(sp) | mmu.peek(static_cast<uint16_t>(sp + 1)) << 8);
+    if (const std::optional<uint16_t> call = find_call(mmu, value)) {
+      frames.push_back(locate(mmu, *call));
+    }
+  }
+  std::ranges::reverse(frames);
+
+  Counts &counts = stacks[frames];
+  counts.samples += 1;
+  counts.halted += state.halted;
+  sample_count += 1;
+}
+
+void Profiler::clear() {
+  stacks.clear();
+  sample_count = 0;
+}
+
+std::string Profiler::format(const SymbolTable &symbols) const {
+  std::string out;
+  std::format_to(std::back_inserter(out),
+                 "{} samples, one every {} cycles ({} cycles)\n",
+                 sample_count, interval, sample_count * interval);
+  if (sample_count == 0) {
+    return out;
+  }
+
+  std::map<std::string, uint64_t> self;
+  std::map<std::string, uint64_t> total;
+  Node root;
+  std::vector<std::string> names;
+  std::set<std::string> seen;
+  for (const auto &[stack, counts] : stacks) {
+    // Symbolise, merging a routine calling into itself (e.g. a local label
+    // it CALLs) into one frame.
+    names.clear();
+    for (const CodeAddress &frame : stack) {
+      std::string name = symbols.get_routine(frame);
+      if (names.empty() || names.back() != name) {
+        names.push_back(std::move(name));
+      }
+    }
+
+    for (const auto &[samples, halted] :
+         {std::pair{counts.samples - counts.halted, false},
+          std::pair{counts.halted, true}}) {
+      if (samples == 0) {
+        continue;
+      }
+      if (halted) {
+        names.emplace_back(halted_name);
+      }
+      self[names.back()] += samples;
+      seen.clear();
+      Node *node = &root;
+      for (const std::string &name : names) {
+        if (seen.insert(name).second) {
+          total[name] += samples;
+        }
+        node = &node->children[name];
+        node->total += samples;
+      }
+      node->self += samples;
+    }
+  }
+
+  struct Row {
+    const std::string *name;
+    uint64_t self;
+    uint64_t total;
+  };
+  std::vector<Row> flat;
+  for (const auto &[name, samples] : total) {
+    flat.push_back({&name, self[name], samples});
+  }
+  std::ranges::stable_sort(flat, std::greater{}, &Row::self);
+  out += "\nFlat profile:\n  self%  total%   self cycles  routine\n";
+  for (const Row &row : flat) {
+    std::format_to(std::back_inserter(out), "{:7.2f} {:7.2f} {:13}  {}\n",
+                   percent(row.self, sample_count),
+                   percent(row.total, sample_count), row.self * interval,
+                   *row.name);
+  }
+
+  std::format_to(std::back_inserter(out),
+                 "\nCall tree (below {}% left out):\n total%   self%  "
+                 "routine\n",
+                 min_tree_share * 100);
+  format_tree(out, root, 0, sample_count);
+  return out;
+}
+
+bool Profiler::write(const std::string &path,
+                     const SymbolTable &symbols) const {
+  const std::string text = format(symbols);
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    std::println(stderr, "Error: Could not open file {}", path);
+    return false;
+  }
+  file.write(text.data(), static_cast<std::streamsize>(text.size()));
+  return static_cast<bool>(file);
+}
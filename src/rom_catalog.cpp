@@ -0,0 +1,338 @@
+#include "rom_catalog.hpp"
+
+#include "hash.hpp"
+#include "rom_header.hpp"
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <print>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr std::string_view magic = "EMUGBCAT";
+// Bytes of an entry with an empty path and title.
+constexpr size_t min_entry_size = 41;
+
+void put_le(std::vector<uint8_t> &out, uint64_t value, size_t bytes) {
+  for (size_t i = 0; i < bytes; ++i) {
+    out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+void put_string(std::vector<uint8_t> &out, std::string_view text,
+                size_t length_bytes) {
+  put_le(out, text.size(), length_bytes);
+  out.insert(out.end(), text.begin(), text.end());
+}
+
+class Reader {
+public:
+  Reader(const std::vector<uint8_t> &data) : data(data) {}
+
+  bool get_le(uint64_t &value, size_t bytes) {
+    if (data.size() - pos < bytes) {
+      return false;
+    }
+    value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+      value |= static_cast<uint64_t>(data[pos++]) << (8 * i);
+    }
+    return true;
+  }
+
+  bool get_string(std::string &text, size_t length_bytes) {
+    uint64_t length;
+    if (!get_le(length, length_bytes) || data.size() - pos < length) {
+      return false;
+    }
+    text.assign(reinterpret_cast<const char *>(data.data()) + pos, length);
+    pos += length;
+    return true;
+  }
+
+  size_t get_remaining() const { return data.size() - pos; }
+
+private:
+  const std::vector<uint8_t> &data;
+  size_t pos = magic.size();
+};
+
+bool is_rom_file(const std::filesystem::path &path) {
+  std::string extension = path.extension().string();
+  std::ranges::transform(extension, extension.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return extension == ".gb" || extension == ".gbc";
+}
+
+// Reads, parses and hashes one file. Returns false if it is not a ROM.
+bool index_file(CatalogEntry &entry, std::vector<uint8_t> &buffer) {
+  std::ifstream file(entry.path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  buffer.resize(entry.file_size);
+  file.read(reinterpret_cast<char *>(buffer.data()),
+            static_cast<std::streamsize>(buffer.size()));
+  if (static_cast<uint64_t>(file.gcount()) != entry.file_size) {
+    return false;
+  }
+
+  const std::optional<RomHeader> header = RomHeader::parse(buffer);
+  if (!header) {
+    return false;
+  }
+  entry.header = *header;
+  entry.hash = hash64(buffer.data(), buffer.size());
+  return true;
+}
+
+std::string to_lower(std::string_view text) {
+  std::string lower(text);
+  std::ranges::transform(lower, lower.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return lower;
+}
+
+} // namespace
+
+std::optional<RomCatalog> RomCatalog::load(const std::string &path) {
+  RomCatalog catalog;
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return catalog;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+
+  if (data.size() < magic.size() ||
+      std::string_view(reinterpret_cast<const char *>(data.data()),
+                       magic.size()) != magic) {
+    std::println(stderr, "Error: {} is not a catalog file", path);
+    return std::nullopt;
+  }
+
+  Reader reader(data);
+  uint64_t file_version, entry_count;
+  // Checking the count against the data left keeps a damaged header from
+  // allocating up to 4 billion entries.
+  if (!reader.get_le(file_version, 2) || file_version != version ||
+      !reader.get_le(entry_count, 4) ||
+      entry_count > reader.get_remaining() / min_entry_size) {
+    std::println(stderr, "Error: Unsupported or truncated catalog header in {}",
+                 path);
+    return std::nullopt;
+  }
+
+  catalog.entries.resize(entry_count);
+  for (CatalogEntry &entry : catalog.entries) {
+    uint64_t mtime, cgb_flag, cartridge_type, rom_size, ram_size,
+        header_checksum, global_checksum, flags;
+    if (!reader.get_string(entry.path, 2) ||
+        !reader.get_le(entry.file_size, 8) || !reader.get_le(mtime, 8) ||
+        !reader.get_le(entry.hash, 8) || !reader.get_le(cgb_flag, 1) ||
+        !reader.get_le(cartridge_type, 1) || !reader.get_le(rom_size, 4) ||
+        !reader.get_le(ram_size, 4) || !reader.get_le(header_checksum, 1) ||
+        !reader.get_le(global_checksum, 2) || !reader.get_le(flags, 1) ||
+        !reader.get_string(entry.header.title, 1)) {
+      std::println(stderr, "Error: Truncated catalog entry list in {}", path);
+      return std::nullopt;
+    }
+    entry.mtime = static_cast<int64_t>(mtime);
+    entry.header.cgb_flag = static_cast<uint8_t>(cgb_flag);
+    entry.header.cartridge_type = static_cast<uint8_t>(cartridge_type);
+    entry.header.rom_size = static_cast<uint32_t>(rom_size);
+    entry.header.ram_size = static_cast<uint32_t>(ram_size);
+    entry.header.header_checksum = static_cast<uint8_t>(header_checksum);
+    entry.header.global_checksum = static_cast<uint16_t>(global_checksum);
+    entry.header.header_checksum_ok = (flags & 0x01) != 0;
+    entry.header.global_checksum_ok = (flags & 0x02) != 0;
+  }
+  catalog.rebuild_index();
+  return catalog;
+}
+
+bool RomCatalog::save(const std::string &path) const {
+  std::vector<uint8_t> data(magic.begin(), magic.end());
+  put_le(data, version, 2);
+  put_le(data, entries.size(), 4);
+  for (const CatalogEntry &entry : entries) {
+    const RomHeader &header = entry.header;
+    put_string(data, entry.path, 2);
+    put_le(data, entry.file_size, 8);
+    put_le(data, static_cast<uint64_t>(entry.mtime), 8);
+    put_le(data, entry.hash, 8);
+    put_le(data, header.cgb_flag, 1);
+    put_le(data, header.cartridge_type, 1);
+    put_le(data, header.rom_size, 4);
+    put_le(data, header.ram_size, 4);
+    put_le(data, header.header_checksum, 1);
+    put_le(data, header.global_checksum, 2);
+    put_le(data,
+           (header.header_checksum_ok ? 0x01 : 0) |
+               (header.global_checksum_ok ? 0x02 : 0),
+           1);
+    put_string(data, header.title, 1);
+  }
+
+  // Write to a temporary file first so that an interrupted save keeps the
+  // old catalog.
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary);
+    if (!file) {
+      std::println(stderr, "Error: Could not open file {}", temporary);
+      return false;
+    }
+    file.write(reinterpret_cast<const char *>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    if (!file) {
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    std::println(stderr, "Error: Could not write {}: {}", path,
+                 error.message());
+    return false;
+  }
+  return true;
+}
+
+RomCatalog::ScanStats
+RomCatalog::scan(const std::vector<std::filesystem::path> &roots,
+                 ThreadPool &pool) {
+  namespace fs = std::filesystem;
+  ScanStats stats;
+
+  std::vector<std::string> prefixes;
+  for (const fs::path &root : roots) {
+    std::string prefix = fs::absolute(root).lexically_normal().string();
+    if (!prefix.ends_with(fs::path::preferred_separator)) {
+      prefix += fs::path::preferred_separator;
+    }
+    prefixes.push_back(std::move(prefix));
+  }
+  auto under_roots = [&](const std::string &path) {
+    return std::ranges::any_of(prefixes, [&](const std::string &prefix) {
+      return path.starts_with(prefix);
+    });
+  };
+
+  std::unordered_map<std::string, size_t> by_path;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    by_path.emplace(entries[i].path, i);
+  }
+
+  // Entries outside the scanned directories are kept as they are.
+  std::vector<CatalogEntry> result;
+  for (const CatalogEntry &entry : entries) {
+    if (!under_roots(entry.path)) {
+      result.push_back(entry);
+    }
+  }
+
+  std::vector<CatalogEntry> pending;
+  std::vector<uint8_t> seen(entries.size());
+  for (const std::string &prefix : prefixes) {
+    std::error_code error;
+    fs::recursive_directory_iterator it(
+        prefix, fs::directory_options::skip_permission_denied, error);
+    for (; !error && it != fs::recursive_directory_iterator();
+         it.increment(error)) {
+      const fs::directory_entry &file = *it;
+      std::error_code file_error;
+      if (!file.is_regular_file(file_error) || !is_rom_file(file.path())) {
+        continue;
+      }
+      CatalogEntry entry;
+      entry.path = file.path().lexically_normal().string();
+      entry.file_size = file.file_size(file_error);
+      entry.mtime = file.last_write_time(file_error).time_since_epoch().count();
+      if (file_error) {
+        continue;
+      }
+      ++stats.files;
+
+      const auto existing = by_path.find(entry.path);
+      if (existing != by_path.end()) {
+        seen[existing->second] = true;
+      }
+      if (existing != by_path.end() &&
+          entries[existing->second].file_size == entry.file_size &&
+          entries[existing->second].mtime == entry.mtime) {
+        result.push_back(entries[existing->second]);
+      } else {
+        pending.push_back(std::move(entry));
+      }
+    }
+    if (error) {
+      std::println(stderr, "Warning: Could not scan {}: {}", prefix,
+                   error.message());
+    }
+  }
+
+  // Every task fills its own entry, so no locking is needed.
+  std::vector<uint8_t> indexed(pending.size());
+  pool.run(pending.size(), [&](size_t i) {
+    thread_local std::vector<uint8_t> buffer;
+    indexed[i] = index_file(pending[i], buffer);
+  });
+  for (size_t i = 0; i < pending.size(); ++i) {
+    if (indexed[i]) {
+      result.push_back(std::move(pending[i]));
+      ++stats.hashed;
+    } else {
+      ++stats.failed;
+    }
+  }
+
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (!seen[i] && under_roots(entries[i].path)) {
+      ++stats.removed;
+    }
+  }
+
+  std::ranges::sort(result, {}, &CatalogEntry::path);
+  entries = std::move(result);
+  rebuild_index();
+  return stats;
+}
+
+const CatalogEntry *RomCatalog::find_by_hash(uint64_t hash) const {
+  const auto it = by_hash.find(hash);
+  return it == by_hash.end() ? nullptr : &entries[it->second];
+}
+
+std::vector<const CatalogEntry *>
+RomCatalog::find_by_title(std::string_view text) const {
+  const std::string needle = to_lower(text);
+  std::vector<const CatalogEntry *> found;
+  for (const CatalogEntry &entry : entries) {
+    if (to_lower(entry.header.title).find(needle) != std::string::npos) {
+      found.push_back(&entry);
+    }
+  }
+  return found;
+}
+
+void RomCatalog::rebuild_index() {
+  by_hash.clear();
+  by_hash.reserve(entries.size());
+  for (size_t i = 0; i < entries.size(); ++i) {
+    by_hash.emplace(entries[i].hash, i);
+  }
+}
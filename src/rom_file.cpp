@@ -0,0 +1,330 @@
+#include "rom_file.hpp"
+
+#include "cartridge.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+constexpr size_t chunk_size = 64 * 1024;
+// Larger than any cartridge; bounds allocations driven by archive headers.
+constexpr uint64_t max_rom_size = 64 * 1024 * 1024;
+// Room for 65535 entries with names of a few hundred bytes; bounds the
+// central directory read from an untrusted end record.
+constexpr uint64_t max_zip_directory_size = 16 * 1024 * 1024;
+
+constexpr uint32_t zip_local_signature = 0x04034B50;
+constexpr uint32_t zip_central_signature = 0x02014B50;
+constexpr uint32_t zip_end_signature = 0x06054B50;
+constexpr size_t zip_end_size = 22;
+constexpr size_t zip_central_size = 46;
+constexpr size_t zip_local_size = 30;
+constexpr uint16_t zip_stored = 0;
+constexpr uint16_t zip_deflated = 8;
+
+using ReadResult = std::expected<std::vector<uint8_t>, LoadError>;
+
+uint16_t le16(const uint8_t *p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t le32(const uint8_t *p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+bool read_at(std::ifstream &file, uint64_t offset, uint8_t *out,
+             size_t size) {
+  file.clear();
+  file.seekg(static_cast<std::streamoff>(offset));
+  file.read(reinterpret_cast<char *>(out), static_cast<std::streamsize>(size));
+  return static_cast<size_t>(file.gcount()) == size;
+}
+
+// Inflates `compressed_size` bytes from the current position of `file`
+// into `out`, which must already have the uncompressed size.
+// `window_bits` selects the container as in inflateInit2().
+bool inflate_into(std::ifstream &file, uint64_t compressed_size,
+                  int window_bits, std::vector<uint8_t> &out) {
+  z_stream stream{};
+  if (inflateInit2(&stream, window_bits) != Z_OK) {
+    return false;
+  }
+  stream.next_out = out.data();
+  stream.avail_out = static_cast<uInt>(out.size());
+
+  std::array<uint8_t, chunk_size> chunk;
+  int result = Z_OK;
+  while (result != Z_STREAM_END && compressed_size > 0) {
+    const size_t want =
+        static_cast<size_t>(std::min<uint64_t>(chunk.size(), compressed_size));
+    file.read(reinterpret_cast<char *>(chunk.data()),
+              static_cast<std::streamsize>(want));
+    const size_t got = static_cast<size_t>(file.gcount());
+    if (got == 0) {
+      break;
+    }
+    compressed_size -= got;
+    stream.next_in = chunk.data();
+    stream.avail_in = static_cast<uInt>(got);
+    result = inflate(&stream, Z_NO_FLUSH);
+    // Z_BUF_ERROR with input left means the output is larger than promised.
+    if (result != Z_OK && result != Z_STREAM_END) {
+      break;
+    }
+  }
+  const bool complete = result == Z_STREAM_END && stream.avail_out == 0;
+  inflateEnd(&stream);
+  return complete;
+}
+
+ReadResult read_gzip(std::ifstream &file, uint64_t file_size) {
+  // The trailer ends with the uncompressed size modulo 2^32.
+  std::array<uint8_t, 4> trailer;
+  if (file_size < 18 || !read_at(file, file_size - 4, trailer.data(), 4)) {
+    return std::unexpected(LoadError::InvalidArchive);
+  }
+  const uint32_t size = le32(trailer.data());
+  if (size > max_rom_size) {
+    return std::unexpected(LoadError::InvalidArchive);
+  }
+
+  std::vector<uint8_t> rom(size);
+  file.seekg(0);
+  // +16: gzip wrapper; zlib checks the CRC and size in the trailer.
+  if (!inflate_into(file, file_size, 16 + MAX_WBITS, rom)) {
+    return std::unexpected(LoadError::InvalidArchive);
+  }
+  return rom;
+}
+
+bool is_rom_name(std::string_view name) {
+  std::string lower(name);
+  std::ranges::transform(lower, lower.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  return lower.ends_with(".gb") || lower.ends_with(".gbc");
+}
+
+ReadResult read_zip(std::ifstream &file, uint64_t file_size) {
+  // The end of central directory record is followed by a comment of up to
+  // 64 KiB.
+  if (file_size < zip_end_size) {
+    return std::unexpected(LoadError::InvalidArchive);
+  }
+  const uint64_t tail_size =
+      std::min<uint64_t>(file_size, zip_end_size + 0xFFFF);
+  std::vector<uint8_t> tail(tail_size);
+  if (!read_at(file, file_size - tail_size, tail.data(), tail.size())) {
+    return std::unexpected(LoadError::ReadFailed);
+  }
+  const uint8_t *end = nullptr;
+  for (size_t i = tail.size() - zip_end_size + 1; i-- > 0;) {
+    if (le32(tail.data() + i) == zip_end_signature) {
+      end = tail.data() + i;
+      break;
+    }
+  }
+  if (end == nullptr) {
+    return std::unexpected(LoadError::InvalidArchive);
+  }
+  const uint16_t entry_count = le16(end + 10);
+  const uint32_t directory_size = le32(end + 12);
+  const uint32_t directory_offset = le32(end + 16);
+  if (directory_size > max_zip_directory_size ||
+      uint64_t{directory_offset} + directory_size > file_size) {
+    return std::unexpected(LoadError::InvalidArchive);
+  }
+
+  std::vector<uint8_t> directory(directory_size);
+  if (!read_at(file, directory_offset, directory.data(), directory.size())) {
+    return std::unexpected(LoadError::InvalidArchive);
+  }
+
+  // Pick the first .gb/.gbc entry, or else the first file.
+  const uint8_t *chosen = nullptr;
+  size_t pos = 0;
+  for (uint16_t i = 0; i < entry_count; ++i) {
+    if (directory.size() - pos < zip_central_size ||
+        le32(directory.data() + pos) != zip_central_signature) {
+      return std::unexpected(LoadError::InvalidArchive);
+    }
+    const uint8_t *entry = directory.data() + pos;
+    const size_t name_size = le16(entry + 28);
+    const size_t next = pos + zip_central_size + name_size + le16(entry + 30) +
+                        le16(entry + 32);
+    if (next > directory.size()) {
+      return std::unexpected(LoadError::InvalidArchive);
+    }
+    const std::string_view name(
+        reinterpret_cast<const char *>(entry + zip_central_size), name_size);
+    if (!name.ends_with('/')) {
+      if (is_rom_name(name)) {
+        chosen = entry;
+        break;
+      }
+      if (chosen == nullptr) {
+        chosen = entry;
+      }
+    }
+    pos = next;
+  }
+  if (chosen == nullptr) {
+    return std::unexpected(LoadError::InvalidArchive);
+  }
+
+  const uint16_t method = le16(chosen + 10);
+  const uint32_t crc = le32(chosen + 16);
+  const uint32_t compressed_size = le32(chosen + 20);
+  const uint32_t size = le32(chosen + 24);
+  const uint32_t local_offset = le32(chosen + 42);
+  // Zip64 entries (sizes of 0xFFFFFFFF) are far too big to be ROMs.
+  if ((method != zip_stored && method != zip_deflated) ||
+      size > max_rom_size) {
+    return std::unexpected(LoadError::InvalidArchive);
+  }
+
+  std::array<uint8_t, zip_local_size> local;
+  if (!read_at(file, local_offset, local.data(), local.size()) ||
+      le32(local.data()) != zip_local_signature) {
+    return std::unexpected(LoadError::InvalidArchive);
+  }
+  file.seekg(static_cast<std::streamoff>(local_offset + zip_local_size +
+                                         le16(local.data() + 26) +
+                                         le16(local.data() + 28)));
+
+  std::vector<uint8_t> rom(size);
+  if (method == zip_stored) {
+    if (compressed_size != size ||
+        !file.read(reinterpret_cast<char *>(rom.data()),
+                   static_cast<std::streamsize>(rom.size()))) {
+      return std::unexpected(LoadError::InvalidArchive);
+    }
+  } else if (!inflate_into(file, compressed_size, -MAX_WBITS, rom)) {
+    return std::unexpected(LoadError::InvalidArchive);
+  }
+
+  if (crc32(0, rom.data(), static_cast<uInt>(rom.size())) != crc) {
+    return std::unexpected(LoadError::InvalidArchive);
+  }
+  return rom;
+}
+
+} // namespace
+
+std::expected<std::vector<uint8_t>, LoadError>
+read_rom_file(const std::string &path) {
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return std::unexpected(LoadError::OpenFailed);
+  }
+  const uint64_t file_size = static_cast<uint64_t>(file.tellg());
+
+  std::array<uint8_t, 4> magic{};
+  if (file_size >= magic.size() &&
+      !read_at(file, 0, magic.data(), magic.size())) {
+    return std::unexpected(LoadError::ReadFailed);
+  }
+  if (magic[0] == 0x1F && magic[1] == 0x8B) {
+    return read_gzip(file, file_size);
+  }
+  if (le32(magic.data()) == zip_local_signature) {
+    return read_zip(file, file_size);
+  }
+
+  std::vector<uint8_t> rom(file_size);
+  if (!read_at(file, 0, rom.data(), rom.size())) {
+    return std::unexpected(LoadError::ReadFailed);
+  }
+  return rom;
+}
+
+RomCache::RomCache(size_t capacity_bytes) : capacity(capacity_bytes) {}
+
+std::expected<RomImage, LoadError> RomCache::load(const std::string &path) {
+  std::error_code error;
+  const uint64_t file_size = std::filesystem::file_size(path, error);
+  const auto mtime = std::filesystem::last_write_time(path, error);
+  if (error) {
+    return std::unexpected(LoadError::OpenFailed);
+  }
+  const std::string key = std::format("{}\n{}\n{}", path, file_size,
+                                      mtime.time_since_epoch().count());
+
+  {
+    std::lock_guard lock(mutex);
+    const auto it = by_key.find(key);
+    if (it != by_key.end()) {
+      ++hits;
+      entries.splice(entries.begin(), entries, it->second);
+      return it->second->image;
+    }
+    ++misses;
+  }
+
+  // Read without holding the lock; two threads missing on the same file at
+  // once both read it and the second insert wins.
+  std::expected<std::vector<uint8_t>, LoadError> rom = read_rom_file(path);
+  if (!rom) {
+    return std::unexpected(rom.error());
+  }
+  RomImage image = std::make_shared<const std::vector<uint8_t>>(
+      std::move(*rom));
+
+  std::lock_guard lock(mutex);
+  const auto it = by_key.find(key);
+  if (it != by_key.end()) {
+    size -= it->second->image->size();
+    entries.erase(it->second);
+  }
+  entries.push_front({key, image});
+  by_key[key] = entries.begin();
+  size += image->size();
+  evict();
+  return image;
+}
+
+void RomCache::set_capacity(size_t capacity_bytes) {
+  std::lock_guard lock(mutex);
+  capacity = capacity_bytes;
+  evict();
+}
+
+size_t RomCache::get_size() const {
+  std::lock_guard lock(mutex);
+  return size;
+}
+
+uint64_t RomCache::get_hits() const {
+  std::lock_guard lock(mutex);
+  return hits;
+}
+
+uint64_t RomCache::get_misses() const {
+  std::lock_guard lock(mutex);
+  return misses;
+}
+
+void RomCache::evict() {
+  while (size > capacity && !entries.empty()) {
+    size -= entries.back().image->size();
+    by_key.erase(entries.back().key);
+    entries.pop_back();
+  }
+}
@@ -0,0 +1,151 @@
+#include "rom_header.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace {
+
+constexpr size_t title_start = 0x0134;
+constexpr size_t cgb_flag_addr = 0x0143;
+constexpr size_t cartridge_type_addr = 0x0147;
+constexpr size_t rom_size_addr = 0x0148;
+constexpr size_t ram_size_addr = 0x0149;
+constexpr size_t header_checksum_addr = 0x014D;
+constexpr size_t global_checksum_addr = 0x014E;
+
+uint32_t decode_rom_size(uint8_t code) {
+  // 32 KiB doubled per step; 0x52-0x54 only appear in a few unofficial
+  // headers and are not supported.
+  return code <= 0x08 ? uint32_t{0x8000} << code : 0;
+}
+
+uint32_t decode_ram_size(uint8_t code) {
+  switch (code) {
+  case 0x02:
+    return 0x2000;
+  case 0x03:
+    return 0x8000;
+  case 0x04:
+    return 0x20000;
+  case 0x05:
+    return 0x10000;
+  default:
+    // 0x01 is listed as 2 KiB but no licensed cartridge uses it.
+    return 0;
+  }
+}
+
+} // namespace
+
+std::string read_title(std::span<const uint8_t> rom) {
+  if (rom.size() <= cgb_flag_addr) {
+    return {};
+  }
+  const size_t title_end =
+      (rom[cgb_flag_addr] & 0x80) != 0 ? cgb_flag_addr : cgb_flag_addr + 1;
+  std::string title;
+  for (size_t addr = title_start; addr < title_end && rom[addr] != 0; ++addr) {
+    title.push_back(static_cast<char>(rom[addr]));
+  }
+  return title;
+}
+
+std::optional<RomHeader> RomHeader::parse(std::span<const uint8_t> rom) {
+  if (rom.size() < end) {
+    return std::nullopt;
+  }
+
+  RomHeader header;
+  header.title = read_title(rom);
+  header.cgb_flag = rom[cgb_flag_addr];
+  header.cartridge_type = rom[cartridge_type_addr];
+  header.rom_size = decode_rom_size(rom[rom_size_addr]);
+  header.ram_size = decode_ram_size(rom[ram_size_addr]);
+
+  header.header_checksum = rom[header_checksum_addr];
+  uint8_t checksum = 0;
+  for (size_t addr = title_start; addr < header_checksum_addr; ++addr) {
+    checksum = checksum - rom[addr] - 1;
+  }
+  header.header_checksum_ok = checksum == header.header_checksum;
+
+  // Big-endian 16-bit sum of every byte except the checksum itself.
+  header.global_checksum = static_cast<uint16_t>(
+      (rom[global_checksum_addr] << 8) | rom[global_checksum_addr + 1]);
+  uint32_t sum = 0;
+  for (const uint8_t byte : rom) {
+    sum += byte;
+  }
+  sum -= rom[global_checksum_addr] + rom[global_checksum_addr + 1];
+  header.global_checksum_ok =
+      static_cast<uint16_t>(sum) == header.global_checksum;
+
+  return header;
+}
+
+std::string_view cartridge_type_name(uint8_t cartridge_type) {
+  switch (cartridge_type) {
+  case 0x00:
+    return "ROM ONLY";
+  case 0x01:
+    return "MBC1";
+  case 0x02:
+    return "MBC1+RAM";
+  case 0x03:
+    return "MBC1+RAM+BATTERY";
+  case 0x05:
+    return "MBC2";
+  case 0x06:
+    return "MBC2+BATTERY";
+  case 0x08:
+    return "ROM+RAM";
+  case 0x09:
+    return "ROM+RAM+BATTERY";
+  case 0x0B:
+    return "MMM01";
+  case 0x0C:
+    return "MMM01+RAM";
+  case 0x0D:
+    return "MMM01+RAM+BATTERY";
+  case 0x0F:
+    return "MBC3+TIMER+BATTERY";
+  case 0x10:
+    return "MBC3+TIMER+RAM+BATTERY";
+  case 0x11:
+    return "MBC3";
+  case 0x12:
+    return "MBC3+RAM";
+  case 0x13:
+    return "MBC3+RAM+BATTERY";
+  case 0x19:
+    return "MBC5";
+  case 0x1A:
+    return "MBC5+RAM";
+  case 0x1B:
+    return "MBC5+RAM+BATTERY";
+  case 0x1C:
+    return "MBC5+RUMBLE";
+  case 0x1D:
+    return "MBC5+RUMBLE+RAM";
+  case 0x1E:
+    return "MBC5+RUMBLE+RAM+BATTERY";
+  case 0x20:
+    return "MBC6";
+  case 0x22:
+    return "MBC7+SENSOR+RUMBLE+RAM+BATTERY";
+  case 0xFC:
+    return "POCKET CAMERA";
+  case 0xFD:
+    return "BANDAI TAMA5";
+  case 0xFE:
+    return "HuC3";
+  case 0xFF:
+    return "HuC1+RAM+BATTERY";
+  default:
+    return "unknown";
+  }
+}
@@ -0,0 +1,107 @@
+#include "symbols.hpp"
+
+#include "control_flow.hpp"
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace {
+
+// Memory regions a routine cannot extend past: ROM0, ROMX, VRAM, cartridge
+// RAM, WRAM0, WRAMX and everything above.
+int get_region(uint16_t addr) {
+  if (addr < 0x4000) {
+    return 0;
+  }
+  if (addr < 0x8000) {
+    return 1;
+  }
+  if (addr < 0xA000) {
+    return 2;
+  }
+  if (addr < 0xC000) {
+    return 3;
+  }
+  if (addr < 0xD000) {
+    return 4;
+  }
+  return addr < 0xE000 ? 5 : 6;
+}
+
+bool parse_hex(std::string_view text, uint16_t &value) {
+  const std::from_chars_result result =
+      std::from_chars(text.data(), text.data() + text.size(), value, 16);
+  return result.ec == std::errc{} && result.ptr == text.data() + text.size();
+}
+
+std::string_view trim(std::string_view text) {
+  const size_t first = text.find_first_not_of(" \t\r");
+  if (first == std::string_view::npos) {
+    return {};
+  }
+  const size_t last = text.find_last_not_of(" \t\r");
+  return text.substr(first, last - first + 1);
+}
+
+} // namespace
+
+std::optional<SymbolTable> SymbolTable::load(const std::string &path) {
+  std::ifstream file(path);
+  if (!file) {
+    return std::nullopt;
+  }
+
+  SymbolTable table;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::string_view text = line;
+    text = trim(text.substr(0, text.find(';')));
+    // "BB:AAAA Name"
+    const size_t colon = text.find(':');
+    const size_t space = text.find_first_of(" \t");
+    if (colon == std::string_view::npos || space == std::string_view::npos ||
+        colon > space) {
+      continue;
+    }
+    CodeAddress address;
+    if (!parse_hex(text.substr(0, colon), address.bank) ||
+        !parse_hex(text.substr(colon + 1, space - colon - 1), address.addr)) {
+      continue;
+    }
+    const std::string_view name = trim(text.substr(space));
+    if (!name.empty()) {
+      table.add(address, name);
+    }
+  }
+  return table;
+}
+
+void SymbolTable::add(CodeAddress address, std::string_view name) {
+  if (name.find('.') != std::string_view::npos) {
+    return;
+  }
+  symbols.insert_or_assign(address, std::string(name));
+}
+
+std::string SymbolTable::get_routine(CodeAddress address) const {
+  auto it = symbols.upper_bound(address);
+  if (it != symbols.begin()) {
+    --it;
+    if (it->first.bank == address.bank &&
+        get_region(it->first.addr) == get_region(address.addr)) {
+      return it->second;
+    }
+  }
+  return std::format("{:02X}:{:04X}", address.bank, address.addr);
+}
+
+std::string get_sym_path(const std::string &rom_path) {
+  return std::filesystem::path(rom_path).replace_extension(".sym").string();
+}
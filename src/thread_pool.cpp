@@ -0,0 +1,93 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+ThreadPool::ThreadPool(size_t thread_count) {
+  if (thread_count == 0) {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  try {
+    workers.reserve(thread_count - 1);
+    for (size_t i = 1; i < thread_count; ++i) {
+      workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+  } catch (...) {
+    // The destructor does not run for a constructor that throws, and
+    // destroying a running std::thread terminates.
+    stop();
+    throw;
+  }
+}
+
+ThreadPool::~ThreadPool() { stop(); }
+
+void ThreadPool::stop() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::run(size_t count, const std::function<void(size_t)> &task) {
+  if (workers.empty() || count <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard lock(mutex);
+    this->task = &task;
+    task_count = count;
+    next_index.store(0, std::memory_order_relaxed);
+    busy = workers.size();
+    ++generation;
+  }
+  wake.notify_all();
+
+  work();
+
+  std::unique_lock lock(mutex);
+  done.wait(lock, [this] { return busy == 0; });
+  this->task = nullptr;
+}
+
+void ThreadPool::work() {
+  for (;;) {
+    const size_t i = next_index.fetch_add(1, std::memory_order_relaxed);
+    if (i >= task_count) {
+      return;
+    }
+    (*task)(i);
+  }
+}
+
+void ThreadPool::worker_loop() {
+  uint64_t seen = 0;
+  std::unique_lock lock(mutex);
+  for (;;) {
+    wake.wait(lock, [&] { return stopping || generation != seen; });
+    if (stopping) {
+      return;
+    }
+    seen = generation;
+
+    lock.unlock();
+    work();
+    lock.lock();
+
+    if (--busy == 0) {
+      done.notify_one();
+    }
+  }
+}
@@ -0,0 +1,201 @@
+#include "trace.hpp"
+
+#include "disassembler.hpp"
+#include "mmu.hpp"
+#include "register.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <format>
+#include <iterator>
+#include <mutex>
+#include <print>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+void append_doctor_line(std::string &out, const RegFile &regFile,
+                        const MMU &mmu) {
+  const uint16_t pc = regFile.pc;
+  std::format_to(
+      std::back_inserter(out),
+      "A:{:02X} F:{:02X} B:{:02X} C:{:02X} D:{:02X} E:{:02X} H:{:02X} "
+      "L:{:02X} SP:{:04X} PC:{:04X} PCMEM:{:02X},{:02X},{:02X},{:02X}\n",
+      regFile.a, regFile.f, regFile.b, regFile.c, regFile.d, regFile.e,
+      regFile.h, regFile.l, regFile.sp, pc, mmu.peek(pc),
+      mmu.peek(static_cast<uint16_t>(pc + 1)),
+      mmu.peek(static_cast<uint16_t>(pc + 2)),
+      mmu.peek(static_cast<uint16_t>(pc + 3)));
+}
+
+TraceComparator::TraceComparator(const std::string &reference_path) {
+  const int fd = open(reference_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::println(stderr, "Error: Could not open file {}", reference_path);
+    return;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    void *mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                        MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED) {
+      madvise(mapped, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+      reference = static_cast<const char *>(mapped);
+      reference_size = static_cast<size_t>(st.st_size);
+    }
+  }
+  close(fd);
+
+  if (reference == nullptr) {
+    std::println(stderr, "Error: Could not map file {}", reference_path);
+    return;
+  }
+
+  current.reserve(chunk_size);
+  worker = std::thread(&TraceComparator::run, this);
+}
+
+TraceComparator::~TraceComparator() {
+  finish();
+  if (reference != nullptr) {
+    munmap(const_cast<char *>(reference), reference_size);
+  }
+}
+
+void TraceComparator::submit(const std::string &line) {
+  current += line;
+  if (current.size() >= chunk_size) {
+    flush_chunk();
+  }
+}
+
+void TraceComparator::flush_chunk() {
+  if (current.empty()) {
+    return;
+  }
+
+  std::unique_lock lock(mutex);
+  // Bound the memory held by lines the worker has not compared yet.
+  cv.wait(lock, [this] {
+    return pending.size() < max_pending_chunks || stopped();
+  });
+  if (!stopped()) {
+    pending.push_back(std::move(current));
+  }
+  lock.unlock();
+  cv.notify_all();
+
+  current = std::string();
+  current.reserve(chunk_size);
+}
+
+const TraceMismatch *TraceComparator::finish() {
+  if (worker.joinable()) {
+    flush_chunk();
+    {
+      std::lock_guard lock(mutex);
+      closing = true;
+    }
+    cv.notify_all();
+    worker.join();
+  }
+  return found_mismatch ? &mismatch : nullptr;
+}
+
+void TraceComparator::run() {
+  for (;;) {
+    std::string chunk;
+    {
+      std::unique_lock lock(mutex);
+      cv.wait(lock, [this] { return !pending.empty() || closing; });
+      if (pending.empty()) {
+        return;
+      }
+      chunk = std::move(pending.front());
+      pending.pop_front();
+    }
+    cv.notify_all();
+
+    compare(chunk);
+    if (found_mismatch || matched == reference_size) {
+      stop.store(true, std::memory_order_relaxed);
+      std::lock_guard lock(mutex);
+      pending.clear();
+      cv.notify_all();
+      return;
+    }
+  }
+}
+
+void TraceComparator::compare(const std::string &chunk) {
+  const size_t available = reference_size - matched;
+  const size_t length = std::min(chunk.size(), available);
+
+  if (std::memcmp(chunk.data(), reference + matched, length) == 0) {
+    matched += length;
+    return;
+  }
+
+  const auto [diff, _] =
+      std::mismatch(chunk.data(), chunk.data() + length, reference + matched);
+  record_mismatch(chunk, static_cast<size_t>(diff - chunk.data()));
+}
+
+void TraceComparator::record_mismatch(const std::string &chunk,
+                                      size_t offset) {
+  // Both sides are identical up to `offset`, so the line starts agree.
+  const size_t newline = chunk.rfind('\n', offset == 0 ? 0 : offset - 1);
+  const size_t line_start =
+      (newline == std::string::npos || newline >= offset) ? 0 : newline + 1;
+  const size_t ref_line_start = matched + line_start;
+
+  mismatch.line = static_cast<size_t>(std::count(
+                      reference, reference + ref_line_start, '\n')) +
+                  1;
+
+  const size_t actual_end = chunk.find('\n', line_start);
+  mismatch.actual = chunk.substr(line_start, actual_end == std::string::npos
+                                                 ? std::string::npos
+                                                 : actual_end - line_start);
+
+  const char *ref_begin = reference + ref_line_start;
+  const char *ref_end = reference + reference_size;
+  mismatch.expected.assign(ref_begin, std::find(ref_begin, ref_end, '\n'));
+
+  // Walk backwards through the reference to collect the preceding lines.
+  const char *end = ref_begin;
+  while (mismatch.context.size() < context_lines && end > reference) {
+    const char *begin = end - 1;
+    while (begin > reference && *(begin - 1) != '\n') {
+      --begin;
+    }
+    mismatch.context.emplace_back(begin, end - 1);
+    end = begin;
+  }
+  std::reverse(mismatch.context.begin(), mismatch.context.end());
+
+  found_mismatch = true;
+}
+
+std::vector<InstructionTrace::Entry> InstructionTrace::get_entries() const {
+  const uint64_t count = std::min<uint64_t>(next, entries.size());
+  std::vector<Entry> result;
+  result.reserve(count);
+  for (uint64_t i = next - count; i < next; ++i) {
+    result.push_back(entries[i % entries.size()]);
+  }
+  return result;
+}
+
+std::string InstructionTrace::format() const {
+  std::string out;
+  for (const Entry &entry : get_entries()) {
+    std::format_to(std::back_inserter(out), "{:>12} {:04X}: {}\n", entry.cycle,
+                   entry.pc, disassemble(entry.pc, entry.bytes));
+  }
+  return out;
+}
@@ -0,0 +1,75 @@
+#include "vec_env.hpp"
+
+#include "cartridge.hpp"
+#include "gameboy.hpp"
+#include "instance_pool.hpp"
+#include "machine_state.hpp"
+#include "ppu.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+VecEnv::VecEnv(const std::vector<uint8_t> &rom, size_t instance_count,
+               ObservationSpec spec, size_t thread_count)
+    : spec(std::move(spec)),
+      instance_pool(instance_count, instance_count * sizeof(GameBoy) >=
+                                        InstancePool::huge_page_size),
+      pool(thread_count) {
+  observation_size = (this->spec.screen ? PPU::width * PPU::height : 0) +
+                     this->spec.ram_addresses.size();
+
+  const RomImage image = intern_rom(std::vector<uint8_t>(rom));
+  instances.reserve(instance_count);
+  for (size_t i = 0; i < instance_count; ++i) {
+    instances.push_back(
+        instance_pool.acquire(std::make_unique<RomOnly>(image)));
+  }
+  // Every instance powers on into the same state, so they all start out
+  // sharing one copy of it.
+  if (instance_count != 0) {
+    auto start_state = std::make_shared<MachineState>();
+    instances.front()->mmu.save_state(*start_state);
+    start_states.assign(instance_count, std::move(start_state));
+  }
+}
+
+void VecEnv::step(const uint8_t *actions, uint32_t frames,
+                  uint8_t *observations) {
+  pool.run(instances.size(), [&](size_t i) {
+    step_instance(i, actions[i], frames, observations + i * observation_size);
+  });
+}
+
+void VecEnv::step_instance(size_t instance, uint8_t buttons, uint32_t frames,
+                           uint8_t *observation) {
+  GameBoy &gameboy = *instances[instance];
+  gameboy.set_buttons(buttons);
+  for (uint32_t frame = 0; frame < frames; ++frame) {
+    // Nobody sees the frames before the last one.
+    const bool draw = spec.screen && frame + 1 == frames;
+    gameboy.set_fast_forward({.enabled = !draw});
+    gameboy.run_frame();
+  }
+
+  if (spec.screen) {
+    const auto &framebuffer = gameboy.ppu.get_framebuffer();
+    observation = std::copy(framebuffer.begin(), framebuffer.end(), observation);
+  }
+  for (const uint16_t addr : spec.ram_addresses) {
+    *observation++ = gameboy.mmu.peek(addr);
+  }
+}
+
+void VecEnv::reset(size_t instance) {
+  instances[instance]->mmu.load_state(*start_states[instance]);
+}
+
+void VecEnv::set_start_state(size_t instance) {
+  // Replaces rather than overwrites the state, which may be shared.
+  auto start_state = std::make_shared<MachineState>();
+  instances[instance]->mmu.save_state(*start_state);
+  start_states[instance] = std::move(start_state);
+}